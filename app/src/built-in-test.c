@@ -18,9 +18,12 @@
 // #include <lvgl.h>
 // #include <lvgl_input_device.h>
 #include <math.h>
+#include <stdlib.h>
 
 #include "sys/storage.h"
+#ifdef CONFIG_EN_DEV_I2S
 #include "sys/audio.h"
+#endif
 #include "sys/nrvc2_can.h"
 
 LOG_MODULE_REGISTER(bit, LOG_LEVEL_DBG);
@@ -125,7 +128,7 @@ static bool bit_sdhc() {
     }
 
     // mount, read, write, check write, unmount
-    int ret = nrvc2_fs_mount();
+    int ret = nrvc2_storage_acquire();
     if (ret < 0)
         return false;
 
@@ -138,7 +141,7 @@ static bool bit_sdhc() {
         LOG_WRN("SD could not open bit.txt for writing");
     else if (ret < 0) {
         LOG_ERR("SD open test failed %d", ret);
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -147,7 +150,7 @@ static bool bit_sdhc() {
     ssize_t read_ret = fs_write(&tst_file, write_buf, sizeof(write_buf));
     if (read_ret < 0) {
         LOG_ERR("SD write test file failed");
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -155,7 +158,7 @@ static bool bit_sdhc() {
     ret = fs_close(&tst_file);
     if (ret < 0) {
         LOG_ERR("SD close written bit.txt file failed");
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -165,7 +168,7 @@ static bool bit_sdhc() {
     ret = fs_open(&tst_file, test_path, FS_O_READ);
     if (ret < 0) {
         LOG_ERR("SD open test file for read failed %d", ret);
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -174,7 +177,7 @@ static bool bit_sdhc() {
     read_ret = fs_read(&tst_file, read_buf, sizeof(read_buf));
     if (read_ret < 0) {
         LOG_ERR("SD read test file failed %d", read_ret);
-        nrvc2_fs_unmount(); 
+        nrvc2_storage_release(); 
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -182,7 +185,7 @@ static bool bit_sdhc() {
     ret = fs_close(&tst_file);
     if (ret < 0) {
         LOG_ERR("SD close read test file failed");
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -190,7 +193,7 @@ static bool bit_sdhc() {
     ret = strncmp(read_buf, write_buf, sizeof(read_buf));
     if (ret != 0) {
         LOG_ERR("SD read/write data mismatch");
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
@@ -199,13 +202,13 @@ static bool bit_sdhc() {
     ret = fs_unlink(test_path);
     if (ret < 0) { 
         LOG_ERR("SD delete test file failed %d", ret);
-        nrvc2_fs_unmount();
+        nrvc2_storage_release();
         role_devs->dev_sdcard_stat = DEVSTAT_ERR;
         return false;
     }
 
     k_msleep(100);
-    ret = nrvc2_fs_unmount();
+    ret = nrvc2_storage_release();
     if (ret < 0) 
         return false;
 
@@ -285,7 +288,47 @@ static bool bit_display_st7735(bool wait_sw0) {
     return true;
 }
 
+#if defined(CONFIG_EN_DEV_I2S) && defined(CONFIG_AUDIO_CACHE) && CONFIG_AUDIO_VOICES > 1
+// polls for up to `ms` until `min` to `max` voices read the cached clip at `path`
+static bool bit_i2s_wait_readers(const char* path, int min, int max, int ms) {
+    int readers = audio_cache_readers(path);
+    for (int i = 0; i < ms && (readers < min || readers > max); i++) {
+        k_msleep(1);
+        readers = audio_cache_readers(path);
+    }
+    return readers >= min && readers <= max;
+}
+
+// the same cached clip on two voices at once, the voice left playing keeps the entry alive
+static bool bit_i2s_shared_clip(const char* path) {
+    if (audio_cache_readers(path) < 0) {
+        LOG_WRN("I2S BIT %s not cached, shared clip SKIP", path);
+        return true;
+    }
+
+    audio_handle_t first = audio_play(path, AUDIO_PRIO_NORMAL);
+    audio_handle_t second = audio_play(path, AUDIO_PRIO_NORMAL);
+    if (first < 0 || second < 0) {
+        LOG_ERR("I2S BIT shared clip queue failed (%d, %d)", first, second);
+        audio_halt();
+        return false;
+    }
+
+    // the second voice may finish on its own once the first is stopped
+    bool ok = bit_i2s_wait_readers(path, 2, 2, 250);
+    audio_stop(first);
+    ok &= bit_i2s_wait_readers(path, 0, 1, 250);
+    audio_stop(second);
+    ok &= bit_i2s_wait_readers(path, 0, 0, 250);
+
+    if (!ok)
+        LOG_ERR("I2S BIT shared clip has %d readers", audio_cache_readers(path));
+    return ok;
+}
+#endif
+
 static bool bit_i2s() {
+#ifdef CONFIG_EN_DEV_I2S
     if (role_devs->dev_i2s_stat != DEVSTAT_RDY) {
         LOG_WRN("I2S\t\tSKIP");
         return true;
@@ -297,21 +340,26 @@ static bool bit_i2s() {
         return true;
     }
 
-    int ret = nrvc2_fs_mount();
-    if (ret < 0) 
-        return false;
-    
-
-    ret = audio_play_file_blocking(NRVC2_STORAGE_MP"/bit.wav", K_MSEC(250));
+    // the player mounts storage itself while the clip streams
+    int ret = audio_play_file_blocking(NRVC2_STORAGE_MP"/bit.wav", K_MSEC(250));
     if (ret < 0) {
         LOG_ERR("I2S\t\tFAIL (%d)", ret);
         return false;
     }
 
-    nrvc2_fs_unmount();
+#if defined(CONFIG_AUDIO_CACHE) && CONFIG_AUDIO_VOICES > 1
+    if (!bit_i2s_shared_clip(NRVC2_STORAGE_MP"/bit.wav")) {
+        LOG_ERR("I2S\t\tFAIL (shared clip)");
+        return false;
+    }
+#endif
 
     LOG_INF("I2S\t\tOK");
     return true;
+#else
+    LOG_WRN("I2S\t\tSKIP");
+    return true;
+#endif
 }
 
 static bool bit_ufirebirdii() {
@@ -335,12 +383,12 @@ static bool bit_ufirebirdii() {
         return true; // dont fail bc bad fix != broken device
     }
 
-    LOG_INF("UFirebird II\tOK\r\n\t\t\tLatitude: %d°%lf' %c\r\n\t\t\tLongitude: %d°%lf' %c\r\n\t\t\tAltitude: %lf M\r\n\t\t\tSatellites: %d\r\n\t\t\tHDOP: %lf\r\n\t\t\tFix Validity: %d", 
-        fix.latitude.deg, fix.latitude.min, fix.latitude.dir,
-        fix.longitude.deg, fix.longitude.min, fix.longitude.dir,
-        fix.altitude,
+    LOG_INF("UFirebird II\tOK\r\n\t\t\tLatitude: %s%d.%07d°\r\n\t\t\tLongitude: %s%d.%07d°\r\n\t\t\tAltitude: %s%d.%03d M\r\n\t\t\tSatellites: %d\r\n\t\t\tHDOP: %d.%02d\r\n\t\t\tFix Validity: %d", 
+        fix.latitude < 0 ? "-" : "", abs(fix.latitude) / UFBII_COORD_SCALE, abs(fix.latitude) % UFBII_COORD_SCALE,
+        fix.longitude < 0 ? "-" : "", abs(fix.longitude) / UFBII_COORD_SCALE, abs(fix.longitude) % UFBII_COORD_SCALE,
+        fix.altitude < 0 ? "-" : "", abs(fix.altitude) / 1000, abs(fix.altitude) % 1000,
         fix.satellites,
-        fix.hdop,
+        fix.hdop / 100, fix.hdop % 100,
         fix.validity
     );
 
@@ -4,6 +4,18 @@
 
 #include "built-in-test.h"
 #include "roles.h"
+#ifdef CONFIG_EN_DEV_I2S
+#include "sys/audio.h"
+#endif
+#ifdef CONFIG_UFIREBIRDII
+#include "sys/gnss.h"
+#endif
+#ifdef CONFIG_GEOFENCE
+#include "sys/zones.h"
+#endif
+#ifdef CONFIG_TRACK
+#include "sys/history.h"
+#endif
 
 LOG_MODULE_REGISTER(main);
 
@@ -17,7 +29,37 @@ int main(void) {
         LOG_ERR("ROLE CFG FAIL");
     }
     
+#ifdef CONFIG_EN_DEV_I2S
+    int audio = audio_init();
+    if (audio < 0)
+        LOG_WRN("Audio init failed (%d)", audio);
+#endif
+
     bit_basic();
 
+#ifdef CONFIG_AUDIO_CACHE
+    int clips = audio_cache_init();
+    if (clips < 0)
+        LOG_WRN("Audio clip cache init failed (%d)", clips);
+#endif
+
+#ifdef CONFIG_UFIREBIRDII
+    int ret = gnss_init();
+    if (ret < 0)
+        LOG_WRN("GNSS init failed (%d)", ret);
+#endif
+
+#ifdef CONFIG_GEOFENCE
+    int zones = zones_init();
+    if (zones < 0)
+        LOG_WRN("Geofence init failed (%d)", zones);
+#endif
+
+#ifdef CONFIG_TRACK
+    int history = history_init();
+    if (history < 0)
+        LOG_WRN("Track history init failed (%d)", history);
+#endif
+
     return 0;
 }
\ No newline at end of file
@@ -1,18 +1,21 @@
 #include "audio.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <zephyr/drivers/i2s.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <mixer/mixer.h>
+#include <pcm/pcm.h>
 
 #include "../roles.h"
 #include "../nrvc2_errno.h"
 #include "storage.h"
 
-#define I2S_SAMPLES_PER_BLOCK 64
 #define I2S_CHANNELS 2
 #define I2S_WORD_SIZE_BYTES sizeof(int16_t)
-#define I2S_SAMPLE_RATE_HZ 44100
-#define I2S_NUM_BLOCKS 8
-#define I2S_BLOCK_SIZE (I2S_CHANNELS * I2S_SAMPLES_PER_BLOCK * I2S_WORD_SIZE_BYTES)
+#define I2S_SAMPLE_RATE_HZ CONFIG_AUDIO_SAMPLE_RATE
 
 LOG_MODULE_REGISTER(audio, LOG_LEVEL_ERR);
 
@@ -27,9 +30,26 @@ typedef struct {
     uint32_t byte_rate;
     uint16_t block_align;
     uint16_t bits_per_sample;
-    size_t subchunk2_size;
+    size_t subchunk2_size;      // bytes of samples
+    off_t data_offset;          // where the samples start in the file
 } wav_file_t;
 
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IMA_ADPCM 0x0011
+
+static uint16_t wav_le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t wav_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+ * Opens a WAV file and walks its RIFF chunks for the format and the samples, skipping any
+ * other chunk (LIST, fact, cue...) wherever it sits. Takes PCM and IMA ADPCM. The file is left
+ * at the first sample.
+ */
 static int open_parse_wav(const char* path, wav_file_t* out_wav) {
     if (!out_wav)
         return -EINVAL;
@@ -43,345 +63,1821 @@ static int open_parse_wav(const char* path, wav_file_t* out_wav) {
 
     // get total filesize
     ret = fs_seek(&out_wav->wav_file, 0, FS_SEEK_END);
-    if (ret < 0)
-        return ret; 
+    if (ret < 0) {
+        fs_close(&out_wav->wav_file);
+        return ret;
+    }
     out_wav->filesize = fs_tell(&out_wav->wav_file);
     ret = fs_seek(&out_wav->wav_file, 0, FS_SEEK_SET);
-    if (ret < 0)
-        return ret;
-
-    // read all 44 header bytes at once
-    const size_t header_min_size = 44;
-    if (out_wav->filesize < header_min_size) {
+    if (ret < 0) {
         fs_close(&out_wav->wav_file);
-        return -EINVAL;
+        return ret;
     }
 
-    uint8_t header_buf[header_min_size];
-    ssize_t read_ret = fs_read(&out_wav->wav_file, header_buf, sizeof(header_buf));
+    // RIFF chunk id and size, then the WAVE form type
+    uint8_t riff[12];
+    ssize_t read_ret = fs_read(&out_wav->wav_file, riff, sizeof(riff));
     if (read_ret < 0) {
         fs_close(&out_wav->wav_file);
         return read_ret;
     }
-    
-    const uint8_t* riff_off = header_buf;
-    const uint8_t* chunk_size_off = header_buf + 0x04;
-    const uint8_t* wave_off = header_buf + 0x08;
-    const uint8_t* fmt_off = header_buf + 0x0C;
-    const uint8_t* data_off = header_buf + 0x24;
-    const int pcm_subchunk1_size = 16;
-    const size_t subchunk1size_idx = 0x10,
-                audio_format_idx = 0x14,
-                num_channels_idx = 0x16,
-                sample_rate_idx = 0x18,
-                byte_rate_idx = 0x1C,
-                block_align_idx = 0x20,
-                bits_per_sample_idx = 0x22,
-                subchunk2_size_idx = 0x28;
-
-    if ((strncmp(riff_off, "RIFF", 4) != 0) 
-            || (strncmp(wave_off, "WAVE", 4) != 0)
-            || (strncmp(fmt_off, "fmt ", 4) != 0))
+    if (read_ret < sizeof(riff) || strncmp(riff, "RIFF", 4) != 0 || strncmp(riff + 8, "WAVE", 4) != 0) {
+        fs_close(&out_wav->wav_file);
         return -EFTYPE;
-
-    out_wav->chunk_size = chunk_size_off[0]
-                        | (chunk_size_off[1] << 8)
-                        | (chunk_size_off[2] << 16)
-                        | (chunk_size_off[3] << 24);
-    
-    out_wav->subchunk1_size = header_buf[subchunk1size_idx]
-                        | (header_buf[subchunk1size_idx + 1] << 8)
-                        | (header_buf[subchunk1size_idx + 2] << 16)
-                        | (header_buf[subchunk1size_idx + 3] << 24);
-    
-    if (out_wav->subchunk1_size != pcm_subchunk1_size) {
-        LOG_ERR("WAV subchunk1 size not uncompressed PCM standard (unsupported WAV format) for file %s", path);
-        return -ENOTSUP;    // other format support not planned atm
     }
+    out_wav->chunk_size = wav_le32(riff + 4);
 
-    out_wav->audio_format = header_buf[audio_format_idx] | (header_buf[audio_format_idx + 1] << 8);
-    if (out_wav->audio_format != 1) {
-        LOG_ERR("WAV audio format not uncompressed PCM (unsupported WAV format) for file %s", path);
-        return -ENOTSUP;    // other format support not planned atm
-    }
-    
-    out_wav->num_channels = header_buf[num_channels_idx] | (header_buf[num_channels_idx + 1] << 8);
+    // WAVE_FORMAT_EXTENSIBLE carries the real format in the first two bytes of its sub format GUID
+    const uint16_t format_extensible = 0xFFFE;
+    const size_t fmt_min_size = 16, fmt_extensible_size = 40, subformat_idx = 24;
+    bool fmt_found = false;
+    off_t pos = sizeof(riff);
 
-    out_wav->sample_rate = header_buf[sample_rate_idx] 
-                            | (header_buf[sample_rate_idx + 1] << 8)
-                            | (header_buf[sample_rate_idx + 2] << 16)
-                            | (header_buf[sample_rate_idx + 3] << 24);
-    
-    out_wav->byte_rate = header_buf[byte_rate_idx]
-                        | (header_buf[byte_rate_idx + 1] << 8)
-                        | (header_buf[byte_rate_idx + 2] << 16)
-                        | (header_buf[byte_rate_idx + 3] << 24);
-    
-    out_wav->block_align = header_buf[block_align_idx] | (header_buf[block_align_idx + 1] << 8);
+    for (;;) {
+        uint8_t chunk[8];
+        if (pos + sizeof(chunk) > out_wav->filesize) {
+            LOG_ERR("WAV data subchunk not found in file %s", path);
+            fs_close(&out_wav->wav_file);
+            return -EFTYPE;
+        }
+
+        ret = fs_seek(&out_wav->wav_file, pos, FS_SEEK_SET);
+        read_ret = ret < 0 ? ret : fs_read(&out_wav->wav_file, chunk, sizeof(chunk));
+        if (read_ret < 0) {
+            fs_close(&out_wav->wav_file);
+            return read_ret;
+        }
 
-    out_wav->bits_per_sample = header_buf[bits_per_sample_idx] | (header_buf[bits_per_sample_idx + 1] << 8);
+        uint32_t size = wav_le32(chunk + 4);
+        pos += sizeof(chunk);
 
-    if (strncmp(data_off, "data", 4) != 0) {
-        LOG_ERR("WAV data subchunk not found in file %s", path);
+        if (strncmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[40];
+            if (size < fmt_min_size) {
+                LOG_ERR("WAV fmt subchunk too short in file %s", path);
+                fs_close(&out_wav->wav_file);
+                return -EFTYPE;
+            }
+            read_ret = fs_read(&out_wav->wav_file, fmt, MIN(size, sizeof(fmt)));
+            if (read_ret < 0) {
+                fs_close(&out_wav->wav_file);
+                return read_ret;
+            }
+
+            uint16_t format = wav_le16(fmt);
+            if (format == format_extensible && size >= fmt_extensible_size)
+                format = wav_le16(fmt + subformat_idx);
+
+            out_wav->subchunk1_size = size;
+            out_wav->audio_format = format;
+            out_wav->num_channels = wav_le16(fmt + 2);
+            out_wav->sample_rate = wav_le32(fmt + 4);
+            out_wav->byte_rate = wav_le32(fmt + 8);
+            out_wav->block_align = wav_le16(fmt + 12);
+            out_wav->bits_per_sample = wav_le16(fmt + 14);
+            fmt_found = true;
+        } else if (strncmp(chunk, "data", 4) == 0) {
+            if (!fmt_found) {
+                LOG_ERR("WAV data subchunk before fmt in file %s", path);
+                fs_close(&out_wav->wav_file);
+                return -EFTYPE;
+            }
+            // streamed files leave the size at 0 or all ones, the samples run to the end of the file
+            out_wav->data_offset = pos;
+            out_wav->subchunk2_size = MIN(size, out_wav->filesize - pos);
+            if (out_wav->subchunk2_size == 0)
+                out_wav->subchunk2_size = out_wav->filesize - pos;
+            break;
+        }
+
+        // chunks are padded to an even size
+        pos += size + (size & 1);
+    }
+
+    uint16_t bits = out_wav->bits_per_sample;
+    uint16_t channels = out_wav->num_channels;
+    if (out_wav->audio_format == WAV_FORMAT_PCM) {
+        if ((bits != 8 && bits != 16 && bits != 24 && bits != 32) || channels == 0) {
+            LOG_ERR("WAV %d bit %d channel PCM not supported in file %s", bits, channels, path);
+            fs_close(&out_wav->wav_file);
+            return -ENOTSUP;
+        }
+        if (out_wav->block_align != channels * bits / 8) {
+            LOG_ERR("WAV block align %d invalid in file %s", out_wav->block_align, path);
+            fs_close(&out_wav->wav_file);
+            return -EFTYPE;
+        }
+    } else if (out_wav->audio_format == WAV_FORMAT_IMA_ADPCM) {
+        // a block is a 4 byte header per channel, then runs of 4 bytes per channel
+        if (bits != 4 || channels == 0 || channels > 2) {
+            LOG_ERR("WAV %d bit %d channel IMA ADPCM not supported in file %s", bits, channels, path);
+            fs_close(&out_wav->wav_file);
+            return -ENOTSUP;
+        }
+        if (out_wav->block_align == 0 || out_wav->block_align % (4 * channels) != 0) {
+            LOG_ERR("WAV block align %d invalid in file %s", out_wav->block_align, path);
+            fs_close(&out_wav->wav_file);
+            return -EFTYPE;
+        }
+    } else {
+        LOG_ERR("WAV audio format %d not PCM or IMA ADPCM (unsupported WAV format) for file %s", out_wav->audio_format, path);
+        fs_close(&out_wav->wav_file);
+        return -ENOTSUP;
+    }
+
+    if (out_wav->sample_rate == 0) {
+        LOG_ERR("WAV sample rate 0 in file %s", path);
+        fs_close(&out_wav->wav_file);
         return -EFTYPE;
     }
 
-    out_wav->subchunk2_size = header_buf[subchunk2_size_idx] | (header_buf[subchunk2_size_idx + 1] << 8) 
-                            | (header_buf[subchunk2_size_idx + 2] << 16) | (header_buf[subchunk2_size_idx + 3] << 24);
-                            
+    ret = fs_seek(&out_wav->wav_file, out_wav->data_offset, FS_SEEK_SET);
+    if (ret < 0) {
+        fs_close(&out_wav->wav_file);
+        return ret;
+    }
+
     return 0;
 }
 
-#define I2S_TX_BLOCKS 8
-#define I2S_TX_BLOCKSIZE 64
+/*
+ * Blocks the mixer keeps queued in the driver behind the one the DMA plays. Anything mixed sits
+ * behind them, so a new clip, an alert above all, is heard once they and the block playing are out.
+ */
+#define AUDIO_QUEUE_AHEAD 1
+// every voice holds up to its read ahead plus the block being mixed, the rest is in the driver
+#define I2S_TX_BLOCKS (CONFIG_AUDIO_VOICES * (CONFIG_AUDIO_PREFETCH_BLOCKS + 1) + AUDIO_QUEUE_AHEAD + 1)
+#define I2S_TX_BLOCKSIZE CONFIG_AUDIO_BLOCK_SIZE
 #define TX_QUEUE_FULL_TIMEOUT_MS 500
+// every clip is converted to the one format the stream runs at
+#define AUDIO_FRAME_SIZE (I2S_CHANNELS * I2S_WORD_SIZE_BYTES)
+#define AUDIO_BYTE_RATE (I2S_SAMPLE_RATE_HZ * AUDIO_FRAME_SIZE)
+#define AUDIO_BLOCK_US ((uint32_t)(I2S_TX_BLOCKSIZE * 1000000ULL / AUDIO_BYTE_RATE))
+// how often the player looks for the DMA to take the queued block, a fraction of a block
+#define AUDIO_QUEUE_POLL_US (AUDIO_BLOCK_US / 8)
+BUILD_ASSERT(I2S_TX_BLOCKSIZE % AUDIO_FRAME_SIZE == 0, "CONFIG_AUDIO_BLOCK_SIZE must hold whole 16 bit stereo frames");
+#define AUDIO_PREFETCH_STACK_SIZE 2048
+// above the system workqueue, the SD has to stay ahead of the DMA when CAN and LoRa share the bus
+#define AUDIO_PREFETCH_PRIORITY 5
 K_MEM_SLAB_DEFINE_STATIC(i2s_tx_slab, I2S_TX_BLOCKSIZE, I2S_TX_BLOCKS, 2 * sizeof(uint16_t));
 static struct i2s_config i2s_cfg = {
+    .word_size = I2S_WORD_SIZE_BYTES * 8,
+    .channels = I2S_CHANNELS,
     .format = I2S_FMT_DATA_FORMAT_I2S,
     .options = I2S_OPT_FRAME_CLK_CONTROLLER | I2S_OPT_BIT_CLK_CONTROLLER,
     .block_size = I2S_TX_BLOCKSIZE,
     .timeout = TX_QUEUE_FULL_TIMEOUT_MS,
+    .frame_clk_freq = I2S_SAMPLE_RATE_HZ,
     .mem_slab = &i2s_tx_slab
 };
+static atomic_t i2s_configured;     // set once by `audio_init`
+static atomic_t blocks_held;        // slab blocks read ahead or being mixed, every other one in use is in the driver
 
-/// Semaphore to limit how many audio files that can wait at once.
-K_SEM_DEFINE(i2s_dev_sem, 1, 1);
+/// A block read ahead by the prefetch thread. `mem` is NULL for the one that ends the stream.
+struct audio_block {
+    void* mem;
+    int32_t len;    // bytes of samples, or on the last block 0 at end of file and `errno < 0` on a read error
+};
 
-int audio_play_file_blocking(const char* filename, k_timeout_t busy_timeout) {
-    // Playing audio requires ready SD card and I2S amp
-    if ((role_devs->dev_i2s_stat != DEVSTAT_RDY) || (role_devs->dev_sdcard_stat != DEVSTAT_RDY)) 
-        return -EDEVNOTRDY;
+// counted in `blocks_held` until it is freed or handed to the driver
+static int audio_block_alloc(void** mem) {
+    int ret = k_mem_slab_alloc(&i2s_tx_slab, mem, K_FOREVER);
+    if (ret == 0)
+        atomic_inc(&blocks_held);
+    return ret;
+}
 
-    // Playing audio requires a mounted filesystem
-    if (!nrvc2_storage_is_mounted())
-        return -ESTORAGENOTMOUNTED;
+// frees a block the driver never got
+static void audio_block_free(void* mem) {
+    atomic_dec(&blocks_held);
+    k_mem_slab_free(&i2s_tx_slab, mem);
+}
 
-    wav_file_t playing_wav;
-    int ret = open_parse_wav(filename, &playing_wav);
-    if (ret < 0)
-        return ret; // dont consider opening/parsing errors to disable I2S system
-    
-    // begin I2S PCM stream critical zone
-    ret = k_sem_take(&i2s_dev_sem, busy_timeout);
-    if (ret < 0) // I2S is busy and may have timed out
-        return ret;
+// blocks the driver holds, the one the DMA plays and the ones queued behind it
+static uint32_t audio_blocks_in_driver() {
+    int32_t n = I2S_TX_BLOCKS - (int32_t)k_mem_slab_num_free_get(&i2s_tx_slab) - (int32_t)atomic_get(&blocks_held);
+    return MAX(n, 0);
+}
 
-    // set params
-    i2s_cfg.word_size = playing_wav.bits_per_sample;
-    i2s_cfg.channels = playing_wav.num_channels;
-    i2s_cfg.frame_clk_freq = playing_wav.sample_rate;
+// largest IMA ADPCM block played, what the usual encoders write for 44.1 kHz stereo
+#define AUDIO_ADPCM_BLOCK_MAX 2048
 
-    ret = i2s_configure(role_devs->dev_i2s, I2S_DIR_TX, &i2s_cfg);
-    if (ret < 0) {
-        LOG_ERR("I2S BIT SD i2s configure failed: %d", ret);
-        role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem); 
-        return ret;
+/// Where a clip's samples come from, the file or a RAM copy in the clip cache
+struct audio_source {
+    wav_file_t wav;                 // format, and the open file when `mem` is NULL
+    const uint8_t* mem;             // cached samples
+    uint32_t len;                   // bytes of samples in `mem`, or expected from the file
+    uint32_t pos;                   // bytes read so far
+    uint8_t* tee;                   // cache entry filled with what is read from the file, NULL if not caching
+    bool direct;                    // already 16 bit stereo at CONFIG_AUDIO_SAMPLE_RATE, read straight into the block
+    bool resample;
+    struct pcm_resampler rs;
+    struct pcm_ima ima;             // decoder state within `block`
+    uint32_t block_frames;          // frames in `block`, decoded up to `ima.pos`
+    uint8_t block[AUDIO_ADPCM_BLOCK_MAX];   // the IMA ADPCM block being decoded
+};
+
+#define AUDIO_PATH_MAX 64
+#define AUDIO_REQUEST_DEPTH 4
+#define AUDIO_PENDING_MAX 4
+#define AUDIO_PLAYER_STACK_SIZE 2048
+// above the prefetch, a new request must get through while the voices are being read
+#define AUDIO_PLAYER_PRIORITY 4
+#ifdef CONFIG_AUDIO_CACHE
+// k_heap bookkeeping on top of the cached samples, a chunk header per entry and the heap itself
+#define AUDIO_CACHE_HEAP_SIZE (CONFIG_AUDIO_CACHE_SIZE + CONFIG_AUDIO_CACHE_ENTRIES * 16 + 256)
+#define AUDIO_CACHE_CLIP_MAX CONFIG_AUDIO_CACHE_CLIP_MAX
+#else
+#define AUDIO_CACHE_CLIP_MAX 0
+#endif
+
+/// A clip held in RAM, plays without touching storage
+struct audio_cache_entry {
+    char path[AUDIO_PATH_MAX];      // empty if the entry is free
+    wav_file_t wav;                 // header of the clip, the file handle is not used
+    uint8_t* data;
+    uint32_t len;
+    uint32_t last_used;             // cache_clock at the last hit, the lowest is evicted first
+    bool pinned;                    // preloaded at boot, never evicted
+    bool loading;                   // being filled while the clip streams from storage, not playable yet
+    uint8_t readers;                // voices reading from it, evicted only at 0
+};
+
+#ifdef CONFIG_AUDIO_CACHE
+K_HEAP_DEFINE(audio_cache_heap, AUDIO_CACHE_HEAP_SIZE);
+static struct audio_cache_entry audio_cache[CONFIG_AUDIO_CACHE_ENTRIES];
+static uint32_t cache_resident;     // bytes of samples held
+#endif
+static uint32_t cache_clock;
+static K_MUTEX_DEFINE(cache_lock);  // the player and audio_cache_init share the entries
+
+/// Lets a caller wait on its own clip, see `audio_play_file_blocking`
+struct audio_waiter {
+    struct k_sem started;   // the clip left the queue
+    struct k_sem done;      // the clip ended, `result` is set
+    int result;
+};
+
+enum audio_op {
+    AUDIO_OP_PLAY,
+    AUDIO_OP_STOP,          // stop or dequeue the clip with `handle`
+    AUDIO_OP_GAIN,          // set the gain of the clip with `handle`
+    AUDIO_OP_HALT,          // stop everything
+};
+
+struct audio_request {
+    uint8_t op;
+    uint8_t prio;
+    int16_t gain;                   // Q15
+    audio_handle_t handle;
+    uint32_t submitted;             // k_cycle_get_32() at submit, for alert latency
+    struct audio_waiter* waiter;    // NULL if nobody waits
+    char path[AUDIO_PATH_MAX];
+};
+
+K_MSGQ_DEFINE(request_q, sizeof(struct audio_request), AUDIO_REQUEST_DEPTH, 4);
+static atomic_t next_handle;
+static atomic_t player_busy;        // a clip is playing or queued
+
+/// One clip mixed into the stream
+struct audio_voice {
+    struct audio_request req;
+    struct audio_source src;            // only touched by the prefetch thread while `reading` is set
+    struct audio_cache_entry* cached;   // entry `src` reads from or fills, NULL if none
+    struct k_msgq q;                    // blocks read ahead, the stream ends with one without memory
+    char __aligned(4) q_buf[(CONFIG_AUDIO_PREFETCH_BLOCKS + 1) * sizeof(struct audio_block)];
+    atomic_t reading;                   // the block that ends the stream has not been queued yet
+    atomic_t stop;                      // set by the player to end the stream early
+    struct audio_block next;            // taken off `q` for the next mix, `mem` is NULL if none
+    int result;                         // of the block that ended the stream
+    bool active;                        // the voice plays a clip
+    bool live;                          // read far enough ahead to be mixed
+    bool ended;                         // the block that ended the stream came through
+    bool first;                         // the first block of the clip has not started yet
+    int16_t gain;                       // Q15, set by `audio_set_gain`
+    int16_t applied;                    // Q15 gain at the end of the last block, the next one ramps from it
+};
+
+static struct audio_voice voices[CONFIG_AUDIO_VOICES];
+static K_SEM_DEFINE(prefetch_kick, 0, 1);   // a voice started, stopped or has room to read into
+static K_SEM_DEFINE(player_wake, 0, 1);     // the prefetch queued a block
+
+enum audio_state {
+    AUDIO_IDLE,
+    AUDIO_PLAYING,
+    AUDIO_DRAINING,     // every voice is read, the driver plays out what it holds
+};
+
+/// Player thread state, only touched by the player thread
+static struct {
+    enum audio_state state;
+    bool started;                   // the DMA runs
+    struct audio_request pending[AUDIO_PENDING_MAX];    // highest priority first, FIFO within one
+    uint32_t pending_count;
+} player;
+
+/// Streaming cost, see `shell_audio_stats`
+static struct {
+    uint64_t cycles;        // spent reading and converting blocks, waits for a free block excluded
+    uint64_t bytes;         // sample bytes queued
+    uint64_t mix_cycles;    // spent mixing voices into the blocks queued
+    uint64_t sd_bytes;      // read from the SD card, less than `bytes` for compressed or low rate clips
+    uint64_t sd_cycles;     // spent in those reads, the time the shared SPI bus is taken
+    uint32_t mix_voice_blocks;  // voice blocks mixed, to turn mix_cycles into a cost per voice
+    uint32_t blocks;
+    uint32_t short_blocks;  // sent with less than I2S_TX_BLOCKSIZE bytes
+    uint32_t read_max_us;   // slowest single block read, the SD hiccup the prefetch has to cover
+    uint32_t starved;       // times the player found nothing read ahead, the DMA ran on what it had
+    uint32_t underruns;     // times the DMA ran dry and the stream was restarted
+    uint32_t preemptions;   // clips cut off by a higher priority one
+    uint32_t rejected;      // requests dropped because the queue was full
+    uint32_t alert_last_us; // alert submit to its first block starting on the DMA, see `audio_voice_first`
+    uint32_t alert_max_us;
+    uint32_t hits;          // clips played from the cache
+    uint32_t misses;        // clips played from storage
+    uint32_t evictions;
+    uint32_t ttfs_hit_last_us;  // submit to the first block starting on the DMA, by where the clip came from
+    uint32_t ttfs_hit_max_us;
+    uint32_t ttfs_miss_last_us;
+    uint32_t ttfs_miss_max_us;
+} audio_stats;
+
+// reads up to `len` bytes of samples, a clip being cached is copied on into its entry as it streams
+static ssize_t audio_source_read(struct audio_source* src, void* buf, uint32_t len) {
+    ssize_t n;
+
+    len = MIN(len, src->len - src->pos);
+    if (src->mem != NULL) {
+        n = len;
+        memcpy(buf, src->mem + src->pos, n);
+    } else {
+        uint32_t start = k_cycle_get_32();
+        n = fs_read(&src->wav.wav_file, buf, len);
+        if (n < 0) {
+            LOG_ERR("I2S SD read failed: %d", (int)n);
+            role_devs->dev_sdcard_stat = DEVSTAT_ERR;
+            return n;
+        }
+        audio_stats.sd_cycles += k_cycle_get_32() - start;
+        audio_stats.sd_bytes += n;
+
+        if (src->tee != NULL)
+            memcpy(src->tee + src->pos, buf, n);
     }
 
-    // #warning FIXME This may fall apart when WAV is not signed 16 bit PCM
-    // solution: I want to move on from this, so dont support anything thats not 2 bytes
-    uint16_t audio_buf[I2S_TX_BLOCKSIZE / sizeof(uint16_t)]; 
-    void* tx_block[I2S_NUM_BLOCKS];
-    int blockno = 0;
+    src->pos += n;
+    return n;
+}
 
-    // check if data is 16 bit unsigned PCM
-    if (playing_wav.bits_per_sample != 16) {
-        LOG_ERR("I2S BIT SD unsupported bits per sample %d", playing_wav.bits_per_sample);
-        role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem); 
-        return -ENOTSUP;
-    } 
+// raw samples and their 16 bit stereo conversion on the way into a block, only the prefetch thread uses them
+static uint8_t stage_raw[I2S_TX_BLOCKSIZE];
+static int16_t stage_pcm[I2S_TX_BLOCKSIZE / sizeof(int16_t)];
+
+/*
+ * Reads up to `frames` frames of a clip not in the stream format and converts them to 16 bit
+ * stereo at the clip's own rate. IMA ADPCM is read a whole block at a time and decoded as far
+ * as asked, so it comes back short at the end of each block.
+ * @returns frames written to `out`, 0 at the end of the clip, `errno < 0` on a read error.
+ */
+static ssize_t audio_source_frames(struct audio_source* src, int16_t* out, uint32_t frames) {
+    const wav_file_t* wav = &src->wav;
+
+    if (wav->audio_format == WAV_FORMAT_IMA_ADPCM) {
+        if (src->ima.pos == src->block_frames) {
+            ssize_t len = audio_source_read(src, src->block, wav->block_align);
+            if (len <= 0)
+                return len;
+            // the last block may be cut short
+            src->block_frames = pcm_ima_block_frames(len, wav->num_channels);
+            src->ima.pos = 0;
+            if (src->block_frames == 0)
+                return 0;
+        }
 
-    // prime i2s fifo with first block
-    ret = fs_read(&playing_wav.wav_file, audio_buf, sizeof(audio_buf));
+        frames = MIN(frames, src->block_frames - src->ima.pos);
+        pcm_ima_decode(&src->ima, out, src->block, frames, wav->num_channels);
+        return frames;
+    }
+
+    frames = MIN(frames, sizeof(stage_raw) / wav->block_align);
+    ssize_t len = audio_source_read(src, stage_raw, frames * wav->block_align);
+    if (len < 0)
+        return len;
+
+    // a trailing partial frame is dropped
+    frames = len / wav->block_align;
+    pcm_to_s16_stereo(out, stage_raw, frames, wav->bits_per_sample, wav->num_channels);
+    return frames;
+}
+
+/*
+ * Fills `out` with the next samples of a clip not in the stream format, converted to 16 bit
+ * stereo and resampled to CONFIG_AUDIO_SAMPLE_RATE. Without resampling the samples are decoded
+ * straight into `out`. Only the input frames the resampler takes are read, so nothing is left
+ * over between blocks.
+ * @returns bytes written to `out`, 0 at the end of the clip, `errno < 0` on a read error.
+ */
+static ssize_t audio_convert_block(struct audio_source* src, int16_t* out) {
+    const uint32_t room = I2S_TX_BLOCKSIZE / AUDIO_FRAME_SIZE;
+    uint32_t filled = 0;
+
+    while (filled < room) {
+        ssize_t frames;
+
+        if (!src->resample) {
+            frames = audio_source_frames(src, out + 2 * filled, room - filled);
+            if (frames <= 0) {
+                if (frames < 0)
+                    return frames;
+                break;
+            }
+            filled += frames;
+            continue;
+        }
+
+        uint32_t want = MIN(pcm_resampler_demand(&src->rs, room - filled), ARRAY_SIZE(stage_pcm) / 2);
+        frames = 0;
+        if (want > 0) {
+            frames = audio_source_frames(src, stage_pcm, want);
+            if (frames <= 0) {
+                if (frames < 0)
+                    return frames;
+                break;
+            }
+        }
+
+        uint32_t made = pcm_resample(&src->rs, out + 2 * filled, room - filled, stage_pcm, frames);
+        if (made == 0 && frames == 0)
+            break;
+        filled += made;
+    }
+
+    return filled * AUDIO_FRAME_SIZE;
+}
+
+/*
+ * Reads the next block of samples into a slab block. A clip in the stream format is read straight
+ * into it, the file or the cached clip is the only copy the CPU makes. Any other goes through
+ * `audio_convert_block`.
+ */
+static struct audio_block audio_read_block(struct audio_source* src) {
+    struct audio_block blk = { .mem = NULL, .len = 0 };
+
+    // blocks come back as the DMA plays them, so this paces the prefetch to the audio
+    int ret = audio_block_alloc(&blk.mem);
     if (ret < 0) {
-        LOG_ERR("I2S read file failed :( %d", ret);
-        // error doesnt need to disable I2S or SD storage
-        fs_close(&playing_wav.wav_file);
-        nrvc2_fs_unmount();
-        k_sem_give(&i2s_dev_sem); 
-        return ret;
+        blk.len = ret;
+        return blk;
     }
 
-    /// FIXME theres a better way to do this
-    // check if ret is less than buffer size, zero out rest, play, and exit
-    if (ret < sizeof(audio_buf)) {
-        LOG_WRN("I2S BIT abnormally SD small wav detected");
-        size_t to_zero = sizeof(audio_buf) - ret;
-        memset(((uint8_t*)audio_buf) + ret, 0, to_zero);
-        
-        ret = k_mem_slab_alloc(&i2s_tx_slab, (void**)&tx_block[blockno], K_MSEC(TX_QUEUE_FULL_TIMEOUT_MS));
-        if (ret < 0) {
-            // error doesnt necessarily need to disable I2S
-            LOG_ERR("I2S TX mem slab alloc for small buf failed: %d", ret);
-            fs_close(&playing_wav.wav_file);
-            k_sem_give(&i2s_dev_sem); 
-            return ret;
+    uint32_t start = k_cycle_get_32();
+
+    ssize_t len;
+    if (src->direct) {
+        len = audio_source_read(src, blk.mem, I2S_TX_BLOCKSIZE);
+        // a trailing partial frame would swap channels for the rest of the stream
+        if (len > 0)
+            len -= len % AUDIO_FRAME_SIZE;
+    } else {
+        len = audio_convert_block(src, blk.mem);
+    }
+
+    uint32_t cycles = k_cycle_get_32() - start;
+    uint32_t us = k_cyc_to_us_ceil32(cycles);
+    audio_stats.cycles += cycles;
+    if (us > audio_stats.read_max_us)
+        audio_stats.read_max_us = us;
+
+    if (len <= 0) {
+        audio_block_free(blk.mem);
+        blk.mem = NULL;
+    }
+
+    blk.len = len;
+    return blk;
+}
+
+/*
+ * Picks the voice to read for next: one being stopped first, then the one with the least read
+ * ahead, the higher priority on a tie, so an alert gets its first block before anything else.
+ * A voice with CONFIG_AUDIO_PREFETCH_BLOCKS read ahead is skipped, which keeps one voice from
+ * taking the slab blocks the others need.
+ */
+static struct audio_voice* audio_prefetch_pick() {
+    struct audio_voice* pick = NULL;
+    uint32_t pick_used = 0;
+
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        struct audio_voice* v = &voices[i];
+        if (!atomic_get(&v->reading))
+            continue;
+        if (atomic_get(&v->stop))
+            return v;
+
+        // one slot always stays free for the block that ends the stream
+        uint32_t used = k_msgq_num_used_get(&v->q);
+        if (used >= CONFIG_AUDIO_PREFETCH_BLOCKS)
+            continue;
+        if (pick == NULL || used < pick_used || (used == pick_used && v->req.prio > pick->req.prio)) {
+            pick = v;
+            pick_used = used;
         }
+    }
 
-        memcpy(tx_block[blockno], audio_buf, sizeof(audio_buf));
-        ret = i2s_write(role_devs->dev_i2s, tx_block[blockno], i2s_cfg.block_size);
-        if (ret < 0) {
-            LOG_ERR("I2S write small buf to dev failed: %d", ret);
-            role_devs->dev_i2s_stat = DEVSTAT_ERR;
-            k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]); // best effort slab free
-            fs_close(&playing_wav.wav_file);
-            k_sem_give(&i2s_dev_sem); 
-            return ret;
+    return pick;
+}
+
+/*
+ * Reads every voice ahead of the DMA into up to CONFIG_AUDIO_PREFETCH_BLOCKS slab blocks, so an
+ * SD stall only costs the lead it has built up. Every stream ends with a block without memory.
+ */
+static void audio_prefetch_thread(void* p1, void* p2, void* p3) {
+    for (;;) {
+        struct audio_voice* v = audio_prefetch_pick();
+        if (v == NULL) {
+            k_sem_take(&prefetch_kick, K_FOREVER);
+            continue;
+        }
+
+        struct audio_block blk = { .mem = NULL, .len = 0 };
+        if (!atomic_get(&v->stop))
+            blk = audio_read_block(&v->src);
+        if (blk.mem != NULL && atomic_get(&v->stop)) {
+            audio_block_free(blk.mem);
+            blk = (struct audio_block){ .mem = NULL, .len = 0 };
         }
 
-        // signal I2S device to start playing
+        // cleared first, the player may start the voice over as soon as the end is queued
+        if (blk.mem == NULL)
+            atomic_clear(&v->reading);
+
+        k_msgq_put(&v->q, &blk, K_FOREVER);
+        k_sem_give(&player_wake);
+    }
+}
+
+K_THREAD_DEFINE(audio_prefetch_tid, AUDIO_PREFETCH_STACK_SIZE, audio_prefetch_thread, NULL, NULL, NULL,
+    AUDIO_PREFETCH_PRIORITY, 0, 0);
+
+/*
+ * Hands a block to the driver, which frees it once played. If the DMA ran dry the driver
+ * stops with an error, so the stream is prepared and started again behind this block.
+ */
+static int audio_queue_block(struct audio_block* blk, bool* started) {
+    int ret = i2s_write(role_devs->dev_i2s, blk->mem, blk->len);
+    if (ret == -EIO && *started) {
+        audio_stats.underruns++;
+        ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_PREPARE);
+        if (ret == 0)
+            ret = i2s_write(role_devs->dev_i2s, blk->mem, blk->len);
+        *started = false;
+    }
+
+    if (ret < 0) {
+        LOG_ERR("I2S write to dev failed: %d", ret);
+        role_devs->dev_i2s_stat = DEVSTAT_ERR;
+        audio_block_free(blk->mem);
+        return ret;
+    }
+
+    // the driver frees it once played
+    atomic_dec(&blocks_held);
+
+    audio_stats.bytes += blk->len;
+    audio_stats.blocks++;
+    if (blk->len < I2S_TX_BLOCKSIZE)
+        audio_stats.short_blocks++;
+
+    if (!*started) {
         ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_START);
         if (ret < 0) {
-            LOG_ERR("I2S trigger start for small buf failed: %d", ret);
+            LOG_ERR("I2S trigger start failed: %d", ret);
             role_devs->dev_i2s_stat = DEVSTAT_ERR;
-            k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]);
-            fs_close(&playing_wav.wav_file);
-            nrvc2_fs_unmount();
-            k_sem_give(&i2s_dev_sem); 
             return ret;
         }
+        *started = true;
+    }
 
-        // signal I2S device to drain queue
-        k_msleep(1);
-        ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_DRAIN);
-        if (ret < 0) {
-            LOG_ERR("I2S trigger drain for small buf failed: %d", ret);
-            // error doesnt necessarily need to disable I2S
-            k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]); // best effort slab free
-            fs_close(&playing_wav.wav_file);
-            k_sem_give(&i2s_dev_sem); 
-            return ret;
+    return 0;
+}
+
+#ifdef CONFIG_AUDIO_CACHE
+// call with cache_lock held
+static struct audio_cache_entry* audio_cache_find(const char* path) {
+    for (int i = 0; i < CONFIG_AUDIO_CACHE_ENTRIES; i++) {
+        if (audio_cache[i].path[0] != '\0' && strcmp(audio_cache[i].path, path) == 0)
+            return &audio_cache[i];
+    }
+    return NULL;
+}
+
+// call with cache_lock held
+static void audio_cache_free(struct audio_cache_entry* entry) {
+    k_heap_free(&audio_cache_heap, entry->data);
+    cache_resident -= entry->len;
+    memset(entry, 0, sizeof(*entry));
+}
+
+// evicts the least recently used entry nobody is reading, call with cache_lock held
+static bool audio_cache_evict() {
+    struct audio_cache_entry* lru = NULL;
+
+    for (int i = 0; i < CONFIG_AUDIO_CACHE_ENTRIES; i++) {
+        struct audio_cache_entry* e = &audio_cache[i];
+        if (e->path[0] == '\0' || e->pinned || e->readers > 0)
+            continue;
+        if (lru == NULL || (int32_t)(e->last_used - lru->last_used) < 0)
+            lru = e;
+    }
+
+    if (lru == NULL)
+        return false;
+
+    audio_cache_free(lru);
+    audio_stats.evictions++;
+    return true;
+}
+
+/*
+ * Makes room for `len` bytes of `path` within CONFIG_AUDIO_CACHE_SIZE, evicting the least
+ * recently used clips. The entry comes back loading, with one reader, NULL if it does not fit.
+ * Call with cache_lock held.
+ */
+static struct audio_cache_entry* audio_cache_reserve(const char* path, const wav_file_t* wav, uint32_t len) {
+    struct audio_cache_entry* entry = NULL;
+
+    if (len == 0 || len > CONFIG_AUDIO_CACHE_SIZE)
+        return NULL;
+
+    while (cache_resident + len > CONFIG_AUDIO_CACHE_SIZE) {
+        if (!audio_cache_evict())
+            return NULL;
+    }
+
+    for (;;) {
+        for (int i = 0; i < CONFIG_AUDIO_CACHE_ENTRIES && entry == NULL; i++) {
+            if (audio_cache[i].path[0] == '\0')
+                entry = &audio_cache[i];
+        }
+
+        void* data = entry != NULL ? k_heap_alloc(&audio_cache_heap, len, K_NO_WAIT) : NULL;
+        if (data != NULL) {
+            strcpy(entry->path, path);
+            entry->wav = *wav;
+            entry->data = data;
+            entry->len = len;
+            entry->last_used = ++cache_clock;
+            entry->loading = true;
+            entry->readers = 1;
+            cache_resident += len;
+            return entry;
         }
 
-        k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]);
-        ret = fs_close(&playing_wav.wav_file);
+        // out of entries, or the heap is fragmented
+        entry = NULL;
+        if (!audio_cache_evict())
+            return NULL;
+    }
+}
+
+// a voice is done with `entry`, a loading entry is kept only if it was filled
+static void audio_cache_release(struct audio_cache_entry* entry, bool complete) {
+    k_mutex_lock(&cache_lock, K_FOREVER);
+
+    // a loading entry is never hit, so the voice filling it is its only reader
+    if (entry->loading && !complete)
+        audio_cache_free(entry);
+    else {
+        entry->loading = false;
+        entry->readers--;
+    }
+
+    k_mutex_unlock(&cache_lock);
+}
+#else
+// without the cache nothing is found or reserved, so nothing is ever released either
+static struct audio_cache_entry* audio_cache_find(const char* path) {
+    return NULL;
+}
+
+static struct audio_cache_entry* audio_cache_reserve(const char* path, const wav_file_t* wav, uint32_t len) {
+    return NULL;
+}
+
+static void audio_cache_release(struct audio_cache_entry* entry, bool complete) {
+}
+#endif
+
+// picks how `src` gets to the stream format, @returns -ENOTSUP if its rate is out of the resampler's reach
+static int audio_source_setup(struct audio_source* src) {
+    const wav_file_t* wav = &src->wav;
+
+    if (wav->audio_format == WAV_FORMAT_IMA_ADPCM && wav->block_align > sizeof(src->block)) {
+        LOG_ERR("I2S IMA ADPCM block of %u bytes too large", wav->block_align);
+        return -ENOTSUP;
+    }
+
+    src->resample = wav->sample_rate != I2S_SAMPLE_RATE_HZ;
+    src->direct = !src->resample && wav->audio_format == WAV_FORMAT_PCM
+        && wav->bits_per_sample == I2S_WORD_SIZE_BYTES * 8 && wav->num_channels == I2S_CHANNELS;
+    if (!src->resample)
+        return 0;
+
+    if (pcm_resampler_init(&src->rs, wav->sample_rate, I2S_SAMPLE_RATE_HZ) < 0) {
+        LOG_ERR("I2S unsupported sample rate %u", wav->sample_rate);
+        return -ENOTSUP;
+    }
+
+    return 0;
+}
+
+/*
+ * Sets `src` up to play `path`, from the cache if it holds the clip and from storage otherwise.
+ * A short clip read from storage is copied into a new cache entry as it streams.
+ */
+static int audio_open_source(const char* path, struct audio_source* src, struct audio_cache_entry** cached) {
+    memset(src, 0, sizeof(*src));
+    *cached = NULL;
+
+    if (role_devs->dev_i2s_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+
+    struct audio_cache_entry* entry = audio_cache_find(path);
+    if (entry != NULL && !entry->loading) {
+        entry->readers++;
+        entry->last_used = ++cache_clock;
+        audio_stats.hits++;
+        k_mutex_unlock(&cache_lock);
+
+        src->wav = entry->wav;
+        src->mem = entry->data;
+        src->len = entry->len;
+
+        int ret = audio_source_setup(src);
         if (ret < 0) {
-            LOG_ERR("I2S BIT SD close read test file failed");
-            role_devs->dev_sdcard_stat = DEVSTAT_ERR;
-            k_sem_give(&i2s_dev_sem); 
+            audio_cache_release(entry, true);
             return ret;
         }
 
-        // done playing small buffer
+        *cached = entry;
         return 0;
     }
 
-    // block is full, copy to slab and write, then increment blockno
-    ret = k_mem_slab_alloc(&i2s_tx_slab, (void**)&tx_block[blockno], K_MSEC(1000));
+    audio_stats.misses++;
+    k_mutex_unlock(&cache_lock);
+
+    if (role_devs->dev_sdcard_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    // held until audio_voice_close, so storage stays mounted under the stream
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    ret = open_parse_wav(path, &src->wav);
     if (ret < 0) {
-        LOG_ERR("I2S BIT SD mem slab alloc failed: %d", ret);
-        role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem); 
+        nrvc2_storage_release();
         return ret;
     }
 
-    memcpy(tx_block[blockno], audio_buf, sizeof(audio_buf));
-    ret = i2s_write(role_devs->dev_i2s, tx_block[blockno], i2s_cfg.block_size);
+    ret = audio_source_setup(src);
     if (ret < 0) {
-        LOG_ERR("I2S write to dev failed: %d", ret);
-        role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]);
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem); 
+        fs_close(&src->wav.wav_file);
+        nrvc2_storage_release();
         return ret;
     }
 
-    blockno = (blockno + 1) % I2S_NUM_BLOCKS;
-    // first block is primed, trigger i2s and start reading/writing rest of data;
-    ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_START);
+    src->len = src->wav.subchunk2_size;
+    if (src->len > AUDIO_CACHE_CLIP_MAX || entry != NULL) // entry means someone else is loading it
+        return 0;
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    entry = audio_cache_reserve(path, &src->wav, src->len);
+    k_mutex_unlock(&cache_lock);
+
+    if (entry != NULL) {
+        src->tee = entry->data;
+        *cached = entry;
+    }
+
+    return 0;
+}
+
+static void audio_complete(struct audio_request* req, int result) {
+    if (req->waiter != NULL) {
+        req->waiter->result = result;
+        k_sem_give(&req->waiter->started); // a clip that never left the queue is over as well
+        k_sem_give(&req->waiter->done);
+    }
+}
+
+// closes what `v` read from, a clip read to the end while streaming is now cached, a cut off one is not
+static void audio_voice_close(struct audio_voice* v) {
+    if (v->src.mem == NULL) {
+        fs_close(&v->src.wav.wav_file);
+        nrvc2_storage_release();
+    }
+
+    if (v->cached != NULL) {
+        bool complete = v->src.tee != NULL && v->src.pos == v->src.len;
+        audio_cache_release(v->cached, complete);
+        v->cached = NULL;
+    }
+}
+
+// ends the clip of `v`, the prefetch is done with it and it holds no slab block
+static void audio_voice_finish(struct audio_voice* v, int result) {
+    audio_voice_close(v);
+    audio_complete(&v->req, result);
+    v->active = false;
+}
+
+// stops the prefetch for `v` and frees everything it read ahead, up to the block that ends the stream
+static void audio_voice_cancel(struct audio_voice* v, int result) {
+    if (!v->ended) {
+        struct audio_block blk;
+
+        atomic_set(&v->stop, 1);
+        k_sem_give(&prefetch_kick);
+        do {
+            k_msgq_get(&v->q, &blk, K_FOREVER);
+            if (blk.mem != NULL)
+                audio_block_free(blk.mem);
+        } while (blk.mem != NULL);
+        v->ended = true;
+    }
+
+    if (v->next.mem != NULL) {
+        audio_block_free(v->next.mem);
+        v->next.mem = NULL;
+    }
+
+    audio_voice_finish(v, result);
+}
+
+static struct audio_voice* audio_voice_find(audio_handle_t handle) {
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        if (voices[i].active && voices[i].req.handle == handle)
+            return &voices[i];
+    }
+    return NULL;
+}
+
+static uint32_t audio_voice_count() {
+    uint32_t n = 0;
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++)
+        n += voices[i].active;
+    return n;
+}
+
+// highest priority of the voices playing, every voice below it is ducked
+static uint8_t audio_voice_top() {
+    uint8_t top = AUDIO_PRIO_LOW;
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        if (voices[i].active && voices[i].req.prio > top)
+            top = voices[i].req.prio;
+    }
+    return top;
+}
+
+/*
+ * Cuts the stream off. Every voice is stopped and its blocks freed, then DROP empties the driver
+ * queue and stops the DMA, which hands back the rest. Nothing new starts until every block
+ * is back, or the next stream would start short of blocks.
+ */
+static void audio_drop(int result) {
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        if (voices[i].active)
+            audio_voice_cancel(&voices[i], result);
+    }
+
+    if (player.started) {
+        i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_DROP);
+
+        k_timepoint_t end = sys_timepoint_calc(K_MSEC(TX_QUEUE_FULL_TIMEOUT_MS));
+        while (k_mem_slab_num_free_get(&i2s_tx_slab) < I2S_TX_BLOCKS) {
+            if (sys_timepoint_expired(end)) {
+                LOG_ERR("I2S slab blocks lost after drop: %u of %u free", k_mem_slab_num_free_get(&i2s_tx_slab), I2S_TX_BLOCKS);
+                role_devs->dev_i2s_stat = DEVSTAT_ERR;
+                break;
+            }
+            k_sleep(K_MSEC(1));
+        }
+    }
+
+    player.state = AUDIO_IDLE;
+    player.started = false;
+}
+
+// ends every voice read to the end with nothing left to mix
+static void audio_finish_ended() {
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        struct audio_voice* v = &voices[i];
+        if (v->active && v->ended && v->next.mem == NULL) {
+            if (v->first && v->result == 0)
+                LOG_WRN("I2S no samples in %s", v->req.path);
+            audio_voice_finish(v, v->result);
+        }
+    }
+}
+
+// the last voice ended, the driver plays out what it holds before the stream stops
+static void audio_end_stream() {
+    if (!player.started) {
+        audio_finish_ended();
+        player.state = AUDIO_IDLE;
+        return;
+    }
+
+    // all data is read, trigger i2s fifo drain
+    int ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_DRAIN);
     if (ret < 0) {
-        LOG_ERR("I2S trigger start failed: %d", ret);
+        LOG_ERR("I2S trigger drain failed: %d", ret);
         role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem); 
-        return ret;
+        audio_drop(ret);
+        return;
+    }
+
+    player.state = AUDIO_DRAINING;
+}
+
+// queues a clip behind all clips of its priority or higher, a full queue drops the lowest priority clip
+static void audio_pending_insert(struct audio_request* req) {
+    if (player.pending_count == AUDIO_PENDING_MAX) {
+        struct audio_request* last = &player.pending[AUDIO_PENDING_MAX - 1];
+        audio_stats.rejected++;
+        if (last->prio >= req->prio) {
+            audio_complete(req, -ENOBUFS);
+            return;
+        }
+        audio_complete(last, -ENOBUFS);
+        player.pending_count--;
+    }
+
+    uint32_t i = player.pending_count;
+    while (i > 0 && player.pending[i - 1].prio < req->prio) {
+        player.pending[i] = player.pending[i - 1];
+        i--;
     }
+    player.pending[i] = *req;
+    player.pending_count++;
+    atomic_set(&player_busy, 1);
+}
+
+static void audio_pending_remove(uint32_t i) {
+    memmove(&player.pending[i], &player.pending[i + 1], (player.pending_count - i - 1) * sizeof(player.pending[0]));
+    player.pending_count--;
+}
 
-    // loop until we reach the end of file
-    // read block, write block, increment blockno
-    // if block at blockno is in use by i2s, read data and wait for it to be free
-    // WARNING: this system zeroes the end of blocks if they are underfull
-    // might be able to pass true size of final block to i2s_write
-    for (;;) { 
-        // check if end of file reached
-        off_t file_pos = fs_tell(&playing_wav.wav_file);
-        if (file_pos >= playing_wav.filesize)
+// applies every request waiting in request_q
+static void audio_take_requests() {
+    struct audio_request req;
+
+    while (k_msgq_get(&request_q, &req, K_NO_WAIT) == 0) {
+        struct audio_voice* v = req.op != AUDIO_OP_PLAY ? audio_voice_find(req.handle) : NULL;
+
+        switch (req.op) {
+        case AUDIO_OP_PLAY:
+            // a draining stream cannot take new blocks, a clip above what it played cuts the tail off
+            if (player.state == AUDIO_DRAINING && req.prio > audio_voice_top()) {
+                audio_stats.preemptions++;
+                audio_drop(-ECANCELED);
+            }
+            audio_pending_insert(&req);
+            break;
+        case AUDIO_OP_STOP:
+            if (v != NULL) {
+                // the last voice takes the stream with it, its tail in the driver is dropped too
+                if (player.state == AUDIO_DRAINING || audio_voice_count() == 1)
+                    audio_drop(-ECANCELED);
+                else
+                    audio_voice_cancel(v, -ECANCELED);
+                break;
+            }
+            for (uint32_t i = 0; i < player.pending_count; i++) {
+                if (player.pending[i].handle == req.handle) {
+                    audio_complete(&player.pending[i], -ECANCELED);
+                    audio_pending_remove(i);
+                    break;
+                }
+            }
+            break;
+        case AUDIO_OP_GAIN:
+            if (v != NULL) {
+                v->gain = req.gain;
+                break;
+            }
+            for (uint32_t i = 0; i < player.pending_count; i++) {
+                if (player.pending[i].handle == req.handle)
+                    player.pending[i].gain = req.gain;
+            }
+            break;
+        case AUDIO_OP_HALT:
+            while (player.pending_count > 0) {
+                audio_complete(&player.pending[0], -ECANCELED);
+                audio_pending_remove(0);
+            }
+            if (player.state != AUDIO_IDLE)
+                audio_drop(-ECANCELED);
             break;
-        
-        // check difference betweeen file pos and filesize
-        off_t diff = playing_wav.filesize - file_pos;
-
-        // if difference is less than buffer size, read only remaining data
-        size_t to_read = diff > sizeof(audio_buf) ? sizeof(audio_buf) : diff;
-        
-        ret = fs_read(&playing_wav.wav_file, audio_buf, to_read);
-        if (ret < 0) {
-            LOG_ERR("I2S BIT SD mastercautiom.wav read failed :( %d", ret);
-            role_devs->dev_sdcard_stat = DEVSTAT_ERR;
-            fs_close(&playing_wav.wav_file);
-            nrvc2_fs_unmount();
-            k_sem_give(&i2s_dev_sem); 
-            return ret;
         }
+    }
+
+    atomic_set(&player_busy, player.state != AUDIO_IDLE || player.pending_count > 0);
+}
+
+// a free voice, or the lowest priority one if `prio` may cut it off, NULL if the clip has to wait
+static struct audio_voice* audio_voice_claim(uint8_t prio) {
+    struct audio_voice* lowest = NULL;
 
-        // if block is not full, zero out the rest
-        if (to_read < sizeof(audio_buf))
-            memset(((uint8_t*)audio_buf) + to_read, 0, sizeof(audio_buf) - to_read);
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        struct audio_voice* v = &voices[i];
+        if (!v->active)
+            return v;
+        // the newest of the lowest priority goes first, it has played the least
+        if (lowest == NULL || v->req.prio < lowest->req.prio
+            || (v->req.prio == lowest->req.prio && (int32_t)(v->req.submitted - lowest->req.submitted) > 0))
+            lowest = v;
+    }
+
+    if (lowest->req.prio >= prio)
+        return NULL;
+
+    audio_stats.preemptions++;
+    if (audio_voice_count() == 1)
+        audio_drop(-ECANCELED); // nothing else plays, so its tail in the driver goes as well
+    else
+        audio_voice_cancel(lowest, -ECANCELED);
+    return lowest;
+}
+
+// starts queued clips on free voices, the prefetch reads them ahead before they join the mix
+static void audio_start_pending() {
+    while (player.pending_count > 0) {
+        struct audio_voice* v = audio_voice_claim(player.pending[0].prio);
+        if (v == NULL)
+            return;
+
+        int ret = audio_open_source(player.pending[0].path, &v->src, &v->cached);
+        v->req = player.pending[0];
+        audio_pending_remove(0);
+
+        if (v->req.waiter != NULL)
+            k_sem_give(&v->req.waiter->started);
 
-        // try to alloc block at blockno
-        ret = k_mem_slab_alloc(&i2s_tx_slab, (void**)&tx_block[blockno], K_MSEC(1000));
         if (ret < 0) {
-            LOG_ERR("I2S BIT SD mem slab alloc failed (may have timed out): %d", ret);
-            role_devs->dev_i2s_stat = DEVSTAT_ERR;
-            fs_close(&playing_wav.wav_file);
-            k_sem_give(&i2s_dev_sem);
-            return ret;
+            audio_complete(&v->req, ret); // dont consider opening/parsing errors to disable I2S system
+            continue;
         }
 
-        memcpy(tx_block[blockno], audio_buf, sizeof(audio_buf));
-        ret = i2s_write(role_devs->dev_i2s, tx_block[blockno], i2s_cfg.block_size);
-        if (ret < 0) {
-            LOG_ERR("I2S write to dev failed: %d", ret);
-            role_devs->dev_i2s_stat = DEVSTAT_ERR;
-            k_mem_slab_free(&i2s_tx_slab, (void**)&tx_block[blockno]);
-            fs_close(&playing_wav.wav_file);
-            k_sem_give(&i2s_dev_sem);
-            return ret;
+        player.state = AUDIO_PLAYING;
+        v->next = (struct audio_block){ .mem = NULL, .len = 0 };
+        v->result = 0;
+        v->active = true;
+        v->live = false;
+        v->ended = false;
+        v->first = true;
+        v->gain = v->req.gain;
+        atomic_clear(&v->stop);
+        atomic_set(&v->reading, 1);
+        k_sem_give(&prefetch_kick);
+    }
+}
+
+// takes the next block of `v` off its queue, the one that ends the stream marks it ended
+static void audio_voice_pull(struct audio_voice* v) {
+    struct audio_block blk;
+
+    if (v->ended || v->next.mem != NULL || k_msgq_get(&v->q, &blk, K_NO_WAIT) < 0)
+        return;
+
+    k_sem_give(&prefetch_kick); // room to read into
+    if (blk.mem == NULL) {
+        v->ended = true;
+        v->result = blk.len;
+    } else {
+        v->next = blk;
+    }
+}
+
+/*
+ * The first block of `v` was queued behind `ahead` blocks, time to first sample by where the
+ * clip came from. The DMA starts it once those are played out. How far into the playing one
+ * it is cannot be seen, so it counts whole, and the time is at most a block late.
+ */
+static void audio_voice_first(struct audio_voice* v, uint32_t ahead) {
+    uint32_t us = k_cyc_to_us_ceil32(k_cycle_get_32() - v->req.submitted) + ahead * AUDIO_BLOCK_US;
+
+    v->first = false;
+    if (v->req.prio == AUDIO_PRIO_ALERT) {
+        audio_stats.alert_last_us = us;
+        audio_stats.alert_max_us = MAX(audio_stats.alert_max_us, us);
+    }
+    if (v->src.mem != NULL) {
+        audio_stats.ttfs_hit_last_us = us;
+        audio_stats.ttfs_hit_max_us = MAX(audio_stats.ttfs_hit_max_us, us);
+    } else {
+        audio_stats.ttfs_miss_last_us = us;
+        audio_stats.ttfs_miss_max_us = MAX(audio_stats.ttfs_miss_max_us, us);
+    }
+}
+
+/*
+ * Mixes the next block of every live voice into the longest of them and queues it. Voices below
+ * the highest priority playing are ducked to CONFIG_AUDIO_DUCK_PERCENT, and every gain change
+ * ramps over one block. A voice joins the mix once it is read ahead, an alert after one block.
+ * @returns false if a live voice is still waiting on the prefetch, or none is ready.
+ */
+static bool audio_mix_next() {
+    struct audio_voice* mixed[CONFIG_AUDIO_VOICES];
+    struct audio_voice* base = NULL;
+    uint32_t n = 0;
+    uint32_t playing = 0;
+
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++) {
+        struct audio_voice* v = &voices[i];
+        if (!v->active)
+            continue;
+
+        audio_voice_pull(v);
+        if (!v->live) {
+            uint32_t prime = v->req.prio == AUDIO_PRIO_ALERT ? 1 : CONFIG_AUDIO_PREFETCH_BLOCKS;
+            v->live = v->ended || !atomic_get(&v->reading) || (v->next.mem != NULL) + k_msgq_num_used_get(&v->q) >= prime;
         }
+        playing += !v->ended || v->next.mem != NULL;
 
-        // increment write blockno
-        blockno = (blockno + 1) % I2S_NUM_BLOCKS;
+        if (!v->live)
+            continue;
+        if (v->next.mem == NULL) {
+            if (!v->ended)
+                return false;
+            continue;
+        }
+
+        mixed[n++] = v;
+        if (base == NULL || v->next.len > base->next.len)
+            base = v;
     }
 
-    // all data is read, trigger i2s fifo drain
-    ret = i2s_trigger(role_devs->dev_i2s, I2S_DIR_TX, I2S_TRIGGER_DRAIN);
+    // a voice played out ends once something else still plays, the last one waits for the drain
+    if (playing > 0)
+        audio_finish_ended();
+
+    if (base == NULL)
+        return false;
+
+    uint32_t start = k_cycle_get_32();
+    uint8_t top = audio_voice_top();
+    int16_t duck = mixer_gain_percent(CONFIG_AUDIO_DUCK_PERCENT);
+
+    // the base voice is scaled in place first, the others are added on top of it
+    for (uint32_t i = 1; i < n; i++) {
+        if (mixed[i] == base) {
+            mixed[i] = mixed[0];
+            mixed[0] = base;
+        }
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        struct audio_voice* v = mixed[i];
+        int16_t gain = v->req.prio < top ? mixer_gain_mul(v->gain, duck) : v->gain;
+        int16_t from = v->first ? gain : v->applied;
+
+        if (v == base) {
+            mixer_scale_ramp(base->next.mem, base->next.len / sizeof(int16_t), from, gain);
+        } else {
+            mixer_add_ramp(base->next.mem, v->next.mem, v->next.len / sizeof(int16_t), from, gain);
+            audio_block_free(v->next.mem);
+            v->next.mem = NULL;
+        }
+        v->applied = gain;
+    }
+
+    audio_stats.mix_cycles += k_cycle_get_32() - start;
+    audio_stats.mix_voice_blocks += n;
+
+    struct audio_block out = base->next;
+    base->next.mem = NULL;
+
+    int ret = audio_queue_block(&out, &player.started);
     if (ret < 0) {
-        LOG_ERR("I2S trigger drain failed: %d", ret);
+        audio_drop(ret);
+        return true;
+    }
+
+    // mixed only with room in the driver, any more ahead of it is a block still being counted as read
+    uint32_t queued = audio_blocks_in_driver();
+    uint32_t ahead = queued > 0 ? MIN(queued - 1, AUDIO_QUEUE_AHEAD) : 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (mixed[i]->first)
+            audio_voice_first(mixed[i], ahead);
+    }
+
+    return true;
+}
+
+/*
+ * Owns the I2S device. Waits on new requests and read ahead blocks together, so a request is
+ * seen between any two blocks. The mix runs only AUDIO_QUEUE_AHEAD blocks ahead of the DMA,
+ * so a clip claimed now is in the next block the driver gets, and i2s_write never waits for room.
+ */
+static void audio_player_thread(void* p1, void* p2, void* p3) {
+    struct k_poll_event events[] = {
+        K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &request_q, 0),
+        K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &player_wake, 0),
+    };
+
+    for (int i = 0; i < CONFIG_AUDIO_VOICES; i++)
+        k_msgq_init(&voices[i].q, voices[i].q_buf, sizeof(struct audio_block), CONFIG_AUDIO_PREFETCH_BLOCKS + 1);
+
+    for (;;) {
+        // taken before looking at the voices, a block queued after that wakes the poll below
+        k_sem_take(&player_wake, K_NO_WAIT);
+        audio_take_requests();
+
+        switch (player.state) {
+        case AUDIO_IDLE:
+            if (player.pending_count > 0)
+                audio_start_pending();
+            else
+                k_poll(events, 1, K_FOREVER);
+            break;
+        case AUDIO_DRAINING:
+            // the driver frees each block once played, all back means the last one is out
+            if (k_mem_slab_num_free_get(&i2s_tx_slab) == I2S_TX_BLOCKS) {
+                audio_finish_ended();
+                player.state = AUDIO_IDLE;
+                player.started = false;
+            } else {
+                k_poll(events, 1, K_MSEC(1));
+            }
+            break;
+        case AUDIO_PLAYING: {
+            audio_start_pending();
+            // the driver frees blocks without telling anyone, so look again a fraction of a block on
+            if (player.started && audio_blocks_in_driver() > AUDIO_QUEUE_AHEAD) {
+                k_poll(events, 1, K_USEC(AUDIO_QUEUE_POLL_US));
+                break;
+            }
+            if (audio_mix_next())
+                break;
+
+            bool ended = true;
+            for (int i = 0; i < CONFIG_AUDIO_VOICES; i++)
+                ended &= !voices[i].active || (voices[i].ended && voices[i].next.mem == NULL);
+            if (ended) {
+                audio_end_stream();
+                break;
+            }
+
+            if (player.started && k_msgq_num_used_get(&request_q) == 0)
+                audio_stats.starved++;
+            k_poll(events, ARRAY_SIZE(events), K_FOREVER);
+            break;
+        }
+        }
+
+        events[0].state = K_POLL_STATE_NOT_READY;
+        events[1].state = K_POLL_STATE_NOT_READY;
+    }
+}
+
+K_THREAD_DEFINE(audio_player_tid, AUDIO_PLAYER_STACK_SIZE, audio_player_thread, NULL, NULL, NULL,
+    AUDIO_PLAYER_PRIORITY, 0, 0);
+
+static int audio_submit(const char* filename, enum audio_priority prio, struct audio_waiter* waiter) {
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    struct audio_cache_entry* entry = audio_cache_find(filename);
+    bool cached = entry != NULL && !entry->loading;
+    k_mutex_unlock(&cache_lock);
+
+    // Playing audio requires the I2S amp configured, and a ready SD card unless the clip is cached
+    if (role_devs->dev_i2s_stat != DEVSTAT_RDY || !atomic_get(&i2s_configured))
+        return -EDEVNOTRDY;
+    if (!cached && role_devs->dev_sdcard_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    if (strlen(filename) >= AUDIO_PATH_MAX)
+        return -ENAMETOOLONG;
+
+    struct audio_request req = {
+        .op = AUDIO_OP_PLAY,
+        .prio = prio,
+        .gain = MIXER_GAIN_UNITY,
+        .handle = (atomic_inc(&next_handle) % INT32_MAX) + 1,
+        .submitted = k_cycle_get_32(),
+        .waiter = waiter,
+    };
+    strcpy(req.path, filename);
+
+    int ret = k_msgq_put(&request_q, &req, K_NO_WAIT);
+    if (ret < 0) {
+        audio_stats.rejected++;
+        return -ENOBUFS;
+    }
+
+    atomic_set(&player_busy, 1);
+    return req.handle;
+}
+
+audio_handle_t audio_play(const char* filename, enum audio_priority prio) {
+    return audio_submit(filename, prio, NULL);
+}
+
+int audio_stop(audio_handle_t handle) {
+    struct audio_request req = { .op = AUDIO_OP_STOP, .handle = handle };
+    return k_msgq_put(&request_q, &req, K_MSEC(TX_QUEUE_FULL_TIMEOUT_MS));
+}
+
+int audio_set_gain(audio_handle_t handle, int16_t gain) {
+    if (gain < 0)
+        return -EINVAL;
+
+    struct audio_request req = { .op = AUDIO_OP_GAIN, .handle = handle, .gain = gain };
+    return k_msgq_put(&request_q, &req, K_MSEC(TX_QUEUE_FULL_TIMEOUT_MS));
+}
+
+int audio_play_file_blocking(const char* filename, k_timeout_t busy_timeout) {
+    if (K_TIMEOUT_EQ(busy_timeout, K_NO_WAIT) && atomic_get(&player_busy))
+        return -EBUSY;
+
+    struct audio_waiter waiter;
+    k_sem_init(&waiter.started, 0, 1);
+    k_sem_init(&waiter.done, 0, 1);
+
+    audio_handle_t handle = audio_submit(filename, AUDIO_PRIO_NORMAL, &waiter);
+    if (handle < 0)
+        return handle;
+
+    // K_NO_WAIT only meant not to queue behind another clip, which was checked above
+    k_timeout_t start_timeout = K_TIMEOUT_EQ(busy_timeout, K_NO_WAIT) ? K_FOREVER : busy_timeout;
+    if (k_sem_take(&waiter.started, start_timeout) < 0) {
+        audio_stop(handle);
+        k_sem_take(&waiter.done, K_FOREVER);
+        return -EAGAIN;
+    }
+
+    k_sem_take(&waiter.done, K_FOREVER);
+    return waiter.result;
+}
+
+int audio_halt() {
+    struct audio_request req = { .op = AUDIO_OP_HALT };
+    return k_msgq_put(&request_q, &req, K_MSEC(TX_QUEUE_FULL_TIMEOUT_MS));
+}
+
+int audio_init() {
+    if (role_devs->dev_i2s_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+    if (atomic_get(&i2s_configured))
+        return 0;
+
+    int ret = i2s_configure(role_devs->dev_i2s, I2S_DIR_TX, &i2s_cfg);
+    if (ret < 0) {
+        LOG_ERR("I2S configure failed: %d", ret);
         role_devs->dev_i2s_stat = DEVSTAT_ERR;
-        fs_close(&playing_wav.wav_file);
-        k_sem_give(&i2s_dev_sem);
         return ret;
     }
 
-    k_msleep(1);
+    atomic_set(&i2s_configured, 1);
+    return 0;
+}
+
+#ifdef CONFIG_AUDIO_CACHE
+// reads a whole clip into a pinned cache entry
+static int audio_cache_load(const char* path) {
+    wav_file_t wav;
+
+    int ret = open_parse_wav(path, &wav);
+    if (ret < 0)
+        return ret;
+
+    uint32_t len = wav.subchunk2_size;
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    bool known = audio_cache_find(path) != NULL;
+    struct audio_cache_entry* entry = known ? NULL : audio_cache_reserve(path, &wav, len);
+    k_mutex_unlock(&cache_lock);
 
-    ret = fs_close(&playing_wav.wav_file);
+    if (entry == NULL) {
+        fs_close(&wav.wav_file);
+        return known ? 0 : -ENOMEM;
+    }
+
+    uint32_t pos = 0;
+    while (pos < len) {
+        ssize_t n = fs_read(&wav.wav_file, entry->data + pos, len - pos);
+        if (n <= 0) {
+            ret = n < 0 ? n : -EIO;
+            break;
+        }
+        pos += n;
+    }
+    fs_close(&wav.wav_file);
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
     if (ret < 0) {
-        k_sem_give(&i2s_dev_sem);
+        audio_cache_free(entry);
+    } else {
+        entry->pinned = true;
+        entry->loading = false;
+        entry->readers = 0;
+    }
+    k_mutex_unlock(&cache_lock);
+
+    return ret;
+}
+
+int audio_cache_init() {
+    if ((role_devs->dev_i2s_stat != DEVSTAT_RDY) || (role_devs->dev_sdcard_stat != DEVSTAT_RDY))
+        return -EDEVNOTRDY;
+
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
         return ret;
+
+    char names[] = CONFIG_AUDIO_CACHE_PRELOAD;
+    char* save;
+    int loaded = 0;
+
+    for (char* name = strtok_r(names, " ", &save); name != NULL; name = strtok_r(NULL, " ", &save)) {
+        char path[AUDIO_PATH_MAX];
+        snprintf(path, sizeof(path), NRVC2_STORAGE_MP "/%s", name);
+
+        ret = audio_cache_load(path);
+        if (ret < 0)
+            LOG_ERR("Failed to cache %s (%d)", path, ret);
+        else
+            loaded++;
     }
-    
-    k_sem_give(&i2s_dev_sem);
+
+    nrvc2_storage_release();
+
+    return loaded;
+}
+
+int audio_cache_readers(const char* filename) {
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    struct audio_cache_entry* entry = audio_cache_find(filename);
+    int ret = entry != NULL && !entry->loading ? entry->readers : -ENOENT;
+    k_mutex_unlock(&cache_lock);
+
+    return ret;
+}
+#endif
+
+static int shell_audio_stats(const struct shell *shell, size_t argc, char **argv) {
+    (void)argc; (void)argv;
+
+    // cycles per second of audio, the CPU cost of streaming independent of clip length
+    uint64_t per_s = audio_stats.bytes > 0 ? audio_stats.cycles * AUDIO_BYTE_RATE / audio_stats.bytes : 0;
+    uint32_t block_us = AUDIO_BLOCK_US;
+
+    // this module only logs errors, so the report goes to the shell directly
+    shell_print(shell, "--- Audio streaming ---");
+    shell_print(shell, "Blocks\t\t%u (%u short)", audio_stats.blocks, audio_stats.short_blocks);
+    shell_print(shell, "Bytes\t\t%llu", audio_stats.bytes);
+    shell_print(shell, "Cycles/s audio\t%llu (%u Hz clock)", per_s, sys_clock_hw_cycles_per_sec());
+    shell_print(shell, "Read max\t%u us (%u us of audio per block)", audio_stats.read_max_us, block_us);
+    // SD bytes and bus time per second of audio, what the card takes from LoRa and the CAN controllers on the SPI bus
+    shell_print(shell, "SD\t\t%llu B/s audio, %llu%% bus time", audio_stats.bytes > 0
+        ? audio_stats.sd_bytes * AUDIO_BYTE_RATE / audio_stats.bytes : 0, audio_stats.bytes > 0
+        ? audio_stats.sd_cycles * AUDIO_BYTE_RATE * 100 / audio_stats.bytes / sys_clock_hw_cycles_per_sec() : 0);
+    shell_print(shell, "Mix\t\t%llu cycles/voice/block (%u voice blocks)", audio_stats.mix_voice_blocks > 0
+        ? audio_stats.mix_cycles / audio_stats.mix_voice_blocks : 0, audio_stats.mix_voice_blocks);
+    shell_print(shell, "Starved\t\t%u", audio_stats.starved);
+    shell_print(shell, "Underruns\t%u", audio_stats.underruns);
+    shell_print(shell, "Preempted\t%u", audio_stats.preemptions);
+    shell_print(shell, "Rejected\t%u", audio_stats.rejected);
+    // at worst one after another: the read of an alert's first block, the driver playing down to
+    // one block and a poll to notice, then that block ahead of it
+    shell_print(shell, "Alert latency\t%u us (max %u us, bound ~%u us)", audio_stats.alert_last_us,
+        audio_stats.alert_max_us, (AUDIO_QUEUE_AHEAD + 1) * block_us + AUDIO_QUEUE_POLL_US + audio_stats.read_max_us);
 
     return 0;
 }
 
+static int shell_audio_play(const struct shell *shell, size_t argc, char **argv) {
+    (void)argc;
 
-int audio_halt() {
-    return 0; // NYI
-}
\ No newline at end of file
+    enum audio_priority prio = AUDIO_PRIO_NORMAL;
+    if (argc == 3 && strcmp(argv[2], "low") == 0)
+        prio = AUDIO_PRIO_LOW;
+    else if (argc == 3 && strcmp(argv[2], "alert") == 0)
+        prio = AUDIO_PRIO_ALERT;
+    else if (argc == 3 && strcmp(argv[2], "normal") != 0) {
+        LOG_ERR("Usage: audio play <file> [low|normal|alert]");
+        return -EINVAL;
+    }
+
+    char path[AUDIO_PATH_MAX];
+    snprintf(path, sizeof(path), NRVC2_STORAGE_MP "/%s", argv[1]);
+
+    audio_handle_t handle = audio_play(path, prio);
+    if (handle < 0) {
+        LOG_ERR("Failed to play %s (%d)", path, handle);
+        return handle;
+    }
+
+    shell_print(shell, "Queued %s as %d", path, handle);
+    return 0;
+}
+
+static int shell_audio_stop(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc;
+    return audio_stop(strtol(argv[1], NULL, 10));
+}
+
+static int shell_audio_gain(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc;
+    return audio_set_gain(strtol(argv[1], NULL, 10), mixer_gain_percent(strtoul(argv[2], NULL, 10)));
+}
+
+static int shell_audio_halt(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+    return audio_halt();
+}
+
+static int shell_audio_cache(const struct shell *shell, size_t argc, char **argv) {
+    (void)argc; (void)argv;
+
+    uint32_t lookups = audio_stats.hits + audio_stats.misses;
+
+    shell_print(shell, "--- Audio clip cache ---");
+    shell_print(shell, "Hit rate\t%u%% (%u of %u)", lookups > 0 ? audio_stats.hits * 100 / lookups : 0,
+        audio_stats.hits, lookups);
+    shell_print(shell, "TTFS hit\t%u us (max %u us)", audio_stats.ttfs_hit_last_us, audio_stats.ttfs_hit_max_us);
+    shell_print(shell, "TTFS miss\t%u us (max %u us)", audio_stats.ttfs_miss_last_us, audio_stats.ttfs_miss_max_us);
+
+#ifdef CONFIG_AUDIO_CACHE
+    shell_print(shell, "Resident\t%u of %u B", cache_resident, CONFIG_AUDIO_CACHE_SIZE);
+    shell_print(shell, "Evictions\t%u", audio_stats.evictions);
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    for (int i = 0; i < CONFIG_AUDIO_CACHE_ENTRIES; i++) {
+        const struct audio_cache_entry* e = &audio_cache[i];
+        if (e->path[0] != '\0')
+            shell_print(shell, "%s\t%u B\t%s\t%u readers", e->path, e->len,
+                e->pinned ? "pinned" : e->loading ? "loading" : "lru", e->readers);
+    }
+    k_mutex_unlock(&cache_lock);
+#else
+    shell_print(shell, "Disabled, every clip streams from storage");
+#endif
+
+    return 0;
+}
+
+// mixes `voices` blocks into one `rounds` times, @returns the cycles per voice per block
+static uint32_t audio_mixbench_run(int16_t* acc, const int16_t* in, uint32_t voices, uint32_t rounds, int16_t from, int16_t to) {
+    uint32_t n = I2S_TX_BLOCKSIZE / sizeof(int16_t);
+    uint32_t start = k_cycle_get_32();
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        mixer_scale_ramp(acc, n, from, to);
+        for (uint32_t v = 1; v < voices; v++)
+            mixer_add_ramp(acc, in, n, from, to);
+    }
+
+    return (k_cycle_get_32() - start) / (rounds * voices);
+}
+
+static int shell_audio_mixbench(const struct shell *shell, size_t argc, char **argv) {
+    uint32_t voices = argc > 1 ? strtoul(argv[1], NULL, 10) : CONFIG_AUDIO_VOICES;
+    const uint32_t rounds = 64;
+    void* acc;
+    void* in;
+
+    if (voices == 0)
+        return -EINVAL;
+
+    // the benchmark borrows two playback blocks, so it runs only while nothing plays
+    if (atomic_get(&player_busy))
+        return -EBUSY;
+    if (k_mem_slab_alloc(&i2s_tx_slab, &acc, K_NO_WAIT) < 0)
+        return -ENOMEM;
+    if (k_mem_slab_alloc(&i2s_tx_slab, &in, K_NO_WAIT) < 0) {
+        k_mem_slab_free(&i2s_tx_slab, acc);
+        return -ENOMEM;
+    }
+
+    // loud noise, so the sums saturate as they would with several voices at full scale
+    uint32_t seed = 0x2545F491;
+    for (uint32_t i = 0; i < I2S_TX_BLOCKSIZE / sizeof(int16_t); i++) {
+        seed = seed * 1664525 + 1013904223;
+        ((int16_t*)acc)[i] = (int16_t)(seed >> 16);
+        ((int16_t*)in)[i] = (int16_t)(seed >> 8);
+    }
+
+    int16_t duck = mixer_gain_percent(CONFIG_AUDIO_DUCK_PERCENT);
+    uint32_t unity = audio_mixbench_run(acc, in, voices, rounds, MIXER_GAIN_UNITY, MIXER_GAIN_UNITY);
+    uint32_t steady = audio_mixbench_run(acc, in, voices, rounds, duck, duck);
+    uint32_t ramp = audio_mixbench_run(acc, in, voices, rounds, MIXER_GAIN_UNITY, duck);
+
+    k_mem_slab_free(&i2s_tx_slab, in);
+    k_mem_slab_free(&i2s_tx_slab, acc);
+
+    // one block of the stream, what the mix has to beat
+    uint32_t block_us = I2S_TX_BLOCKSIZE * 1000000ULL / AUDIO_BYTE_RATE;
+    uint32_t hz = sys_clock_hw_cycles_per_sec();
+
+    shell_print(shell, "--- Mixer, %u voices of %u B blocks ---", voices, I2S_TX_BLOCKSIZE);
+    shell_print(shell, "Unity\t\t%u cycles/voice/block (%u us)", unity, k_cyc_to_us_ceil32(unity));
+    shell_print(shell, "Gain\t\t%u cycles/voice/block (%u us)", steady, k_cyc_to_us_ceil32(steady));
+    shell_print(shell, "Ramp\t\t%u cycles/voice/block (%u us)", ramp, k_cyc_to_us_ceil32(ramp));
+    shell_print(shell, "Block\t\t%u us of %u Hz stereo (%u Hz clock)", block_us, I2S_SAMPLE_RATE_HZ, hz);
+
+    return 0;
+}
+
+static int shell_audio_adpcmbench(const struct shell *shell, size_t argc, char **argv) {
+    (void)argc; (void)argv;
+
+    const uint16_t channels = I2S_CHANNELS;
+    // the largest block played, or what one playback block holds
+    const uint32_t align = MIN(AUDIO_ADPCM_BLOCK_MAX, I2S_TX_BLOCKSIZE) / (4 * channels) * (4 * channels);
+    const uint32_t room = I2S_TX_BLOCKSIZE / AUDIO_FRAME_SIZE;
+    const uint32_t rounds = 64;
+    void* out;
+    void* in;
+
+    // the benchmark borrows two playback blocks, so it runs only while nothing plays
+    if (atomic_get(&player_busy))
+        return -EBUSY;
+    if (k_mem_slab_alloc(&i2s_tx_slab, &out, K_NO_WAIT) < 0)
+        return -ENOMEM;
+    if (k_mem_slab_alloc(&i2s_tx_slab, &in, K_NO_WAIT) < 0) {
+        k_mem_slab_free(&i2s_tx_slab, out);
+        return -ENOMEM;
+    }
+
+    // noise codes, so the step size walks the whole table, behind a valid header per channel
+    uint8_t* block = in;
+    uint32_t seed = 0x2545F491;
+    for (uint32_t i = 0; i < align; i++) {
+        seed = seed * 1664525 + 1013904223;
+        block[i] = (uint8_t)(seed >> 24);
+    }
+    for (uint16_t ch = 0; ch < channels; ch++)
+        block[4 * ch + 2] = 44;
+
+    // decodes one playback block worth of frames, block by block as the stream does
+    uint32_t block_frames = pcm_ima_block_frames(align, channels);
+    struct pcm_ima st = { 0 };
+    uint32_t start = k_cycle_get_32();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t filled = 0; filled < room;) {
+            if (st.pos == block_frames)
+                st.pos = 0;
+            uint32_t frames = MIN(room - filled, block_frames - st.pos);
+            pcm_ima_decode(&st, (int16_t*)out + 2 * filled, block, frames, channels);
+            filled += frames;
+        }
+    }
+    uint32_t decode = (k_cycle_get_32() - start) / rounds;
+
+    k_mem_slab_free(&i2s_tx_slab, in);
+    k_mem_slab_free(&i2s_tx_slab, out);
+
+    // SD bytes behind one playback block, and how long the bus is held for them at the rate measured so far
+    uint32_t block_us = I2S_TX_BLOCKSIZE * 1000000ULL / AUDIO_BYTE_RATE;
+    uint32_t adpcm = (uint64_t)room * align / block_frames;
+    uint64_t sd_bytes = audio_stats.sd_bytes;
+    uint32_t pcm_us = sd_bytes > 0 ? k_cyc_to_us_ceil32(audio_stats.sd_cycles * I2S_TX_BLOCKSIZE / sd_bytes) : 0;
+    uint32_t adpcm_us = sd_bytes > 0 ? k_cyc_to_us_ceil32(audio_stats.sd_cycles * adpcm / sd_bytes) : 0;
+
+    shell_print(shell, "--- IMA ADPCM, %u B blocks into %u B blocks ---", align, I2S_TX_BLOCKSIZE);
+    shell_print(shell, "Decode\t\t%u cycles/block (%u us of %u us)", decode, k_cyc_to_us_ceil32(decode), block_us);
+    shell_print(shell, "SD PCM\t\t%u B/block (%u us)", I2S_TX_BLOCKSIZE, pcm_us);
+    shell_print(shell, "SD ADPCM\t%u B/block (%u us)", adpcm, adpcm_us);
+    if (sd_bytes == 0)
+        shell_print(shell, "Play a clip from the SD card first to time the bus");
+
+    return 0;
+}
+
+// the clip `audio readbench` reads, static for its resampler and ADPCM block the bench never uses
+static struct audio_source readbench_src;
+
+/*
+ * Reads every sample of `src` into `block` a block at a time, straight in as the stream does, or
+ * through `bounce` and copied on as the player did before reading into the slab.
+ * @returns the cycles taken, `*bytes` set to the bytes read
+ */
+static uint64_t audio_readbench_run(struct audio_source* src, void* block, void* bounce, uint32_t* bytes) {
+    uint64_t cycles = 0;
+    ssize_t n;
+
+    src->pos = 0;
+    *bytes = 0;
+    if (fs_seek(&src->wav.wav_file, src->wav.data_offset, FS_SEEK_SET) < 0)
+        return 0;
+
+    do {
+        uint32_t start = k_cycle_get_32();
+        n = audio_source_read(src, bounce != NULL ? bounce : block, I2S_TX_BLOCKSIZE);
+        if (n > 0 && bounce != NULL)
+            memcpy(block, bounce, n);
+        cycles += k_cycle_get_32() - start;
+        *bytes += MAX(n, 0);
+    } while (n > 0);
+
+    return cycles;
+}
+
+static int shell_audio_readbench(const struct shell *shell, size_t argc, char **argv) {
+    (void)argc;
+
+    struct audio_source* src = &readbench_src;
+    const uint32_t passes = 3;
+    void* block;
+    void* bounce;
+
+    // the benchmark borrows two playback blocks and the card, so it runs only while nothing plays
+    if (atomic_get(&player_busy))
+        return -EBUSY;
+    if (role_devs->dev_sdcard_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    char path[AUDIO_PATH_MAX];
+    snprintf(path, sizeof(path), NRVC2_STORAGE_MP "/%s", argv[1]);
+
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    memset(src, 0, sizeof(*src));
+    ret = open_parse_wav(path, &src->wav);
+    if (ret < 0)
+        goto release;
+
+    ret = audio_source_setup(src);
+    if (ret == 0 && !src->direct) {
+        LOG_ERR("%s is converted on the way into the blocks, only the stream format is read straight in", path);
+        ret = -ENOTSUP;
+    }
+    if (ret < 0)
+        goto close;
+    src->len = src->wav.subchunk2_size;
+
+    if (k_mem_slab_alloc(&i2s_tx_slab, &block, K_NO_WAIT) < 0) {
+        ret = -ENOMEM;
+        goto close;
+    }
+    if (k_mem_slab_alloc(&i2s_tx_slab, &bounce, K_NO_WAIT) < 0) {
+        k_mem_slab_free(&i2s_tx_slab, block);
+        ret = -ENOMEM;
+        goto close;
+    }
+
+    // taking turns, so whatever the card or the filesystem caches favours neither
+    uint64_t sd_bytes = audio_stats.sd_bytes, sd_cycles = audio_stats.sd_cycles;
+    uint64_t direct = UINT64_MAX, copied = UINT64_MAX;
+    uint32_t bytes = 0;
+    for (uint32_t p = 0; p < passes; p++) {
+        direct = MIN(direct, audio_readbench_run(src, block, NULL, &bytes));
+        copied = MIN(copied, audio_readbench_run(src, block, bounce, &bytes));
+    }
+    audio_stats.sd_bytes = sd_bytes;
+    audio_stats.sd_cycles = sd_cycles;
+
+    k_mem_slab_free(&i2s_tx_slab, bounce);
+    k_mem_slab_free(&i2s_tx_slab, block);
+
+    if (bytes == 0) {
+        ret = -EIO;
+        goto close;
+    }
+
+    uint64_t direct_per_s = direct * AUDIO_BYTE_RATE / bytes;
+    uint64_t copied_per_s = copied * AUDIO_BYTE_RATE / bytes;
+
+    shell_print(shell, "--- %s, %u B into %u B blocks, best of %u ---", argv[1], bytes, I2S_TX_BLOCKSIZE, passes);
+    shell_print(shell, "Direct		%llu cycles/s audio", direct_per_s);
+    shell_print(shell, "Bounced		%llu cycles/s audio", copied_per_s);
+    shell_print(shell, "Saved		%lld cycles/s audio (%u Hz clock)", (int64_t)copied_per_s - (int64_t)direct_per_s,
+        sys_clock_hw_cycles_per_sec());
+
+close:
+    fs_close(&src->wav.wav_file);
+release:
+    nrvc2_storage_release();
+    return ret;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_audio,
+    SHELL_CMD_ARG(play, NULL, "Queue a WAV file from the SD card: play <file> [low|normal|alert]", shell_audio_play, 2, 1),
+    SHELL_CMD_ARG(stop, NULL, "Stop or dequeue a clip: stop <handle>", shell_audio_stop, 2, 0),
+    SHELL_CMD_ARG(gain, NULL, "Set the gain of a clip: gain <handle> <percent>", shell_audio_gain, 3, 0),
+    SHELL_CMD(halt, NULL, "Stop all audio output", shell_audio_halt),
+    SHELL_CMD(stats, NULL, "Print audio streaming cost and latency", shell_audio_stats),
+    SHELL_CMD(cache, NULL, "Print the clip cache, its hit rate and time to first sample", shell_audio_cache),
+    SHELL_CMD_ARG(mixbench, NULL, "Time the mixer on synthetic blocks: mixbench [voices]", shell_audio_mixbench, 1, 1),
+    SHELL_CMD(adpcmbench, NULL, "Time IMA ADPCM decoding and the SD reads it saves", shell_audio_adpcmbench),
+    SHELL_CMD_ARG(readbench, NULL, "Time reading a clip straight into blocks against a bounce buffer: readbench <file>", shell_audio_readbench, 2, 0),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(audio, &sub_audio, "Audio playback", NULL);
@@ -4,15 +4,59 @@
 #include <zephyr/fs/fs.h>
 #include <zephyr/kernel.h>
 
+/// Clip priority, a clip ducks whatever plays at a lower priority, and cuts it off if no voice is free
+enum audio_priority {
+    AUDIO_PRIO_LOW = 0,     // chimes and other background sounds
+    AUDIO_PRIO_NORMAL,      // spoken messages
+    AUDIO_PRIO_ALERT,       // master caution, heard once the block playing and the one queued behind it are out
+};
+
+/// Identifies a queued clip, always > 0
+typedef int32_t audio_handle_t;
+
 /**
- * @brief Plays the WAV file in the storage device at path `filename`. 
+ * @brief Queues the WAV file in the storage device at path `filename` and returns at once.
+ * Up to `CONFIG_AUDIO_VOICES` clips play at once, mixed into one stream, the rest wait
+ * highest priority first and in order within a priority. With every voice busy, a clip of
+ * higher priority than the lowest one playing cuts that one off. The player mounts storage
+ * for as long as a clip streams from it, the caller need not.
+ * @param filename the full path to the WAV file to play
+ * @param prio the clip priority
+ * @returns a handle for `audio_stop` on success, `errno < 0` on failure.
+ * @retval -EDEVNOTRDY if the SD card or I2S amp is not ready, or `audio_init` was not called.
+ * @retval -ENOBUFS if the request queue is full.
+ */
+audio_handle_t audio_play(const char* filename, enum audio_priority prio);
+
+/**
+ * @brief Stops the clip with `handle` if it plays, or takes it out of the queue.
+ * Does nothing if the clip already ended.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EAGAIN if the request queue stayed full.
+ */
+int audio_stop(audio_handle_t handle);
+
+/**
+ * @brief Sets the gain of the clip with `handle`, playing or queued. The change ramps in over
+ * one block. Clips start at unity gain.
+ * @param handle the clip, from `audio_play`
+ * @param gain Q15 gain, `MIXER_GAIN_UNITY` to `MIXER_GAIN_MUTE`
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EINVAL if `gain` is negative.
+ * @retval -EAGAIN if the request queue stayed full.
+ */
+int audio_set_gain(audio_handle_t handle, int16_t gain);
+
+/**
+ * @brief Plays the WAV file in the storage device at path `filename` at `AUDIO_PRIO_NORMAL`.
  * This function call returns when the audio transmission is complete.
- * If the I2S device is busy, the thread blocks up until `busy_timeout`. 
+ * If other clips are queued, the thread blocks up until `busy_timeout` for its turn. 
  * @param filename the full path to the WAV file to play
  * @param busy_timeout the maximum timeout to wait for the I2S device to be available. 
  * @returns 0 on success, `errno < 0` on failure. 
  * @retval -EAGAIN when timeout timer expires.
  * @retval -EBUSY if `K_NO_WAIT` was specified, and a stream is in progress.
+ * @retval -ECANCELED if a higher priority clip, `audio_stop` or `audio_halt` cut it off.
  * @retval `errno < 0` for other I2S/MMIO/Zephyr errors. 
  */
 int audio_play_file_blocking(const char* filename, k_timeout_t busy_timeout);
@@ -30,9 +74,39 @@ inline int audio_play_file_blocking_forever(const char* filename) {
 }
 
 /**
- * @brief Signal to the I2S audio device to halt transmission
+ * @brief Configures the I2S amp for the one stream format every clip is converted to, 16 bit
+ * stereo at `CONFIG_AUDIO_SAMPLE_RATE`. Clips of any sample rate, 8 to 32 bit PCM or IMA ADPCM
+ * and mono or stereo then play without reconfiguring it. IMA ADPCM takes a quarter of the SD reads
+ * and cache space of 16 bit PCM. Call once at boot, before anything plays.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EDEVNOTRDY if the I2S amp is not ready.
+ * @retval `errno < 0` for I2S errors.
+ */
+int audio_init();
+
+/**
+ * @brief Loads the clips in `CONFIG_AUDIO_CACHE_PRELOAD` into RAM, where they stay. A cached
+ * clip starts without touching storage, and plays even with storage unmounted. Clips up to
+ * `CONFIG_AUDIO_CACHE_CLIP_MAX` bytes are also cached as they play, within the
+ * `CONFIG_AUDIO_CACHE_SIZE` budget, least recently used first out. Call once at boot, only built with `CONFIG_AUDIO_CACHE`.
+ * @returns number of clips loaded, `errno < 0` on failure.
+ * @retval -EDEVNOTRDY if the SD card or I2S amp is not ready.
+ * @retval `errno < 0` for other fs errors.
+ */
+int audio_cache_init();
+
+/**
+ * @brief Counts the voices playing the cached clip at path `filename`. An entry is evicted only
+ * once none are left, however many voices share it. Only built with `CONFIG_AUDIO_CACHE`.
+ * @returns number of voices reading the clip, `errno < 0` on failure.
+ * @retval -ENOENT if the cache does not hold the clip, or is still filling it.
+ */
+int audio_cache_readers(const char* filename);
+
+/**
+ * @brief Stops every clip playing and empties the queue. Output stops within about one block.
  * @returns 0 on success, `errno < 0` on failure. 
- * @retval `errno < 0` for errors.
+ * @retval -EAGAIN if the request queue stayed full.
  */
 int audio_halt();
 
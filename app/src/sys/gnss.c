@@ -0,0 +1,384 @@
+#include "gnss.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/crc.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+#include "../roles.h"
+#include "../nrvc2_errno.h"
+#include "storage.h"
+
+#define GNSS_RECORD_PATH NRVC2_STORAGE_MP "/GNSS.BIN"
+#define GNSS_RECORD_MAGIC 0x53534E47 // "GNSS"
+#define GNSS_RECORD_VERSION 1
+// broadcast ephemeris is good for about 4 hours, a saved fix younger than that is a hot start
+#define GNSS_HOT_START_AGE_US (4LL * 60 * 60 * 1000 * 1000)
+#define GNSS_WORKQ_STACK_SIZE 2048
+#define GNSS_WORKQ_PRIORITY 10
+
+LOG_MODULE_REGISTER(gnss, LOG_LEVEL_INF);
+
+enum gnss_start {
+    GNSS_START_COLD,    // nothing saved to aid with
+    GNSS_START_WARM,    // aided with a position older than the ephemeris
+    GNSS_START_HOT,     // aided with a position younger than the ephemeris
+    GNSS_START_COUNT,
+    GNSS_START_UNKNOWN = GNSS_START_COUNT
+};
+
+static const char* const gnss_start_str[] = {"cold", "warm", "hot", "unknown"};
+
+struct gnss_record {
+    uint32_t magic;
+    uint32_t version;
+    struct ufirebirdii_fix fix;             // last valid fix
+    uint32_t ttff_ms[GNSS_START_COUNT];     // last measured ttff per start kind, 0 if never
+    uint32_t crc;                           // crc32_ieee of everything above
+};
+
+static struct gnss_record record;
+static bool record_loaded = false;          // record.fix came from storage, not from this boot
+static enum gnss_start boot_start = GNSS_START_UNKNOWN;
+static bool ttff_saved = false;
+static K_MUTEX_DEFINE(gnss_lock);
+
+// storage writes block for a while, keep them off the system workqueue the driver frames on
+K_THREAD_STACK_DEFINE(gnss_workq_stack, GNSS_WORKQ_STACK_SIZE);
+static struct k_work_q gnss_workq;
+static struct k_work_delayable save_work;
+static struct ufirebirdii_fix_callback first_fix_cb;
+
+// parked duty cycle, park_work runs it on gnss_workq so the receiver is only touched from there
+static atomic_t parked;
+static bool awake = true;
+static struct k_work_delayable park_work;
+
+static uint32_t gnss_record_crc(const struct gnss_record* rec) {
+    return crc32_ieee((const uint8_t*)rec, offsetof(struct gnss_record, crc));
+}
+
+static int gnss_load_record() {
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+
+    ret = fs_open(&file, GNSS_RECORD_PATH, FS_O_READ);
+    if (ret == 0) {
+        ssize_t len = fs_read(&file, &record, sizeof(record));
+        fs_close(&file);
+
+        if (len < 0)
+            ret = len;
+        else if (len != sizeof(record) || record.magic != GNSS_RECORD_MAGIC ||
+                record.version != GNSS_RECORD_VERSION || record.crc != gnss_record_crc(&record))
+            ret = -EBADMSG;
+    }
+
+    nrvc2_storage_release();
+
+    if (ret < 0)
+        memset(&record, 0, sizeof(record));
+
+    return ret;
+}
+
+static int gnss_write_record() {
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    record.magic = GNSS_RECORD_MAGIC;
+    record.version = GNSS_RECORD_VERSION;
+    record.crc = gnss_record_crc(&record);
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+
+    // same size every time, overwriting in place needs no truncate
+    ret = fs_open(&file, GNSS_RECORD_PATH, FS_O_CREATE | FS_O_WRITE);
+    if (ret == 0) {
+        ssize_t len = fs_write(&file, &record, sizeof(record));
+        int close_ret = fs_close(&file);
+
+        if (len < 0)
+            ret = len;
+        else if (len != sizeof(record))
+            ret = -EIO;
+        else
+            ret = close_ret;
+    }
+
+    nrvc2_storage_release();
+
+    return ret;
+}
+
+// which start this boot was is only known once the first fix says what time it is now
+static enum gnss_start gnss_classify(const struct ufirebirdii_fix* first) {
+    if (!record_loaded)
+        return GNSS_START_COLD;
+
+    const uint8_t dated = UFBII_FIX_HAS_TIME | UFBII_FIX_HAS_DATE;
+    if ((first->fields & dated) != dated || (record.fix.fields & dated) != dated)
+        return GNSS_START_WARM;
+
+    int64_t age = ufirebirdii_utc_to_unix_us(&first->utc) - ufirebirdii_utc_to_unix_us(&record.fix.utc);
+    return (age >= 0 && age < GNSS_HOT_START_AGE_US) ? GNSS_START_HOT : GNSS_START_WARM;
+}
+
+int gnss_save() {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    struct ufirebirdii_fix fix;
+    int ret = ufirebirdii_get_fix(role_devs->dev_ufirebirdii, &fix);
+    if (ret < 0)
+        return ret;
+
+    struct ufirebirdii_stats stats;
+    ufirebirdii_get_stats(role_devs->dev_ufirebirdii, &stats);
+
+    k_mutex_lock(&gnss_lock, K_FOREVER);
+
+    if (!record_loaded && ttff_saved && fix.epoch == record.fix.epoch) {
+        // nothing new since the last save, the receiver is in standby
+        k_mutex_unlock(&gnss_lock);
+        return 0;
+    }
+
+    if (boot_start == GNSS_START_UNKNOWN)
+        boot_start = gnss_classify(&fix);
+    if (!ttff_saved && stats.ttff_ms != 0)
+        record.ttff_ms[boot_start] = stats.ttff_ms;
+
+    record.fix = fix;
+    record_loaded = false;
+    ret = gnss_write_record();
+    if (ret == 0)
+        ttff_saved = true;
+
+    k_mutex_unlock(&gnss_lock);
+
+    return ret;
+}
+
+static void gnss_save_work(struct k_work* work) {
+    int ret = gnss_save();
+    if (ret < 0 && ret != -EAGAIN)
+        LOG_WRN("Failed to save last fix (%d)", ret);
+
+    k_work_reschedule_for_queue(&gnss_workq, &save_work, K_SECONDS(CONFIG_GNSS_SAVE_INTERVAL));
+}
+
+/*
+ * While parked the receiver sleeps in standby for CONFIG_GNSS_PARK_INTERVAL, then wakes until
+ * it has a fix (or CONFIG_GNSS_PARK_FIX_TIMEOUT runs out), which is saved before it sleeps again.
+ */
+static void gnss_park_work(struct k_work* work) {
+    const struct device* dev = role_devs->dev_ufirebirdii;
+    int ret;
+
+    if (atomic_get(&parked) && awake) {
+        ret = gnss_save();
+        if (ret < 0 && ret != -EAGAIN)
+            LOG_WRN("Failed to save last fix (%d)", ret);
+
+        ret = ufirebirdii_stop(dev);
+        if (ret < 0) {
+            LOG_WRN("Failed to put receiver in standby (%d)", ret);
+            k_work_reschedule_for_queue(&gnss_workq, &park_work, K_SECONDS(CONFIG_GNSS_PARK_INTERVAL));
+            return;
+        }
+
+        awake = false;
+        k_work_reschedule_for_queue(&gnss_workq, &park_work, K_SECONDS(CONFIG_GNSS_PARK_INTERVAL));
+    } else if (!awake) {
+        ret = ufirebirdii_start(dev);
+        if (ret < 0 && ret != -EALREADY) {
+            LOG_WRN("Failed to wake receiver (%d)", ret);
+            k_work_reschedule_for_queue(&gnss_workq, &park_work, K_SECONDS(CONFIG_GNSS_PARK_INTERVAL));
+            return;
+        }
+
+        awake = true;
+        if (atomic_get(&parked))
+            k_work_reschedule_for_queue(&gnss_workq, &park_work, K_SECONDS(CONFIG_GNSS_PARK_FIX_TIMEOUT));
+    }
+}
+
+// runs on the driver's rx work, only pulls work forward so nothing blocks the driver
+static void gnss_first_fix(const struct device* dev, struct ufirebirdii_fix_callback* cb, const struct ufirebirdii_fix* fix) {
+    if (!fix->valid)
+        return;
+
+    if (!ttff_saved)
+        k_work_reschedule_for_queue(&gnss_workq, &save_work, K_NO_WAIT);
+    if (atomic_get(&parked))
+        k_work_reschedule_for_queue(&gnss_workq, &park_work, K_NO_WAIT); // fix is in, back to sleep
+}
+
+int gnss_set_parked(bool park) {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    atomic_set(&parked, park);
+    k_work_reschedule_for_queue(&gnss_workq, &park_work, K_NO_WAIT);
+    return 0;
+}
+
+int gnss_init() {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    const struct device* dev = role_devs->dev_ufirebirdii;
+
+    int ret = gnss_load_record();
+    if (ret == 0) {
+        record_loaded = true;
+
+        // no clock survives power off, the saved time is stale and would mislead the receiver
+        struct ufirebirdii_fix aid = record.fix;
+        aid.fields &= ~(UFBII_FIX_HAS_TIME | UFBII_FIX_HAS_DATE);
+
+        ret = ufirebirdii_aid(dev, &aid);
+        if (ret < 0)
+            LOG_WRN("Receiver did not take position aiding (%d)", ret);
+        else
+            LOG_INF("Aided with last fix %d, %d", record.fix.latitude, record.fix.longitude);
+    } else {
+        LOG_INF("No saved fix (%d), cold start", ret);
+    }
+
+    const struct k_work_queue_config workq_cfg = {.name = "gnss_workq"};
+    k_work_queue_start(&gnss_workq, gnss_workq_stack, K_THREAD_STACK_SIZEOF(gnss_workq_stack),
+        GNSS_WORKQ_PRIORITY, &workq_cfg);
+    k_work_init_delayable(&save_work, gnss_save_work);
+    k_work_init_delayable(&park_work, gnss_park_work);
+    k_work_schedule_for_queue(&gnss_workq, &save_work, K_SECONDS(CONFIG_GNSS_SAVE_INTERVAL));
+
+    ufirebirdii_init_fix_callback(&first_fix_cb, gnss_first_fix, 0);
+    return ufirebirdii_add_fix_callback(dev, &first_fix_cb);
+}
+
+static int shell_gnss_stats(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY) {
+        LOG_WRN("UFirebird II not ready");
+        return -ENODEV;
+    }
+
+    struct ufirebirdii_stats stats;
+    ufirebirdii_get_stats(role_devs->dev_ufirebirdii, &stats);
+
+    LOG_INF("--- GNSS ingest ---");
+    LOG_INF("RX bytes\t%u", stats.bytes_rx);
+    LOG_INF("Dropped\t\t%u (%u overruns)", stats.bytes_dropped, stats.overruns);
+    LOG_INF("Sentences\t%u", stats.sentences);
+    LOG_INF("Checksum err\t%u", stats.checksum_errors);
+    LOG_INF("Unsupported\t%u", stats.unsupported);
+    LOG_INF("Parse err\t%u", stats.parse_errors);
+    LOG_INF("Ring peak\t%u B", stats.ring_high_water);
+    LOG_INF("Handler max\t%u us", stats.handler_max_us);
+
+    // the ingest cost independent of the output rate, and the UART rate it could keep up with
+    uint32_t hz = sys_clock_hw_cycles_per_sec();
+    LOG_INF("Per sentence\t%u cycles (%u Hz clock)", stats.sentences > 0
+        ? (uint32_t)(stats.handler_cycles / stats.sentences) : 0, hz);
+    LOG_INF("Capacity\t%u B/s", stats.handler_cycles > 0
+        ? (uint32_t)((uint64_t)stats.bytes_rx * hz / stats.handler_cycles) : 0);
+
+    struct ufirebirdii_timebase tb;
+    int ret = ufirebirdii_get_timebase(role_devs->dev_ufirebirdii, &tb);
+    if (ret != -ENOTSUP)
+        LOG_INF("PPS latency\t%u us (max %u us)", tb.latency_us, tb.latency_max_us);
+
+    return 0;
+}
+
+static int shell_gnss_ttff(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY) {
+        LOG_WRN("UFirebird II not ready");
+        return -ENODEV;
+    }
+
+    struct ufirebirdii_stats stats;
+    ufirebirdii_get_stats(role_devs->dev_ufirebirdii, &stats);
+
+    k_mutex_lock(&gnss_lock, K_FOREVER);
+
+    LOG_INF("--- GNSS time to first fix ---");
+    if (stats.ttff_ms == 0)
+        LOG_INF("This boot\tno fix yet (%u ms)", k_uptime_get_32());
+    else
+        LOG_INF("This boot\t%u ms, %s start", stats.ttff_ms, gnss_start_str[boot_start]);
+    if (stats.resumes > 0)
+        LOG_INF("Reacquire\t%u ms (%u resumes)", stats.reacq_ms, stats.resumes);
+    if (stats.standby_errors > 0)
+        LOG_INF("Standby\t%u stops not confirmed", stats.standby_errors);
+
+    for (int i = 0; i < GNSS_START_COUNT; i++) {
+        if (record.ttff_ms[i] == 0)
+            LOG_INF("Last %s\t-", gnss_start_str[i]);
+        else
+            LOG_INF("Last %s\t%u ms", gnss_start_str[i], record.ttff_ms[i]);
+    }
+
+    k_mutex_unlock(&gnss_lock);
+
+    return 0;
+}
+
+static int shell_gnss_save(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    int ret = gnss_save();
+    if (ret < 0)
+        LOG_ERR("Failed to save last fix (%d)", ret);
+    else
+        LOG_INF("Saved last fix to " GNSS_RECORD_PATH);
+
+    return ret;
+}
+
+static int shell_gnss_park(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell;
+
+    bool park;
+    if (argc == 2 && strcmp(argv[1], "on") == 0)
+        park = true;
+    else if (argc == 2 && strcmp(argv[1], "off") == 0)
+        park = false;
+    else {
+        LOG_ERR("Usage: gnss park <on|off>");
+        return -EINVAL;
+    }
+
+    int ret = gnss_set_parked(park);
+    if (ret < 0)
+        LOG_ERR("Failed to %s park duty cycle (%d)", park ? "start" : "stop", ret);
+    else
+        LOG_INF("Park duty cycle %s", park ? "on" : "off");
+
+    return ret;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_gnss,
+    SHELL_CMD(stats, NULL, "Print GNSS ingest counters", shell_gnss_stats),
+    SHELL_CMD(ttff, NULL, "Print time to first fix for cold, warm and hot starts", shell_gnss_ttff),
+    SHELL_CMD(save, NULL, "Save the last fix for the next start", shell_gnss_save),
+    SHELL_CMD_ARG(park, NULL, "Duty cycle the receiver while parked: park <on|off>", shell_gnss_park, 2, 0),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(gnss, &sub_gnss, "GNSS utilities", NULL);
@@ -0,0 +1,39 @@
+#ifndef GNSS_H
+#define GNSS_H
+
+#include <errno.h>
+#include <stdbool.h>
+
+/**
+ * @brief Loads the last fix saved to storage and injects it into the UFirebird II as
+ *      aiding, then starts saving the latest valid fix every `CONFIG_GNSS_SAVE_INTERVAL`
+ *      seconds. Call once after `role_config()`.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ * @retval `errno < 0` for other Zephyr errors. A missing or unreadable record is not one,
+ *      the receiver just does a cold start.
+ */
+int gnss_init();
+
+/**
+ * @brief Saves the latest valid fix and the measured time to first fix to storage now.
+ *      Call before powering down so the next boot can warm start from it.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ * @retval `-EAGAIN` if there has been no valid fix to save yet.
+ * @retval `errno < 0` for other fs errors.
+ */
+int gnss_save();
+
+/**
+ * @brief Starts or stops the parked duty cycle. While parked the receiver sleeps in standby
+ *      for `CONFIG_GNSS_PARK_INTERVAL` seconds, then wakes until it has a fix or
+ *      `CONFIG_GNSS_PARK_FIX_TIMEOUT` seconds pass, saves the fix and sleeps again.
+ *      Leaving park wakes the receiver for good.
+ * @param park true when the vehicle parks, false when it drives again
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ */
+int gnss_set_parked(bool park);
+
+#endif // GNSS_H
@@ -0,0 +1,91 @@
+#include "history.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+#include "../roles.h"
+#include "../nrvc2_errno.h"
+
+// about what one LoRa frame carries
+#define HISTORY_FRAME_SIZE 200
+
+LOG_MODULE_REGISTER(history, LOG_LEVEL_INF);
+
+static struct track history;
+static struct ufirebirdii_fix_callback history_cb;
+
+// runs on the driver's rx work, a few float ops and a handful of bytes per fix
+static void history_fix(const struct device* dev, struct ufirebirdii_fix_callback* cb, const struct ufirebirdii_fix* fix) {
+    track_add_fix(&history, fix);
+}
+
+int history_init() {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    track_init(&history, CONFIG_TRACK_MAX_ERROR_M);
+
+    ufirebirdii_init_fix_callback(&history_cb, history_fix, 0);
+    return ufirebirdii_add_fix_callback(role_devs->dev_ufirebirdii, &history_cb);
+}
+
+int history_encode(uint32_t skip, uint8_t* buf, size_t len, uint32_t* points) {
+    track_flush(&history);
+    return track_encode(&history, skip, buf, len, points);
+}
+
+static int shell_track_stats(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    struct track_stats stats = history.stats;
+    uint32_t bytes = track_bytes_used(&history);
+    uint32_t raw = stats.fixes * sizeof(struct ufirebirdii_fix);
+
+    LOG_INF("--- Track history ---");
+    LOG_INF("Fixes\t\t%u", stats.fixes);
+    LOG_INF("Points\t\t%u kept, %u stored, %u evicted", history.count, stats.points, stats.evicted);
+    LOG_INF("Bytes\t\t%u of %u", bytes, CONFIG_TRACK_BUFFER_SIZE);
+    LOG_INF("Reduction\t%ux vs raw fixes", raw / MAX(bytes, 1));
+    LOG_INF("Max error\t%u m", history.max_error_m);
+
+    return 0;
+}
+
+static int shell_track_dump(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    uint8_t frame[HISTORY_FRAME_SIZE];
+    uint32_t skip = 0;
+    uint32_t points;
+    int frames = 0;
+    int len;
+
+    // goes through the same frames a radio would send, so this also checks they decode
+    while ((len = history_encode(skip, frame, sizeof(frame), &points)) > 0) {
+        const uint8_t* pos = frame;
+        struct track_point point;
+        bool first = true;
+
+        while (track_decode(&pos, frame + len, &point, first) == 0) {
+            first = false;
+            LOG_INF("%u\t%d\t%d", point.time, point.lat * CONFIG_TRACK_RESOLUTION, point.lon * CONFIG_TRACK_RESOLUTION);
+        }
+
+        skip += points;
+        frames++;
+    }
+
+    LOG_INF("%u points in %d frames of %u B", skip, frames, HISTORY_FRAME_SIZE);
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_track,
+    SHELL_CMD(stats, NULL, "Print track history size and compression", shell_track_stats),
+    SHELL_CMD(dump, NULL, "Print the track history (unix time, lat, lon)", shell_track_dump),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(track, &sub_track, "Track history", NULL);
@@ -0,0 +1,26 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <track/track.h>
+
+/**
+ * @brief Starts recording every UFirebird II fix into the compressed track history.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ */
+int history_init();
+
+/**
+ * @brief Encodes the history into `buf` for a radio frame, see `track_encode`. The position
+ *      the simplifier is holding back is stored first, so the newest fix is always included.
+ * @param skip points already sent, 0 for the oldest
+ * @param points set to the number of points in the frame
+ * @returns bytes written, `errno < 0` on failure.
+ */
+int history_encode(uint32_t skip, uint8_t* buf, size_t len, uint32_t* points);
+
+#endif // HISTORY_H
@@ -0,0 +1,138 @@
+#include "rtcm.h"
+
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+#include "../roles.h"
+#include "../nrvc2_errno.h"
+#include "storage.h"
+
+// one file read, a bit over a typical MSM7 frame
+#define RTCM_REPLAY_CHUNK 256
+// a replay has no deadline, it just follows the UART
+#define RTCM_REPLAY_TIMEOUT K_MSEC(2000)
+
+LOG_MODULE_REGISTER(rtcm, LOG_LEVEL_INF);
+
+static struct ufirebirdii_rtcm3_framer framer;
+static bool framer_ready = false;
+static K_MUTEX_DEFINE(rtcm_lock); // the framer holds one frame in progress, sources take turns
+
+int rtcm_feed(const uint8_t* data, uint32_t len, k_timeout_t timeout) {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    int frames = 0;
+
+    k_mutex_lock(&rtcm_lock, K_FOREVER);
+
+    if (!framer_ready) {
+        ufirebirdii_rtcm3_framer_init(&framer);
+        framer_ready = true;
+    }
+
+    uint32_t frame_len;
+    uint32_t used;
+    while ((frame_len = ufirebirdii_rtcm3_feed(&framer, data, len, &used)) > 0) {
+        data += used;
+        len -= used;
+
+        // a dropped frame only costs the receiver one update, keep going with the next
+        if (ufirebirdii_send_rtcm(role_devs->dev_ufirebirdii, framer.frame, frame_len, timeout) == 0)
+            frames++;
+    }
+
+    k_mutex_unlock(&rtcm_lock);
+
+    return frames;
+}
+
+int rtcm_replay(const char* path) {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+
+    int frames = 0;
+    ret = fs_open(&file, path, FS_O_READ);
+    if (ret == 0) {
+        uint8_t chunk[RTCM_REPLAY_CHUNK];
+        ssize_t len;
+
+        while ((len = fs_read(&file, chunk, sizeof(chunk))) > 0) {
+            ret = rtcm_feed(chunk, len, RTCM_REPLAY_TIMEOUT);
+            if (ret < 0)
+                break;
+            frames += ret;
+        }
+
+        if (len < 0)
+            ret = len;
+        fs_close(&file);
+    }
+
+    nrvc2_storage_release();
+
+    return ret < 0 ? ret : frames;
+}
+
+static int shell_rtcm_replay(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc;
+
+    char path[64];
+    snprintf(path, sizeof(path), NRVC2_STORAGE_MP "/%s", argv[1]);
+
+    uint32_t start = k_uptime_get_32();
+    int ret = rtcm_replay(path);
+    if (ret < 0)
+        LOG_ERR("Failed to replay %s (%d)", path, ret);
+    else
+        LOG_INF("Queued %d frames from %s in %u ms", ret, path, k_uptime_get_32() - start);
+
+    return ret < 0 ? ret : 0;
+}
+
+static int shell_rtcm_stats(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY) {
+        LOG_WRN("UFirebird II not ready");
+        return -ENODEV;
+    }
+
+    struct ufirebirdii_stats stats;
+    ufirebirdii_get_stats(role_devs->dev_ufirebirdii, &stats);
+
+    k_mutex_lock(&rtcm_lock, K_FOREVER);
+    struct ufirebirdii_rtcm3_stats fr = framer.stats;
+    k_mutex_unlock(&rtcm_lock);
+
+    LOG_INF("--- RTCM3 corrections ---");
+    LOG_INF("Framed\t\t%u", fr.frames);
+    LOG_INF("CRC err\t\t%u", fr.crc_errors);
+    LOG_INF("Discarded\t%u B", fr.discarded);
+    LOG_INF("Queued\t\t%u", stats.rtcm_frames);
+    LOG_INF("Dropped\t\t%u", stats.rtcm_dropped);
+    LOG_INF("TX bytes\t%u", stats.bytes_tx);
+    LOG_INF("TX ring peak\t%u B", stats.tx_high_water);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_rtcm,
+    SHELL_CMD_ARG(replay, NULL, "Replay a recorded RTCM3 file from the SD card: replay <file>", shell_rtcm_replay, 2, 0),
+    SHELL_CMD(stats, NULL, "Print RTCM3 framing and forwarding counters", shell_rtcm_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(rtcm, &sub_rtcm, "RTCM3 corrections", NULL);
@@ -0,0 +1,27 @@
+#ifndef RTCM_H
+#define RTCM_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief Feeds RTCM3 correction bytes from any source (LoRa payloads, file reads) to the
+ *      UFirebird II. Frames may be split across calls anywhere, each one is queued to the
+ *      receiver as soon as its CRC checks out. Safe to call from several threads.
+ * @param timeout how long each completed frame may wait for room in the UART queue
+ * @returns number of frames queued, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ */
+int rtcm_feed(const uint8_t* data, uint32_t len, k_timeout_t timeout);
+
+/**
+ * @brief Replays a recorded RTCM3 stream from storage, as fast as the UART drains it.
+ * @param path file to replay, e.g. `NRVC2_STORAGE_MP "/BASE.RTCM"`
+ * @returns number of frames queued, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ * @retval `errno < 0` for other fs errors.
+ */
+int rtcm_replay(const char* path);
+
+#endif // RTCM_H
@@ -1,3 +1,4 @@
+#include <zephyr/kernel.h>
 #include <zephyr/fs/fs.h>
 #include <ff.h>
 #include <zephyr/logging/log.h>
@@ -17,8 +18,11 @@ static struct fs_mount_t sd_mnt_info = {
 };
 
 static bool is_mounted = false;
+// users holding the filesystem mounted, the last release unmounts it
+static uint32_t users = 0;
+static K_MUTEX_DEFINE(storage_lock);
 
-int nrvc2_fs_mount() {
+static int nrvc2_fs_mount() {
     if (is_mounted) {
         LOG_WRN(NRVC2_STORAGE_MP " already mounted");
         return -ESTORAGEMOUNTED;
@@ -40,7 +44,7 @@ int nrvc2_fs_mount() {
     return 0;
 }
 
-int nrvc2_fs_unmount() {
+static int nrvc2_fs_unmount() {
     if (!is_mounted) {
         LOG_WRN(NRVC2_STORAGE_MP " not mounted");
         return -ESTORAGENOTMOUNTED;
@@ -62,6 +66,34 @@ int nrvc2_fs_unmount() {
     return 0;
 }
 
+int nrvc2_storage_acquire() {
+    k_mutex_lock(&storage_lock, K_FOREVER);
+
+    int ret = 0;
+    if (users == 0)
+        ret = nrvc2_fs_mount();
+    if (ret == 0)
+        users++;
+
+    k_mutex_unlock(&storage_lock);
+    return ret;
+}
+
+int nrvc2_storage_release() {
+    k_mutex_lock(&storage_lock, K_FOREVER);
+
+    int ret = 0;
+    if (users == 0) {
+        LOG_WRN(NRVC2_STORAGE_MP " released more than acquired");
+        ret = -ESTORAGENOTMOUNTED;
+    } else if (--users == 0) {
+        ret = nrvc2_fs_unmount();
+    }
+
+    k_mutex_unlock(&storage_lock);
+    return ret;
+}
+
 bool nrvc2_storage_is_mounted() {
     return is_mounted;
 }
@@ -7,24 +7,24 @@
 #define NRVC2_STORAGE_MP "/SD:"
 
 /**
- * @brief If the filesystem at `NRVC2_STORAGE_MP` is not mounted and the SDHC
- *      device is ready, it gets mounted.
- * @returns 0 on success, `errno < 0` on failure. 
- * @retval `-ESTORAGEMOUNTED` if storage is already mounted.
+ * @brief Takes a reference on the filesystem at `NRVC2_STORAGE_MP`, mounting it if nobody
+ *      holds one. Every successful call is paired with `nrvc2_storage_release`, the filesystem
+ *      stays mounted until the last reference goes. Safe to call from any thread.
+ * @returns 0 on success, `errno < 0` on failure, in which case no reference is taken.
  * @retval `-EDEVNOTRDY` if the SDHC device is not ready. 
  * @retval `errno < 0` for other fs errors. 
  */
-int nrvc2_fs_mount();
+int nrvc2_storage_acquire();
 
 /**
- * @brief If the filesystem at `NRVC2_STORAGE_MP` is mounted and the SDHC device
- *      is ready, it gets unmounted. 
+ * @brief Drops a reference taken by `nrvc2_storage_acquire`, unmounting the filesystem at
+ *      `NRVC2_STORAGE_MP` if it was the last one. 
  * @returns 0 on success, `errno < 0` on failure. 
- * @retval `-ESTORAGENOTMOUNTED` if filesystem is not mounted.
+ * @retval `-ESTORAGENOTMOUNTED` if no reference is held.
  * @retval `-EDEVNOTRDY` if the SDHC device is not ready. 
  * @retval `errno < 0` for other fs errors. 
  */
-int nrvc2_fs_unmount();
+int nrvc2_storage_release();
 
 /**
  * @brief Check if the filesystem at `NRVC2_STORAGE_MP` is mounted.\
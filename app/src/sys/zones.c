@@ -0,0 +1,155 @@
+#include "zones.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+#include <geofence/geofence.h>
+
+#include "../roles.h"
+#include "../nrvc2_errno.h"
+#include "storage.h"
+
+#define ZONES_PATH NRVC2_STORAGE_MP "/ZONES.TXT"
+#define ZONES_LINE_MAX 256
+
+LOG_MODULE_REGISTER(zones, LOG_LEVEL_INF);
+
+static struct geofence fence;
+static struct ufirebirdii_fix_callback fence_cb;
+static uint32_t update_max_us;
+
+static void zones_transition(struct geofence* gf, uint16_t zone_id, enum geofence_event event,
+        const struct ufirebirdii_fix* fix, void* user_data) {
+    LOG_INF("%s zone %u at %d, %d", event == GEOFENCE_ENTER ? "Entered" : "Left",
+        zone_id, fix->latitude, fix->longitude);
+}
+
+// runs on the driver's rx work for every epoch, geofence_update is cheap enough for the full rate
+static void zones_fix(const struct device* dev, struct ufirebirdii_fix_callback* cb, const struct ufirebirdii_fix* fix) {
+    uint32_t start = k_cycle_get_32();
+
+    geofence_update(&fence, fix);
+
+    uint32_t us = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+    if (us > update_max_us)
+        update_max_us = us;
+}
+
+// one zone per line, see geofence_parse_line
+static int zones_load_file() {
+    int ret = nrvc2_storage_acquire();
+    if (ret < 0)
+        return ret;
+
+    struct fs_file_t file;
+    fs_file_t_init(&file);
+
+    ret = fs_open(&file, ZONES_PATH, FS_O_READ);
+    if (ret < 0)
+        goto release;
+
+    char line[ZONES_LINE_MAX];
+    size_t len = 0;
+    int lineno = 0;
+    int zones = 0;
+
+    while (true) {
+        ssize_t n = fs_read(&file, line + len, sizeof(line) - 1 - len);
+        if (n < 0) {
+            ret = n;
+            break;
+        }
+        len += n;
+        line[len] = '\0';
+
+        // hand over every complete line, a last line without '\n' goes once the file is done
+        char* start = line;
+        char* end;
+        while ((end = strchr(start, '\n')) != NULL || (n == 0 && *start != '\0')) {
+            if (end != NULL)
+                *end = '\0';
+            lineno++;
+
+            ret = geofence_parse_line(&fence, start);
+            if (ret < 0) {
+                LOG_ERR(ZONES_PATH ":%d: bad zone (%d)", lineno, ret);
+                goto close;
+            }
+            zones += ret;
+
+            start = end != NULL ? end + 1 : start + strlen(start);
+        }
+
+        len -= start - line;
+        memmove(line, start, len);
+
+        if (n == 0) {
+            ret = zones;
+            break;
+        }
+        if (len == sizeof(line) - 1) {
+            LOG_ERR(ZONES_PATH ":%d: line too long", lineno + 1);
+            ret = -EINVAL;
+            break;
+        }
+    }
+
+close:
+    fs_close(&file);
+release:
+    nrvc2_storage_release();
+    return ret;
+}
+
+int zones_init() {
+    if (role_devs->dev_ufirebirdii_stat != DEVSTAT_RDY)
+        return -EDEVNOTRDY;
+
+    geofence_init(&fence, zones_transition, NULL);
+
+    int ret = zones_load_file();
+    if (ret == -ENOENT || ret == -EDEVNOTRDY) {
+        // nothing to evaluate, so the fixes are not subscribed to either
+        LOG_WRN("No zone file (%d), no zones loaded", ret);
+        return 0;
+    }
+    if (ret < 0) {
+        LOG_ERR("Failed to load zones (%d)", ret);
+        return ret;
+    }
+
+    LOG_INF("Loaded %d zones", ret);
+
+    ufirebirdii_init_fix_callback(&fence_cb, zones_fix, 0);
+    int cb_ret = ufirebirdii_add_fix_callback(role_devs->dev_ufirebirdii, &fence_cb);
+    return cb_ret < 0 ? cb_ret : ret;
+}
+
+static int shell_zones_stats(const struct shell *shell, size_t argc, char **argv) {
+    (void)shell; (void)argc; (void)argv;
+
+    const struct geofence_stats* stats = &fence.stats;
+    uint32_t evals = MAX(stats->evaluations, 1);
+
+    LOG_INF("--- Geofence ---");
+    LOG_INF("Zones\t\t%u (%u wide, %u grid entries)", fence.num_zones, fence.num_wide, fence.num_entries);
+    LOG_INF("Inside\t\t%u", fence.num_inside);
+    LOG_INF("Evaluations\t%u", stats->evaluations);
+    LOG_INF("Candidates\t%u.%02u per fix", stats->candidates / evals, (uint32_t)((uint64_t)(stats->candidates % evals) * 100 / evals));
+    LOG_INF("Exact tests\t%u.%02u per fix", stats->exact_tests / evals, (uint32_t)((uint64_t)(stats->exact_tests % evals) * 100 / evals));
+    LOG_INF("Transitions\t%u", stats->transitions);
+    LOG_INF("Update max\t%u us", update_max_us);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_zones,
+    SHELL_CMD(stats, NULL, "Print geofence counters", shell_zones_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(zones, &sub_zones, "Geofence zones", NULL);
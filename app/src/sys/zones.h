@@ -0,0 +1,16 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <errno.h>
+
+/**
+ * @brief Loads the geofence zones from `ZONES.TXT` on the SD card and starts evaluating
+ *      every UFirebird II fix against them. Enter and exit transitions are logged. Without
+ *      a card or file no zones are loaded and fixes are not evaluated.
+ * @returns number of zones loaded on success, 0 without a zone file, `errno < 0` on failure.
+ * @retval `-EDEVNOTRDY` if the UFirebird II is not ready.
+ * @retval `errno < 0` for a malformed zone file or full zone tables.
+ */
+int zones_init();
+
+#endif // ZONES_H
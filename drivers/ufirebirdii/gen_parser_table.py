@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+# Copyright (C) 2026 Nate Aquino
+# SPDX-License-Identifier: Apache-2.0
+#
+# Generates the UFirebirdII sentence dispatch table from parser_table.txt.
+#
+# Sentence types are placed with a two level (hash and displace) perfect hash: the FNV-1a
+# hash of the type picks a bucket, and the bucket's displacement remixes the hash into a
+# slot that no other type uses. ufirebirdii_parse_sentence then dispatches with one pass
+# over the type and one compare. The hashing here MUST match parser_slot() in ufirebirdii.c.
+
+import argparse
+import re
+import sys
+
+FNV_OFFSET = 0x811C9DC5
+FNV_PRIME = 0x01000193
+MIX = 0x9E3779B1
+MAX_DISP = 1 << 16
+MAX_BITS = 10
+
+NAME_RE = re.compile(r"^[A-Z0-9]+$")
+PARSER_RE = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+
+
+def fnv1a(name):
+    h = FNV_OFFSET
+    for c in name.encode("ascii"):
+        h ^= c
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def slot(h, disp, bits):
+    return (((h ^ disp) * MIX) & 0xFFFFFFFF) >> (32 - bits)
+
+
+def load(path):
+    entries = []
+    errors = []
+
+    with open(path, encoding="ascii") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+
+            fields = line.split()
+            if len(fields) != 2:
+                errors.append(f"{path}:{lineno}: expected '<sentence type> <parser>'")
+                continue
+
+            name, parser = fields
+            if not NAME_RE.match(name):
+                errors.append(f"{path}:{lineno}: invalid sentence type '{name}'")
+            if parser != "-" and not PARSER_RE.match(parser):
+                errors.append(f"{path}:{lineno}: invalid parser '{parser}'")
+
+            if entries and name == entries[-1][0]:
+                errors.append(f"{path}:{lineno}: duplicate sentence type '{name}'")
+            elif entries and name < entries[-1][0]:
+                errors.append(f"{path}:{lineno}: '{name}' is out of order, keep the list sorted")
+
+            entries.append((name, None if parser == "-" else parser))
+
+    if not entries:
+        errors.append(f"{path}: no sentence types")
+
+    return entries, errors
+
+
+def place(hashes, bits, bucket_bits):
+    buckets = [[] for _ in range(1 << bucket_bits)]
+    for h in hashes:
+        buckets[h & ((1 << bucket_bits) - 1)].append(h)
+
+    used = set()
+    disps = [0] * len(buckets)
+
+    # place the crowded buckets first while the table is still empty
+    for b in sorted(range(len(buckets)), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+
+        for disp in range(MAX_DISP):
+            slots = {slot(h, disp, bits) for h in buckets[b]}
+            if len(slots) == len(buckets[b]) and not slots & used:
+                used |= slots
+                disps[b] = disp
+                break
+        else:
+            return None
+
+    return disps
+
+
+def find_hash(names):
+    hashes = [fnv1a(n) for n in names]
+    if len(set(hashes)) != len(hashes):
+        return None
+
+    bits = max(1, (len(names) - 1).bit_length())
+    while bits <= MAX_BITS:
+        bucket_bits = max(0, bits - 2)
+        disps = place(hashes, bits, bucket_bits)
+        if disps is not None:
+            return bits, bucket_bits, disps
+        bits += 1
+
+    return None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument("--input", required=True)
+    ap.add_argument("--output", required=True)
+    args = ap.parse_args()
+
+    entries, errors = load(args.input)
+    if errors:
+        for e in errors:
+            print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    found = find_hash([name for name, _ in entries])
+    if found is None:
+        print(f"error: no collision free hash with at most {MAX_BITS} bits", file=sys.stderr)
+        return 1
+
+    bits, bucket_bits, disps = found
+    slotted = sorted(
+        (slot(fnv1a(name), disps[fnv1a(name) & ((1 << bucket_bits) - 1)], bits), name, parser)
+        for name, parser in entries
+    )
+    max_len = max(len(name) for name, _ in entries)
+
+    lines = [
+        "/* Generated by gen_parser_table.py from parser_table.txt, do not edit. */",
+        "",
+        "#ifndef UFIREBIRDII_PARSER_TABLE_H",
+        "#define UFIREBIRDII_PARSER_TABLE_H",
+        "",
+        f"#define UFBII_PARSER_HASH_BITS {bits}",
+        f"#define UFBII_PARSER_BUCKET_BITS {bucket_bits}",
+        f"#define UFBII_PARSER_TABLE_SIZE {1 << bits}",
+        f"#define UFBII_PARSER_MAX_TYPE_LEN {max_len}",
+        f"#define UFBII_PARSER_NUM_TYPES {len(entries)}",
+        "",
+        "#define UFBII_PARSER_DISPLACEMENTS \\",
+    ]
+    for i in range(0, len(disps), 8):
+        lines.append("    " + " ".join(f"0x{d:04x}," for d in disps[i:i + 8]) + " \\")
+    lines += ["", "#define UFBII_PARSER_TABLE_ENTRIES \\"]
+    for idx, name, parser in slotted:
+        lines.append(
+            f'    [{idx}] = {{.sentence_type = "{name}", .sentence_len = {len(name)}, '
+            f".parser = {parser or 'NULL'}}}, \\"
+        )
+    lines += ["", "#endif // UFIREBIRDII_PARSER_TABLE_H", ""]
+
+    with open(args.output, "w", encoding="ascii") as f:
+        f.write("\n".join(lines))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
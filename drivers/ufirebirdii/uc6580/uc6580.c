@@ -3,64 +3,620 @@
 #include <errno.h>
 #include <zephyr/logging/log.h>
 #include <drivers/ufirebirdii/ufirebirdii.h>
-#include <limits.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <zephyr/sys/barrier.h>
 
 #include "uc6580.h"
 
 LOG_MODULE_REGISTER(uc6580);
 
+#define UC6580_RX_HIGH_WATER ((CONFIG_UC6580_RINGBUFFER_SIZE * CONFIG_UC6580_RX_HIGH_WATER_PERCENT) / 100)
+
+BUILD_ASSERT(CONFIG_UC6580_TX_RINGBUFFER_SIZE >= UFBII_RTCM3_FRAME_MAX, "CONFIG_UC6580_TX_RINGBUFFER_SIZE cannot hold an RTCM3 frame");
+
+// isr side accounting, the sentence in flight when bytes drop is torn so the worker has to resync
+static inline void uc6580_rx_account(struct uc6580_data* data, uint32_t received, uint32_t dropped) {
+    data->stats.bytes_rx += received;
+    if (dropped > 0) {
+        if (!atomic_get(&data->resync))
+            data->stats.overruns++; // one per run of drops until the worker resyncs
+        data->stats.bytes_dropped += dropped;
+        atomic_set(&data->resync, 1);
+    }
+}
+
+// only wake the worker when there is a sentence to frame or the ring is filling up
+static inline void uc6580_rx_wake(struct uc6580_data* data, bool eol) {
+    uint32_t level = ring_buf_size_get(&data->rx_ringbuf);
+
+    if (level > data->stats.ring_high_water)
+        data->stats.ring_high_water = level;
+
+    if (data->stopped)
+        return; // uc6580_start clears whatever is left
+
+    if (eol || level >= UC6580_RX_HIGH_WATER)
+        k_work_submit(&data->rx_work);
+}
+
+#ifdef CONFIG_UC6580_UART_INTERRUPT
+// feeds the fifo from the tx ring, the tx irq goes off once the ring is empty
+static void uc6580_tx_fill(struct uc6580_data* data, const struct device* uart) {
+    if (!uart_irq_tx_ready(uart))
+        return;
+
+    k_spinlock_key_t key = k_spin_lock(&data->tx.kick);
+    uint8_t* src;
+    uint32_t len = ring_buf_get_claim(&data->tx.ringbuf, &src, UINT32_MAX);
+    int n = len > 0 ? uart_fifo_fill(uart, src, len) : 0;
+
+    ring_buf_get_finish(&data->tx.ringbuf, MAX(n, 0));
+    if (len == 0)
+        uart_irq_tx_disable(uart);
+    k_spin_unlock(&data->tx.kick, key);
+
+    if (n > 0) {
+        data->stats.bytes_tx += n;
+        k_sem_give(&data->tx.space);
+    }
+}
+
+// the tx irq fires as long as the fifo has room, uc6580_tx_fill turns it off again
+static void uc6580_tx_kick(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+
+    k_spinlock_key_t key = k_spin_lock(&data->tx.kick);
+    uart_irq_tx_enable(cfg->uart);
+    k_spin_unlock(&data->tx.kick, key);
+}
+
+static bool uc6580_tx_idle(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+
+    // the last fifo load is still shifting out after the ring empties
+    return ring_buf_is_empty(&data->tx.ringbuf) && uart_irq_tx_complete(cfg->uart) != 0;
+}
+
 static void uc6580_uart_cb(const struct device* uart, void* user_data) {
     // Do not log here! I learned my lesson the hard way
     const struct device* dev = user_data;
     struct uc6580_data* data = dev->data;
-    uint8_t chr;
+    bool eol = false;
     
     if (!uart_irq_update(uart)) 
         return; 
 
-    while (uart_irq_rx_ready(uart)) 
-        if (uart_fifo_read(uart, &chr, 1) == 1) 
-            ring_buf_put(&data->rx_ringbuf, &chr, 1);
+    // drain the fifo in bursts straight into the ring
+    while (uart_irq_rx_ready(uart)) {
+        uint8_t* dst;
+        uint32_t room = ring_buf_put_claim(&data->rx_ringbuf, &dst, UINT32_MAX);
+
+        if (room == 0) {
+            // ring is full, the fifo still has to be emptied to clear the irq
+            uint8_t discard[16];
+            int n = uart_fifo_read(uart, discard, sizeof(discard));
+            if (n <= 0)
+                break;
+            uc6580_rx_account(data, n, n);
+            continue;
+        }
+
+        int n = uart_fifo_read(uart, dst, room);
+        if (n <= 0) {
+            ring_buf_put_finish(&data->rx_ringbuf, 0);
+            break;
+        }
+
+        if (!eol && memchr(dst, '\n', n) != NULL)
+            eol = true;
+        ring_buf_put_finish(&data->rx_ringbuf, n);
+        uc6580_rx_account(data, n, 0);
+    }
+
+    // transmit only once reception is served, corrections can wait a fifo's worth, sentences cannot
+    uc6580_tx_fill(data, uart);
+    uc6580_rx_wake(data, eol);
+}
+
+static int uc6580_rx_start(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+
+    int ret = uart_irq_callback_user_data_set(cfg->uart, uc6580_uart_cb, (void*)dev);
+    if (ret < 0)
+        return ret;
+
+    uart_irq_rx_enable(cfg->uart);
+    return 0;
+}
+
+static void uc6580_rx_stop(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    uart_irq_rx_disable(cfg->uart);
+}
+#endif // CONFIG_UC6580_UART_INTERRUPT
+
+#ifdef CONFIG_UC6580_UART_ASYNC
+// sends the ring's contiguous head with uart_tx, UART_TX_DONE releases it and sends the next
+static void uc6580_tx_kick(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+    uint8_t* src;
+
+    k_spinlock_key_t key = k_spin_lock(&data->tx.kick);
+    if (data->tx.busy) {
+        k_spin_unlock(&data->tx.kick, key);
+        return;
+    }
+
+    uint32_t len = ring_buf_get_claim(&data->tx.ringbuf, &src, UINT32_MAX);
+    if (len == 0) {
+        ring_buf_get_finish(&data->tx.ringbuf, 0);
+        k_spin_unlock(&data->tx.kick, key);
+        return;
+    }
+    data->tx.busy = true;
+    k_spin_unlock(&data->tx.kick, key); // some drivers complete from inside uart_tx
 
-    k_work_submit(&data->rx_work);
+    if (uart_tx(cfg->uart, src, len, SYS_FOREVER_US) < 0) {
+        key = k_spin_lock(&data->tx.kick);
+        ring_buf_get_finish(&data->tx.ringbuf, 0);
+        data->tx.busy = false;
+        k_spin_unlock(&data->tx.kick, key);
+    }
 }
 
-// #define UC6580_SENTENCE_BUF 82
-#define UC6580_SENTENCE_BUF 128
+static void uc6580_tx_done(const struct device* dev, size_t sent) {
+    struct uc6580_data* data = dev->data;
+
+    k_spinlock_key_t key = k_spin_lock(&data->tx.kick);
+    ring_buf_get_finish(&data->tx.ringbuf, sent);
+    data->tx.busy = false;
+    k_spin_unlock(&data->tx.kick, key);
+
+    data->stats.bytes_tx += sent;
+    k_sem_give(&data->tx.space);
+    uc6580_tx_kick(dev);
+}
+
+static bool uc6580_tx_idle(const struct device* dev) {
+    struct uc6580_data* data = dev->data;
+    return ring_buf_is_empty(&data->tx.ringbuf) && !data->tx.busy;
+}
+
+/*
+ * The DMA buffers cycle back to the driver before the worker gets to them, so each RX_RDY
+ * chunk is copied into the ring and framed from there. A memcpy per idle gap is far cheaper
+ * than the per fifo interrupts it replaces, and keeps one framer for both backends.
+ */
+static void uc6580_uart_async_cb(const struct device* uart, struct uart_event* evt, void* user_data) {
+    // Do not log here either
+    const struct device* dev = user_data;
+    struct uc6580_data* data = dev->data;
+
+    switch (evt->type) {
+    case UART_RX_RDY: {
+        const uint8_t* chunk = evt->data.rx.buf + evt->data.rx.offset;
+        size_t len = evt->data.rx.len;
+        bool eol = memchr(chunk, '\n', len) != NULL;
+
+        uint32_t put = ring_buf_put(&data->rx_ringbuf, chunk, len); // anything past a full ring is dropped
+        uc6580_rx_account(data, len, len - put);
+        uc6580_rx_wake(data, eol);
+        break;
+    }
+    case UART_RX_BUF_REQUEST:
+        uart_rx_buf_rsp(uart, data->dma_buf[data->dma_next], sizeof(data->dma_buf[0]));
+        data->dma_next ^= 1;
+        break;
+    case UART_RX_DISABLED:
+        if (data->stopped)
+            break; // uc6580_rx_stop asked for it
+
+        // an rx error stopped reception, start over on the first buffer
+        data->dma_next = 1;
+        uart_rx_enable(uart, data->dma_buf[0], sizeof(data->dma_buf[0]), CONFIG_UC6580_ASYNC_RX_TIMEOUT_US);
+        break;
+    case UART_TX_DONE:
+    case UART_TX_ABORTED: // len is what made it out, the rest goes again
+        uc6580_tx_done(dev, evt->data.tx.len);
+        break;
+    default:
+        break;
+    }
+}
+
+static int uc6580_rx_start(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+
+    int ret = uart_callback_set(cfg->uart, uc6580_uart_async_cb, (void*)dev);
+    if (ret < 0)
+        return ret;
+
+    data->dma_next = 1;
+    return uart_rx_enable(cfg->uart, data->dma_buf[0], sizeof(data->dma_buf[0]), CONFIG_UC6580_ASYNC_RX_TIMEOUT_US);
+}
+
+static void uc6580_rx_stop(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    uart_rx_disable(cfg->uart); // the last RX_RDY may still land in the ring, uc6580_start clears it
+}
+#endif // CONFIG_UC6580_UART_ASYNC
+
+static void uc6580_pps_cb(const struct device* port, struct gpio_callback* cb, gpio_port_pins_t pins) {
+    uint32_t now = k_cycle_get_32();
+    struct uc6580_pps* pps = CONTAINER_OF(cb, struct uc6580_pps, cb);
+    struct ufirebirdii_timebase* tb = &pps->timebase;
+    k_spinlock_key_t key = k_spin_lock(&pps->lock);
+
+    if (tb->pps_edges > 0) {
+        uint32_t interval = now - pps->edge;
+        uint32_t nominal = sys_clock_hw_cycles_per_sec();
+
+        // only discipline on clean one second intervals, skips glitches and missed edges
+        if (interval > nominal - nominal / 100 && interval < nominal + nominal / 100) {
+            if (tb->cycles_per_sec == 0)
+                tb->cycles_per_sec = interval;
+            else
+                tb->cycles_per_sec += ((int32_t)(interval - tb->cycles_per_sec)) / 8;
+        }
+    }
+
+    pps->prev_edge = pps->edge;
+    pps->edge = now;
+    tb->pps_edges++;
+
+    k_spin_unlock(&pps->lock, key);
+}
+
+// ties the fix to the pps edge that started its utc second and re-anchors the timebase
+static void uc6580_pps_stamp(struct uc6580_data* data, struct ufirebirdii_fix* fix) {
+    struct uc6580_pps* pps = &data->pps;
+    struct ufirebirdii_timebase* tb = &pps->timebase;
+
+    if (!(fix->fields & UFBII_FIX_HAS_TIME))
+        return;
+
+    uint32_t now = k_cycle_get_32();
+    k_spinlock_key_t key = k_spin_lock(&pps->lock);
+
+    uint32_t cps = tb->cycles_per_sec != 0 ? tb->cycles_per_sec : sys_clock_hw_cycles_per_sec();
+    uint32_t into_second = (uint32_t)(((uint64_t)fix->utc.millisecond * cps) / 1000);
+    uint32_t edges[2] = {pps->edge, pps->prev_edge};
+    uint32_t n = MIN(tb->pps_edges, 2);
+
+    // the edge is the newest one old enough to be in this second but not the one before it
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t age = now - edges[i];
+        if (age < into_second || age >= into_second + cps)
+            continue;
+
+        fix->pps_cycles = edges[i];
+        fix->fields |= UFBII_FIX_HAS_PPS;
+
+        tb->latency_us = (uint32_t)(((uint64_t)(age - into_second) * 1000000) / cps);
+        tb->latency_max_us = MAX(tb->latency_max_us, tb->latency_us);
+
+        if (fix->fields & UFBII_FIX_HAS_DATE) {
+            tb->pps_cycles = edges[i];
+            tb->pps_utc_us = ufirebirdii_utc_to_unix_us(&fix->utc) - (int64_t)fix->utc.millisecond * 1000;
+            pps->anchored = true;
+        }
+        break;
+    }
+
+    k_spin_unlock(&pps->lock, key);
+}
+
+// only ever called from the rx work handler, which makes it the single writer
+static void uc6580_publish(struct uc6580_data* data, const struct ufirebirdii_fix* fix) {
+    struct uc6580_fix_pub* pub = &data->pub;
+    uint32_t seq = (uint32_t)atomic_get(&pub->seq) + 1;
+    struct ufirebirdii_fix* slot = &pub->slot[seq & 1];
+
+    // readers are on slot[(seq - 1) & 1] until seq is bumped
+    *slot = *fix;
+    slot->epoch = seq;
+    uc6580_pps_stamp(data, slot);
+
+    barrier_dmem_fence_full();
+    atomic_set(&pub->seq, (atomic_val_t)seq);
+
+    if (fix->valid && data->fix_pending) {
+        uint32_t ms = MAX(k_uptime_get_32() - data->start_ms, 1);
+        data->fix_pending = false;
+
+        if (data->stats.ttff_ms == 0) {
+            data->stats.ttff_ms = ms;
+        } else {
+            data->stats.reacq_ms = ms;
+            LOG_INF("Reacquired fix in %u ms", ms);
+        }
+    }
+
+    // the slot cant be reused until the next publish, which waits for the handlers
+    ufirebirdii_fire_callbacks(&data->callbacks, data->dev, slot);
+}
+
+static void uc6580_count_result(struct uc6580_data* data, int ret) {
+    if (ret >= 0)
+        data->stats.sentences++;
+    else if (ret == -EILSEQ)
+        data->stats.checksum_errors++;
+    else if (ret == -ENOTSUP)
+        data->stats.unsupported++;
+    else
+        data->stats.parse_errors++;
+}
+
+// hand a complete sentence to the parser without its line ending
+static void uc6580_dispatch(struct uc6580_data* data, const uint8_t* sentence, uint32_t len) {
+    while (len > 0 && (sentence[len - 1] == '\n' || sentence[len - 1] == '\r'))
+        len--;
+
+    int ret = ufirebirdii_parse_sentence((const char*)sentence, len, &data->epoch, &data->devconfig);
+    uc6580_count_result(data, ret);
+
+    if (ret == UFBII_EPOCH_CLOSED) {
+        uc6580_publish(data, &data->epoch.solution);
+    } else if (ret == UFBII_CMD_ACK || ret == UFBII_CMD_NACK) {
+        data->cmd.result = ret == UFBII_CMD_ACK ? 0 : -EIO;
+        k_sem_give(&data->cmd.ack);
+    }
+}
 
 static void uc6580_rx_work_handler(struct k_work* work) {
     struct uc6580_data* data = CONTAINER_OF(work, struct uc6580_data, rx_work);
-    uint8_t sentence_buf[UC6580_SENTENCE_BUF];
+    struct ufirebirdii_nmea_framer* fr = &data->framer;
+    const uint8_t* ring_end = data->rx_data + sizeof(data->rx_data);
+    uint32_t start = k_cycle_get_32();
+    uint8_t* claim;
     uint32_t len;
 
-    while ((len = ring_buf_peek(&data->rx_ringbuf, sentence_buf, sizeof(sentence_buf) - 1)) > 0) {
-        uint32_t start_idx = UINT_MAX;
-        uint32_t end_idx = UINT_MAX;
-
-        for (uint32_t i = 0; i < len; i++) {
-            if (sentence_buf[i] == '$' && start_idx == UINT_MAX)
-                start_idx = i;
-            if (i > 0 && sentence_buf[i] == '\n' && sentence_buf[i - 1] == '\r') {
-                end_idx = i;
-                break;  // found complete sentence
-            }
-        }
+    if (atomic_cas(&data->resync, 1, 0)) {
+        // the sentence in flight lost bytes somewhere in what is buffered, start over at the next '$'
+        ring_buf_get(&data->rx_ringbuf, NULL, ring_buf_size_get(&data->rx_ringbuf));
+        ufirebirdii_nmea_framer_reset(fr);
+    }
+
+    // claims are contiguous, so a sentence crossing the end of the ring arrives in two claims
+    while ((len = ring_buf_get_claim(&data->rx_ringbuf, &claim, UINT32_MAX)) > 0) {
+        bool wraps = claim + len == ring_end;
+        const uint8_t* sentence;
+        uint32_t used;
+
+        int ret = ufirebirdii_nmea_feed(fr, claim, len, wraps, &sentence, &used);
+        if (ret > 0)
+            uc6580_dispatch(data, sentence, ret); // before the bytes are handed back to the isr
+        else if (ret < 0)
+            data->stats.parse_errors++;
 
-        if (start_idx != UINT_MAX && end_idx != UINT_MAX && end_idx > start_idx) {
-            // discard bytes before '$'
-            ring_buf_get(&data->rx_ringbuf, NULL, start_idx);
-            
-            // read the sentence (from '$' to '\n' inclusive)
-            uint32_t sentence_len = end_idx - start_idx + 1;
-            ring_buf_get(&data->rx_ringbuf, sentence_buf, sentence_len);
-            sentence_buf[sentence_len] = '\0';
-            
-            ufirebirdii_parse_sentence((char*)sentence_buf, sentence_len, &data->last_fix, &data->devconfig); // discard return code for now
-        } else if (end_idx != UINT_MAX && start_idx == UINT_MAX) 
-            ring_buf_get(&data->rx_ringbuf, NULL, end_idx + 1); // end but no start, discard
-        else 
+        ring_buf_get_finish(&data->rx_ringbuf, used);
+        if (ret == 0 && !wraps)
             break; // wait for more data
     }
+
+    uint32_t cycles = k_cycle_get_32() - start;
+    uint32_t us = k_cyc_to_us_ceil32(cycles);
+    data->stats.handler_cycles += cycles;
+    if (us > data->stats.handler_max_us)
+        data->stats.handler_max_us = us;
+}
+
+/*
+ * Queues `len` bytes for the uart, all or nothing, waiting up to `timeout` for room.
+ * Returns -EAGAIN if there was no room in time.
+ */
+static int uc6580_tx_write(const struct device* dev, const uint8_t* buf, uint32_t len, k_timeout_t timeout) {
+    struct uc6580_data* data = dev->data;
+    k_timepoint_t end = sys_timepoint_calc(timeout);
+    int ret = 0;
+
+    if (len > sizeof(data->tx.buf))
+        return -EMSGSIZE;
+
+    if (k_mutex_lock(&data->tx.lock, timeout) != 0)
+        return -EAGAIN;
+
+    while (ring_buf_space_get(&data->tx.ringbuf) < len) {
+        if (k_sem_take(&data->tx.space, sys_timepoint_timeout(end)) != 0) {
+            ret = -EAGAIN;
+            goto unlock;
+        }
+    }
+
+    ring_buf_put(&data->tx.ringbuf, buf, len);
+
+    uint32_t level = ring_buf_size_get(&data->tx.ringbuf);
+    if (level > data->stats.tx_high_water)
+        data->stats.tx_high_water = level;
+
+    uc6580_tx_kick(dev);
+
+unlock:
+    k_mutex_unlock(&data->tx.lock);
+    return ret;
+}
+
+// waits for everything queued to leave the uart, call with tx.lock held so nothing new is queued
+static int uc6580_tx_drain(const struct device* dev, k_timeout_t timeout) {
+    struct uc6580_data* data = dev->data;
+    k_timepoint_t end = sys_timepoint_calc(timeout);
+
+    while (!uc6580_tx_idle(dev)) {
+        if (sys_timepoint_expired(end))
+            return -ETIMEDOUT;
+
+        // the isr only gives space while the ring drains, poll out the last fifo load
+        if (ring_buf_is_empty(&data->tx.ringbuf))
+            k_sleep(K_MSEC(1));
+        else
+            k_sem_take(&data->tx.space, sys_timepoint_timeout(end));
+    }
+
+    return 0;
+}
+
+static int uc6580_send_command(const struct device* dev, const char* body) {
+    char buf[UC6580_SENTENCE_MAX];
+
+    int len = ufirebirdii_build_command(buf, sizeof(buf), body);
+    if (len < 0)
+        return len;
+
+    // commands queue behind any corrections already waiting
+    return uc6580_tx_write(dev, (const uint8_t*)buf, len, UC6580_TX_TIMEOUT);
+}
+
+/*
+ * Sends a command and waits for the receiver to OK or FAIL it. Replies are framed by the rx
+ * work handler on the system workqueue, so do not call this from there.
+ * Returns 0 on OK, -EIO on FAIL or -ETIMEDOUT if nothing came back.
+ */
+static int uc6580_command(const struct device* dev, k_timeout_t timeout, const char* fmt, ...) {
+    struct uc6580_data* data = dev->data;
+    char body[UC6580_SENTENCE_MAX - 8];
+    va_list args;
+    int ret;
+
+    va_start(args, fmt);
+    ret = vsnprintk(body, sizeof(body), fmt, args);
+    va_end(args);
+    if (ret < 0 || ret >= (int)sizeof(body))
+        return -ENOMEM;
+
+    if (data->stopped)
+        return -EAGAIN; // nothing would hear the reply
+
+    k_mutex_lock(&data->cmd.lock, K_FOREVER);
+    k_sem_reset(&data->cmd.ack); // drop any late reply to a command that timed out
+
+    ret = uc6580_send_command(dev, body);
+    if (ret == 0) {
+        if (k_sem_take(&data->cmd.ack, timeout) == 0)
+            ret = data->cmd.result;
+        else
+            ret = -ETIMEDOUT;
+    }
+
+    k_mutex_unlock(&data->cmd.lock);
+
+    if (ret < 0)
+        LOG_WRN("%s: %d", body, ret);
+    return ret;
+}
+
+static int uc6580_set_uart_baud(const struct device* dev, uint32_t baud) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+    struct uart_config uart_cfg;
+
+    // bytes still queued would go out at the new baud, garbled
+    k_mutex_lock(&data->tx.lock, K_FOREVER);
+
+    int ret = uc6580_tx_drain(dev, UC6580_TX_TIMEOUT);
+    if (ret == 0)
+        ret = uart_config_get(cfg->uart, &uart_cfg);
+    if (ret == 0) {
+        uart_cfg.baudrate = baud;
+        ret = uart_configure(cfg->uart, &uart_cfg);
+    }
+
+    k_mutex_unlock(&data->tx.lock);
+    return ret;
+}
+
+// moves receiver and uart to cfg->baud together, falls back to the old baud if the receiver goes quiet
+static int uc6580_negotiate_port(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+    uint32_t old_baud = data->devconfig.baud;
+    uint32_t baud = cfg->baud != 0 ? cfg->baud : old_baud;
+    int ret;
+
+    if (baud == old_baud && data->devconfig.inpro == UFBII_INPRO_UNICORE)
+        return 0;
+
+    // the receiver may switch before its reply is out, so a lost reply is not a failure yet
+    ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "CFGPRT,%d,0,%u,%d,%d", UFBII_PORT_ID_UART1, baud,
+        data->devconfig.inpro, data->devconfig.outpro);
+    if (baud == old_baud || (ret < 0 && ret != -ETIMEDOUT))
+        return ret;
+
+    ret = uc6580_set_uart_baud(dev, baud);
+    if (ret < 0)
+        return ret;
+
+    // repeating the command at the new baud proves the receiver followed, OK or FAIL alike
+    ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "CFGPRT,%d,0,%u,%d,%d", UFBII_PORT_ID_UART1, baud,
+        data->devconfig.inpro, data->devconfig.outpro);
+    if (ret == -ETIMEDOUT) {
+        LOG_WRN("No reply at %u baud, staying at %u", baud, old_baud);
+        return uc6580_set_uart_baud(dev, old_baud);
+    }
+
+    data->devconfig.baud = baud;
+    LOG_INF("UART now at %u baud", baud);
+    return ret;
+}
+
+// trims receiver output and sets the fix rate, everything here is devicetree driven
+static int uc6580_configure(const struct device* dev) {
+    const struct uc6580_config* cfg = dev->config;
+    struct uc6580_data* data = dev->data;
+    int ret;
+
+    ret = uc6580_negotiate_port(dev);
+    if (ret < 0)
+        return ret;
+
+    if (cfg->nmea_output >= 0) {
+        for (int id = UFBII_MSG_ID_NMEA_GGA; id <= UFBII_MSG_ID_NMEA_GBS; id++) {
+            ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "CFGMSG,%d,%d,%d", UFBII_MSG_CLASS_NMEA, id,
+                (cfg->nmea_output & BIT(id)) ? 1 : 0);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    if (cfg->fix_interval_ms != 0) {
+        ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "CFGNAV,%u", cfg->fix_interval_ms);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+// fixed point to the decimal text the aiding commands take
+#define UC6580_FMT_FIXED "%s%u.%0*u"
+#define UC6580_FMT_FIXED_ARGS(val, scale, digits) \
+    (val) < 0 ? "-" : "", (unsigned)(abs(val) / (scale)), (digits), (unsigned)(abs(val) % (scale))
+
+static int uc6580_aid(const struct device* dev, const struct ufirebirdii_fix* fix) {
+    int ret = -ENODATA;
+
+    // time first, the receiver needs it to make sense of the position
+    if ((fix->fields & UFBII_FIX_HAS_TIME) && (fix->fields & UFBII_FIX_HAS_DATE)) {
+        ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "AIDTIME,%u,%u,%u,%u,%u,%u,%u",
+            fix->utc.year, fix->utc.month, fix->utc.day,
+            fix->utc.hour, fix->utc.minute, fix->utc.second, fix->utc.millisecond);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (fix->fields & UFBII_FIX_HAS_POSITION) {
+        ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, "AIDPOS," UC6580_FMT_FIXED "," UC6580_FMT_FIXED "," UC6580_FMT_FIXED,
+            UC6580_FMT_FIXED_ARGS(fix->latitude, UFBII_COORD_SCALE, 7),
+            UC6580_FMT_FIXED_ARGS(fix->longitude, UFBII_COORD_SCALE, 7),
+            UC6580_FMT_FIXED_ARGS(fix->altitude, 1000, 3));
+    }
+
+    return ret;
 }
 
 static int uc6580_init(const struct device* dev) {
@@ -68,12 +624,15 @@ static int uc6580_init(const struct device* dev) {
 
     struct uc6580_data* data = dev->data;
     const struct uc6580_config* cfg = dev->config;
+    int ret;
 
+    data->dev = dev;
     data->devconfig.baud = DT_PROP(DT_PARENT(DT_DRV_INST(0)), current_speed);
     data->devconfig.addr = 0; // UART Mode only supported right now
     data->devconfig.variant = UFBII_VARIANT_UC6580;
-    data->devconfig.inpro = 0; // TODO
-    data->devconfig.outpro = 0; // TODO
+    data->devconfig.inpro = cfg->rtcm_input ? (UFBII_INPRO_UNICORE | UFBII_INPRO_RTCM3_X) : UFBII_INPRO_UNICORE;
+    data->devconfig.outpro = UFBII_OUTPRO_NMEA; // the binary messages are not supported yet
+    data->devconfig.user_config.do_checksum = true; // computed in the same pass as the field index anyway
 
     // check if uart is ready
     if (!device_is_ready(cfg->uart)) {
@@ -87,54 +646,261 @@ static int uc6580_init(const struct device* dev) {
         return -ENODEV;
     }
 
-    int ret = gpio_pin_configure_dt(&cfg->pps, GPIO_INPUT);
-    if (ret < 0) {
-        LOG_ERR("Failed to configure PPS GPIO pin: %d", ret);
-        return ret;
+    if (cfg->pps.port != NULL) {
+        ret = gpio_pin_configure_dt(&cfg->pps, GPIO_INPUT);
+        if (ret < 0) {
+            LOG_ERR("Failed to configure PPS GPIO pin: %d", ret);
+            return ret;
+        }
+
+        gpio_init_callback(&data->pps.cb, uc6580_pps_cb, BIT(cfg->pps.pin));
+        ret = gpio_add_callback_dt(&cfg->pps, &data->pps.cb);
+        if (ret < 0) {
+            LOG_ERR("Failed to add PPS GPIO callback: %d", ret);
+            return ret;
+        }
+
+        ret = gpio_pin_interrupt_configure_dt(&cfg->pps, GPIO_INT_EDGE_TO_ACTIVE);
+        if (ret < 0) {
+            LOG_ERR("Failed to enable PPS GPIO interrupt: %d", ret);
+            return ret;
+        }
+    }
+
+    if (cfg->wakeup.port != NULL) {
+        if (!device_is_ready(cfg->wakeup.port)) {
+            LOG_ERR("Wakeup GPIO device is not ready");
+            return -ENODEV;
+        }
+
+        ret = gpio_pin_configure_dt(&cfg->wakeup, GPIO_OUTPUT_INACTIVE);
+        if (ret < 0) {
+            LOG_ERR("Failed to configure wakeup GPIO pin: %d", ret);
+            return ret;
+        }
     }
 
     // init ring buffer to store incoming data from uc6580 uart
     ring_buf_init(&data->rx_ringbuf, sizeof(data->rx_data), data->rx_data);
+    ring_buf_init(&data->tx.ringbuf, sizeof(data->tx.buf), data->tx.buf);
+    k_mutex_init(&data->tx.lock);
+    k_sem_init(&data->tx.space, 0, 1);
+    ufirebirdii_nmea_framer_reset(&data->framer);
+    ufirebirdii_epoch_init(&data->epoch);
 
     // init workqueue for processing sentences
     k_work_init(&data->rx_work, uc6580_rx_work_handler); 
-    k_sem_init(&data->fix_sem, 1, 1);
+    k_mutex_init(&data->cmd.lock);
+    k_sem_init(&data->cmd.ack, 0, 1);
+    atomic_set(&data->pub.seq, 0);
+    atomic_set(&data->resync, 0);
+    sys_slist_init(&data->callbacks);
 
-    uart_irq_callback_user_data_set(cfg->uart, uc6580_uart_cb, (void*)dev);
-    uart_irq_rx_enable(cfg->uart);
+    ret = uc6580_rx_start(dev);
+    if (ret < 0) {
+        LOG_ERR("Failed to start UART reception: %d", ret);
+        return ret;
+    }
+
+    // replies are framed on the system workqueue, which is already running at POST_KERNEL
+    // ttff counts from here, the receiver powers up with the board
+    data->start_ms = k_uptime_get_32();
+    data->fix_pending = true;
+
+    // a receiver that ignores us still streams its defaults, so this is not fatal
+    ret = uc6580_configure(dev);
+    if (ret < 0)
+        LOG_WRN("Receiver configuration incomplete: %d", ret);
 
     return 0;
 }
 
 static int uc6580_start(const struct device* dev) {
-    LOG_INF("START!");
-    return 0;
+    struct uc6580_data* data = dev->data;
+    const struct uc6580_config* cfg = dev->config;
+    int ret = 0;
+
+    k_mutex_lock(&data->cmd.lock, K_FOREVER);
+
+    if (!data->stopped) {
+        ret = -EALREADY;
+        goto unlock;
+    }
+
+    // whatever trickled in while stopping is stale, as is the half built epoch
+    ring_buf_reset(&data->rx_ringbuf);
+    ufirebirdii_nmea_framer_reset(&data->framer);
+    ufirebirdii_epoch_restart(&data->epoch);
+    atomic_set(&data->resync, 0);
+
+    if (cfg->wakeup.port != NULL) {
+        gpio_pin_set_dt(&cfg->wakeup, 1);
+        k_sleep(UC6580_WAKE_PULSE);
+        gpio_pin_set_dt(&cfg->wakeup, 0);
+    } else {
+        // any traffic wakes it, the receiver drops this as noise
+        static const uint8_t wake[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+        uc6580_tx_write(dev, wake, sizeof(wake), UC6580_TX_TIMEOUT);
+    }
+    k_sleep(UC6580_WAKE_DELAY);
+
+    data->stopped = false;
+    ret = uc6580_rx_start(dev);
+    if (ret < 0) {
+        data->stopped = true;
+        LOG_ERR("Failed to restart UART reception: %d", ret);
+        goto unlock;
+    }
+
+    if (cfg->pps.port != NULL) {
+        // the old edges are long gone, keep the calibrated rate but wait for a fresh anchor
+        k_spinlock_key_t key = k_spin_lock(&data->pps.lock);
+        data->pps.timebase.pps_edges = 0;
+        data->pps.anchored = false;
+        k_spin_unlock(&data->pps.lock, key);
+
+        gpio_pin_interrupt_configure_dt(&cfg->pps, GPIO_INT_EDGE_TO_ACTIVE);
+    }
+
+    data->start_ms = k_uptime_get_32();
+    data->fix_pending = true;
+    data->stats.resumes++;
+
+unlock:
+    k_mutex_unlock(&data->cmd.lock);
+    return ret;
 }
 
 static int uc6580_stop(const struct device* dev) {
-    LOG_INF("STOP!");
-    return 0;
+    struct uc6580_data* data = dev->data;
+    const struct uc6580_config* cfg = dev->config;
+    struct k_work_sync sync;
+    int ret;
+
+    // held across the whole sequence (k_mutex is recursive) so no command slips in after standby
+    k_mutex_lock(&data->cmd.lock, K_FOREVER);
+
+    if (data->stopped) {
+        ret = -EALREADY;
+        goto unlock;
+    }
+
+    // stop listening either way, a receiver that refuses standby only costs power
+    ret = uc6580_command(dev, UC6580_CMD_TIMEOUT, UC6580_CMD_STANDBY);
+    if (ret < 0) {
+        LOG_WRN("Receiver did not take standby (%d), stopping reception anyway", ret);
+        data->stats.standby_errors++;
+        ret = 0;
+    }
+
+    data->stopped = true;
+    uc6580_rx_stop(dev);
+    if (cfg->pps.port != NULL)
+        gpio_pin_interrupt_configure_dt(&cfg->pps, GPIO_INT_DISABLE);
+
+    // after this the worker stays idle until uc6580_start, the isr no longer submits it
+    k_work_cancel_sync(&data->rx_work, &sync);
+
+unlock:
+    k_mutex_unlock(&data->cmd.lock);
+    return ret;
 }
 
 static int uc6580_get_fix(const struct device* dev, struct ufirebirdii_fix* fix) {
-    const struct uc6580_data* data = dev->data;
-    if (!data->last_fix.valid) 
+    struct uc6580_data* data = dev->data;
+    struct uc6580_fix_pub* pub = &data->pub;
+    uint32_t seq;
+
+    do {
+        seq = (uint32_t)atomic_get(&pub->seq);
+        if (seq == 0)
+            return -EAGAIN;
+
+        barrier_dmem_fence_full();
+        *fix = pub->slot[seq & 1];
+        barrier_dmem_fence_full();
+    } while ((uint32_t)atomic_get(&pub->seq) != seq); // slot was reused while copying
+
+    if (!fix->valid) 
         return -EAGAIN;
     
-    *fix = data->last_fix;
     return 0;
 }
 
+static uint32_t uc6580_get_epoch(const struct device* dev) {
+    struct uc6580_data* data = dev->data;
+    return (uint32_t)atomic_get(&data->pub.seq);
+}
+
+static int uc6580_manage_callback(const struct device* dev, struct ufirebirdii_fix_callback* cb, bool set) {
+    struct uc6580_data* data = dev->data;
+    return ufirebirdii_manage_callback(&data->callbacks, cb, set);
+}
+
+static int uc6580_get_timebase(const struct device* dev, struct ufirebirdii_timebase* tb) {
+    struct uc6580_data* data = dev->data;
+    const struct uc6580_config* cfg = dev->config;
+
+    if (cfg->pps.port == NULL)
+        return -ENOTSUP;
+
+    k_spinlock_key_t key = k_spin_lock(&data->pps.lock);
+    *tb = data->pps.timebase;
+    bool ready = data->pps.anchored && tb->cycles_per_sec != 0;
+    k_spin_unlock(&data->pps.lock, key);
+
+    return ready ? 0 : -EAGAIN;
+}
+
+static void uc6580_get_stats(const struct device* dev, struct ufirebirdii_stats* stats) {
+    struct uc6580_data* data = dev->data;
+    *stats = data->stats;
+}
+
+static int uc6580_send_rtcm(const struct device* dev, const uint8_t* frame, uint32_t len, k_timeout_t timeout) {
+    struct uc6580_data* data = dev->data;
+
+    int ret = ufirebirdii_rtcm3_check(frame, len);
+    if (ret == 0 && data->stopped)
+        ret = -EAGAIN; // would only wake it, and the corrections are stale by the next start
+    if (ret == 0)
+        ret = uc6580_tx_write(dev, frame, len, timeout);
+
+    if (ret == 0)
+        data->stats.rtcm_frames++;
+    else
+        data->stats.rtcm_dropped++;
+    return ret;
+}
+
 static struct ufirebirdii_api uc6580_api = {
     .start = uc6580_start, 
     .stop = uc6580_stop, 
-    .get_fix = uc6580_get_fix 
+    .get_fix = uc6580_get_fix,
+    .get_epoch = uc6580_get_epoch,
+    .manage_callback = uc6580_manage_callback,
+    .get_timebase = uc6580_get_timebase,
+    .get_stats = uc6580_get_stats,
+    .aid = uc6580_aid,
+    .send_rtcm = uc6580_send_rtcm
 };
 
+// nmea-output enum indices line up with UFBII_MSG_ID_NMEA_*
+#define UC6580_NMEA_BIT(node_id, prop, idx) BIT(DT_ENUM_IDX_BY_IDX(node_id, prop, idx)) |
+
 #define UC6580_CONFIG(inst)                                 \
 {                                                           \
     .uart = DEVICE_DT_GET(DT_INST_PARENT(inst)),            \
-    .pps  = GPIO_DT_SPEC_INST_GET_OR(inst, pps_gpios, {0})  \
+    .pps  = GPIO_DT_SPEC_INST_GET_OR(inst, pps_gpios, {0}), \
+    .wakeup = GPIO_DT_SPEC_INST_GET_OR(inst, wakeup_gpios, {0}), \
+    .baud = DT_INST_PROP_OR(inst, baud, 0),                 \
+    .rtcm_input = DT_INST_PROP(inst, rtcm_input),           \
+    .nmea_output = COND_CODE_1(                             \
+        DT_INST_NODE_HAS_PROP(inst, nmea_output),           \
+        (DT_INST_FOREACH_PROP_ELEM(inst, nmea_output,       \
+            UC6580_NMEA_BIT) 0),                            \
+        (-1)),                                              \
+    .fix_interval_ms = DT_INST_PROP_OR(inst, fix_interval_ms, 0), \
 }                                                           \
 
 #define UC6580_DEFINE(inst)                                 \
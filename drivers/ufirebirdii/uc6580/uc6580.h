@@ -3,20 +3,104 @@
 
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/sys/atomic.h>
 
 #include <drivers/ufirebirdii/ufirebirdii.h>
 
 struct uc6580_config {
     const struct device* uart;
     struct gpio_dt_spec pps;
+    struct gpio_dt_spec wakeup; // pulsed to wake the receiver from standby, UART activity wakes it otherwise
+    uint32_t baud;              // negotiated at init, 0 to stay at current-speed
+    bool rtcm_input;            // enable RTCM3 corrections as a UART input protocol at init
+    int32_t nmea_output;        // BIT(UFBII_MSG_ID_NMEA_*) to keep enabled, -1 to leave as is
+    uint16_t fix_interval_ms;   // 0 to leave the receiver default
+};
+
+// how long to wait for the receiver to OK/FAIL a command
+#define UC6580_CMD_TIMEOUT K_MSEC(500)
+// how long a command may wait behind queued corrections, and a baud change for the queue to drain
+#define UC6580_TX_TIMEOUT K_MSEC(1000)
+
+/*
+ * Standby keeps the receiver's ephemeris, almanac and last position in RAM with the RF and
+ * baseband powered down, so waking it is a hot start. It stays asleep until woken.
+ * The command has not been confirmed against UC6580 firmware: if the receiver answers FAIL
+ * or not at all, uc6580_stop stops reception regardless and counts a standby error.
+ */
+#define UC6580_CMD_STANDBY "CFGPWR,1"
+// wakeup pulse width, and how long the receiver takes to come back before it listens
+#define UC6580_WAKE_PULSE K_MSEC(10)
+#define UC6580_WAKE_DELAY K_MSEC(100)
+
+// longest command or sentence, the same bound the framer stages
+#define UC6580_SENTENCE_MAX UFBII_SENTENCE_MAX
+
+/**
+ * Latest fix, double buffered behind a sequence count. The rx work handler fills the slot
+ * readers are not using and then bumps seq, so it never waits on readers, and readers only
+ * retry if a whole epoch was published while they were copying.
+ */
+struct uc6580_fix_pub {
+    atomic_t seq;   // epochs published so far, slot[seq & 1] is the current one
+    struct ufirebirdii_fix slot[2];
+};
+
+/// PPS edge capture, the isr and the rx work handler share it under lock
+struct uc6580_pps {
+    struct gpio_callback cb;
+    struct k_spinlock lock;
+    uint32_t edge;          // k_cycle_get_32() at the latest edge
+    uint32_t prev_edge;     // and at the one before, the latest may already belong to the next second
+    struct ufirebirdii_timebase timebase;
+    bool anchored;          // timebase.pps_cycles/pps_utc_us are set
+};
+
+/// Command channel, one command in flight at a time
+struct uc6580_cmd {
+    struct k_mutex lock;
+    struct k_sem ack;   // given by the rx work handler on OK/FAIL
+    int result;         // 0 on OK, -EIO on FAIL
+};
+
+/**
+ * Transmit queue. Writers copy whole commands and correction frames into the ring under
+ * lock, the uart isr (or DMA completion) drains it in the background. Reception is served
+ * first in the same isr, so a long correction stream never delays sentence framing.
+ */
+struct uc6580_tx {
+    struct ring_buf ringbuf;
+    uint8_t buf[CONFIG_UC6580_TX_RINGBUFFER_SIZE];
+    struct k_mutex lock;        // one writer at a time, so frames never interleave
+    struct k_sem space;         // given by the isr each time it frees ring space
+    struct k_spinlock kick;     // orders starting the uart against the isr finding the ring empty
+#ifdef CONFIG_UC6580_UART_ASYNC
+    bool busy;                  // a uart_tx of the ring's claimed head is in flight
+#endif
 };
 
 struct uc6580_data {
+    const struct device* dev;
     struct ring_buf rx_ringbuf;
     uint8_t rx_data[CONFIG_UC6580_RINGBUFFER_SIZE];
     struct k_work rx_work;
-    struct ufirebirdii_fix last_fix;
-    struct k_sem fix_sem;    
+#ifdef CONFIG_UC6580_UART_ASYNC
+    uint8_t dma_buf[2][CONFIG_UC6580_ASYNC_BUF_SIZE];
+    uint8_t dma_next;   // dma_buf to hand out on the next UART_RX_BUF_REQUEST
+#endif
+    struct ufirebirdii_nmea_framer framer;
+    struct ufirebirdii_epoch epoch;
+    struct uc6580_fix_pub pub;
+    struct uc6580_pps pps;
+    struct uc6580_cmd cmd;
+    struct uc6580_tx tx;
+    struct ufirebirdii_stats stats;     // byte counters are written by the uart isr, rtcm and tx counters by senders, the rest by the rx work handler
+    atomic_t resync;                    // set by the isr on overrun, the rx work handler drops the ring and resyncs
+    uint32_t start_ms;                  // k_uptime_get_32() when the receiver was started or woken
+    bool fix_pending;                   // no valid fix since start_ms yet
+    bool stopped;                       // in standby, reception is off and the isr must not restart it
+    sys_slist_t callbacks;
     struct ufirebirdii_driver_config devconfig;
 };
 
@@ -5,253 +5,994 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
-#include <stdio.h>
+
+#include "ufirebirdii_parser_table.h" // generated from parser_table.txt
 
 LOG_MODULE_REGISTER(ufirebirdii);
 
-typedef const int (*ufbii_parser_t)(int sentence_idx, const char* content, uint32_t content_len, struct ufirebirdii_fix* fix, struct ufirebirdii_driver_config* cfg);
+struct ufbii_sentence;
+
+typedef const int (*ufbii_parser_t)(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg);
 
 struct ufbii_parser_table {
     const char* sentence_type;
+    uint8_t sentence_len;
     ufbii_parser_t parser;
 };
 
-const struct ufbii_parser_table parser_table[]; // fwd declaration
+static const struct ufbii_parser_table parser_table[UFBII_PARSER_TABLE_SIZE]; // fwd declaration
 
 // Helpers
 
-// Parsers
+struct ufbii_field {
+    const char* str;
+    uint32_t len;
+};
+
+// sentences longer than this are rejected, the index stores offsets as bytes
+#define UFBII_MAX_SENTENCE_LEN UINT8_MAX
+#define UFBII_MAX_FIELDS 40 // GSV, the widest sentence we see, has 21
+
+/*
+ * Single pass index over a sentence, built together with the checksum. Payload field i runs
+ * from delim[i] + 1 (the ',' that starts it) up to delim[i + 1], and delim[num_fields] is the
+ * offset of the '*' or of the sentence end. Parsers get random access by field number.
+ */
+struct ufbii_sentence {
+    const char* str;
+    uint8_t num_fields;
+    uint8_t delim[UFBII_MAX_FIELDS + 1];
+};
+
+static inline struct ufbii_field field_at(const struct ufbii_sentence* s, int i) {
+    return (struct ufbii_field){
+        .str = s->str + s->delim[i] + 1,
+        .len = (uint32_t)(s->delim[i + 1] - s->delim[i] - 1),
+    };
+}
+
+// everything between the type and the checksum
+static inline struct ufbii_field payload(const struct ufbii_sentence* s) {
+    if (s->num_fields == 0)
+        return (struct ufbii_field){.str = s->str + s->delim[0], .len = 0};
 
-static const int echo(int sentence_idx, const char* content, uint32_t content_len, struct ufirebirdii_fix* fix, struct ufirebirdii_driver_config* cfg) {
-    LOG_INF("%s,%.*s", parser_table[sentence_idx].sentence_type, content_len, content);
+    return (struct ufbii_field){
+        .str = s->str + s->delim[0] + 1,
+        .len = (uint32_t)(s->delim[s->num_fields] - s->delim[0] - 1),
+    };
+}
+
+static int decode_uint(struct ufbii_field field, uint32_t* out) {
+    uint32_t val = 0;
+
+    if (field.len == 0 || field.len > 9) // 9 digits always fit
+        return -EINVAL;
+
+    for (uint32_t i = 0; i < field.len; i++) {
+        uint32_t digit = (uint32_t)(field.str[i] - '0');
+        if (digit > 9)
+            return -EINVAL;
+        val = val * 10 + digit;
+    }
+
+    *out = val;
     return 0;
 }
 
-static const int ok(int sentence_idx, const char* content, uint32_t content_len, struct ufirebirdii_fix* fix, struct ufirebirdii_driver_config* cfg) {
-    LOG_INF("OK");
+// decode a decimal number as a fixed point integer with frac_digits digits after the point,
+// extra fraction digits are rounded away
+static int decode_fixed(struct ufbii_field field, int frac_digits, int32_t* out) {
+    const char* p = field.str;
+    const char* end = field.str + field.len;
+    bool negative = false;
+    bool any_digits = false;
+    int64_t val = 0;
+    int frac = -1; // digits seen after the point, -1 before it
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+
+    for (; p < end; p++) {
+        if (*p == '.' && frac < 0) {
+            frac = 0;
+            continue;
+        }
+
+        uint32_t digit = (uint32_t)(*p - '0');
+        if (digit > 9)
+            return -EINVAL;
+        any_digits = true;
+
+        if (frac >= frac_digits) {
+            // first dropped digit decides rounding, the rest are ignored
+            if (frac == frac_digits && digit >= 5)
+                val++;
+            frac++;
+            continue;
+        }
+
+        val = val * 10 + digit;
+        if (frac >= 0)
+            frac++;
+
+        if (val > INT32_MAX)
+            return -EINVAL;
+    }
+
+    if (!any_digits)
+        return -EINVAL;
+
+    for (int i = MAX(frac, 0); i < frac_digits; i++) {
+        val *= 10;
+        if (val > INT32_MAX)
+            return -EINVAL;
+    }
+
+    *out = (int32_t)(negative ? -val : val);
+    return 0;
+}
+
+// decode NMEA (d)ddmm.mmmm plus hemisphere into degrees * UFBII_COORD_SCALE
+static int decode_coord(struct ufbii_field field, struct ufbii_field hemi, int32_t* out) {
+    const char* dot = memchr(field.str, '.', field.len);
+    uint32_t int_len = dot ? (uint32_t)(dot - field.str) : field.len;
+
+    if (int_len < 3 || hemi.len != 1)
+        return -EINVAL;
+
+    // degrees are everything before the two minute digits
+    struct ufbii_field deg_field = {.str = field.str, .len = int_len - 2};
+    struct ufbii_field min_field = {.str = field.str + int_len - 2, .len = field.len - int_len + 2};
+    uint32_t deg;
+    int32_t min_e7;
+
+    if (decode_uint(deg_field, &deg) < 0 || decode_fixed(min_field, 7, &min_e7) < 0)
+        return -EINVAL;
+
+    if (deg > 180 || min_e7 < 0 || min_e7 >= 60 * UFBII_COORD_SCALE)
+        return -EINVAL;
+
+    int64_t val = (int64_t)deg * UFBII_COORD_SCALE + (min_e7 + 30) / 60;
+
+    switch (hemi.str[0]) {
+        case DIRECTION_NORTH:
+        case DIRECTION_EAST:
+            break;
+        case DIRECTION_SOUTH:
+        case DIRECTION_WEST:
+            val = -val;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    *out = (int32_t)val;
+    return 0;
+}
+
+// decode hhmmss(.sss) into the time of day, returns the utc ms of day
+static int32_t decode_time(struct ufbii_field field, struct ufirebirdii_utc* utc) {
+    struct ufbii_field hms = {.str = field.str, .len = 6};
+    struct ufbii_field sec = {.str = field.str + 4, .len = field.len - 4};
+    uint32_t packed;
+    int32_t ms;
+
+    if (field.len < 6 || decode_uint(hms, &packed) < 0 || decode_fixed(sec, 3, &ms) < 0)
+        return -EINVAL;
+
+    uint32_t hour = packed / 10000;
+    uint32_t minute = (packed / 100) % 100;
+
+    if (hour > 23 || minute > 59 || ms >= 61000) // leap seconds
+        return -EINVAL;
+
+    utc->hour = (uint8_t)hour;
+    utc->minute = (uint8_t)minute;
+    utc->second = (uint8_t)(ms / 1000);
+    utc->millisecond = (uint16_t)(ms % 1000);
+
+    return (int32_t)((hour * 60 + minute) * 60 * 1000) + ms;
+}
+
+// decode NMEA ddmmyy into the date
+static int decode_date(struct ufbii_field field, struct ufirebirdii_utc* utc) {
+    uint32_t packed;
+
+    if (field.len != 6 || decode_uint(field, &packed) < 0)
+        return -EINVAL;
+
+    uint32_t day = packed / 10000;
+    uint32_t month = (packed / 100) % 100;
+
+    if (day < 1 || day > 31 || month < 1 || month > 12)
+        return -EINVAL;
+
+    utc->day = (uint8_t)day;
+    utc->month = (uint8_t)month;
+    utc->year = (uint16_t)(2000 + packed % 100);
+    return 0;
+}
+
+// Epoch assembly
+
+// sentence kinds merged into an epoch
+#define KIND_GGA BIT(0)
+#define KIND_RMC BIT(1)
+#define KIND_VTG BIT(2)
+#define KIND_GSA BIT(3)
+#define KIND_GST BIT(4)
+#define KIND_ZDA BIT(5)
+
+void ufirebirdii_epoch_init(struct ufirebirdii_epoch* epoch) {
+    memset(epoch, 0, sizeof(*epoch));
+    epoch->work_time = -1;
+    epoch->closed_time = -1;
+}
+
+void ufirebirdii_epoch_restart(struct ufirebirdii_epoch* epoch) {
+    memset(&epoch->work, 0, sizeof(epoch->work));
+    epoch->work_time = -1;
+    epoch->closed_time = -1;
+    epoch->seen = 0;
+}
+
+// per constellation copies are redundant once the receiver is known to output the combined (GN) one
+static bool epoch_accept(struct ufirebirdii_epoch* epoch, int sentence_idx, uint8_t kind) {
+    const char* type = parser_table[sentence_idx].sentence_type;
+
+    if (type[0] == 'G' && type[1] == 'N') {
+        epoch->combined |= kind;
+        return true;
+    }
+
+    return !(epoch->combined & kind);
+}
+
+static void epoch_close(struct ufirebirdii_epoch* epoch) {
+    if (epoch->work.valid && !epoch->solution.valid)
+        LOG_INF("Got valid fix!");
+
+    epoch->solution = epoch->work;
+    epoch->closed_time = epoch->work_time;
+
+    memset(&epoch->work, 0, sizeof(epoch->work));
+    epoch->work_time = -1;
+    epoch->seen = 0;
+}
+
+/*
+ * Called before a sentence of `kind` is merged, time_ms is -1 for sentences without a time.
+ * Returns UFBII_EPOCH_CLOSED if the sentence started a new epoch and closed the previous one,
+ * 0 if it belongs to the epoch being assembled, or -EALREADY if it belongs to an epoch that
+ * already closed and should be dropped.
+ */
+static int epoch_begin(struct ufirebirdii_epoch* epoch, uint8_t kind, int32_t time_ms) {
+    int ret = 0;
+
+    if (epoch->seen == 0) {
+        // a straggler of the epoch that just closed, wait for it from now on
+        if ((time_ms >= 0 && time_ms == epoch->closed_time) 
+                || (time_ms < 0 && epoch->expected && !(epoch->expected & kind))) {
+            epoch->expected |= kind;
+            return -EALREADY;
+        }
+    } else if (time_ms >= 0 && epoch->work_time >= 0 && time_ms != epoch->work_time) {
+        // time moved on before the epoch completed, the receiver output set shrank
+        epoch->expected = epoch->seen;
+        epoch_close(epoch);
+        ret = UFBII_EPOCH_CLOSED;
+    }
+
+    if (time_ms >= 0)
+        epoch->work_time = time_ms;
+
+    return ret;
+}
+
+// Called after a sentence of `kind` was merged, closes the epoch once every expected kind arrived
+static int epoch_end(struct ufirebirdii_epoch* epoch, uint8_t kind, int closed) {
+    epoch->seen |= kind;
+
+    // only one close per sentence, the caller has to publish the first one
+    if (closed || !epoch->expected || (epoch->seen & epoch->expected) != epoch->expected)
+        return closed;
+
+    epoch->expected |= epoch->seen;
+    epoch_close(epoch);
+    return UFBII_EPOCH_CLOSED;
+}
+
+// Parsers
+
+static const int echo(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufbii_field content = payload(s);
+    LOG_DBG("%s,%.*s", parser_table[sentence_idx].sentence_type, content.len, content.str);
     return 0;
 }
 
-static const int fail(int sentence_idx, const char* content, uint32_t content_len, struct ufirebirdii_fix* fix, struct ufirebirdii_driver_config* cfg) {
-    if (content[1] == '1') 
+static const int ok(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    LOG_DBG("OK");
+    return UFBII_CMD_ACK;
+}
+
+static const int fail(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    // a FAIL is a NACK whatever its code, the waiting command needs to hear about it
+    struct ufbii_field content = payload(s);
+
+    if (content.len > 1 && content.str[1] == '1') 
         LOG_ERR("FAIL: Input to UFirebird II Device Checksum Invalid");
-    else if (content[1] == '0')
+    else if (content.len > 1 && content.str[1] == '0')
         LOG_ERR("FAIL: Invalid parameters in command sent to UFirebird II Device");
     else
-        return -EINVAL; // should never happen :shrug:
+        LOG_ERR("FAIL: %.*s", content.len, content.str);
 
-    return 0;
+    return UFBII_CMD_NACK;
 }
 
 
-#define DEFAULT_FORMAT "%2d%lf,%c,%3d%lf,%c,%d,%d,%lf,%lf"
-#define FORMAT_NUM_FIELDS 10
-#define GGA_PARSE_BUF_SZ 128
+// knots * 1000 -> mm/s
+#define KNOTS_E3_TO_MM_S(kn) ((uint32_t)(((int64_t)(kn) * 1852 + 1800) / 3600))
+// km/h * 1000 -> mm/s
+#define KMH_E3_TO_MM_S(kmh) ((uint32_t)(((int64_t)(kmh) * 10 + 18) / 36))
+
+enum gga_field {
+    GGA_TIME,
+    GGA_LAT,
+    GGA_LAT_DIR,
+    GGA_LON,
+    GGA_LON_DIR,
+    GGA_QUALITY,
+    GGA_SATELLITES,
+    GGA_HDOP,
+    GGA_ALTITUDE,
+    GGA_NUM_FIELDS, // fields past altitude are not used
+};
+
+static const int parse_gga(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufirebirdii_utc utc;
+    uint32_t quality, satellites;
+    int32_t hdop, altitude, latitude, longitude;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_GGA))
+        return 0;
+
+    if (s->num_fields < GGA_NUM_FIELDS)
+        return -EINVAL;
 
-static const int parse_gga(int sentence_idx, const char* content, uint32_t content_len, struct ufirebirdii_fix* fix, struct ufirebirdii_driver_config* cfg) {
-    struct ufirebirdii_fix local_fix = {0};
-    
-    const char* content_no_ts = memchr(content, ',', content_len);
-    if (content_no_ts == NULL || (content_no_ts + 1) >= (content + content_len)) {
+    int32_t time_ms = decode_time(field_at(s, GGA_TIME), &utc);
+    if (time_ms < 0)
         return -EINVAL;
+
+    // No position is common during cold start and not an error
+    bool has_position = field_at(s, GGA_LAT).len > 0;
+    if (has_position && (decode_coord(field_at(s, GGA_LAT), field_at(s, GGA_LAT_DIR), &latitude) < 0
+            || decode_coord(field_at(s, GGA_LON), field_at(s, GGA_LON_DIR), &longitude) < 0
+            || decode_uint(field_at(s, GGA_QUALITY), &quality) < 0
+            || decode_uint(field_at(s, GGA_SATELLITES), &satellites) < 0
+            || decode_fixed(field_at(s, GGA_HDOP), 2, &hdop) < 0
+            || decode_fixed(field_at(s, GGA_ALTITUDE), 3, &altitude) < 0))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_GGA, time_ms);
+    if (closed < 0)
+        return 0;
+
+    struct ufirebirdii_fix* fix = &epoch->work;
+    fix->utc.hour = utc.hour;
+    fix->utc.minute = utc.minute;
+    fix->utc.second = utc.second;
+    fix->utc.millisecond = utc.millisecond;
+    fix->fields |= UFBII_FIX_HAS_TIME;
+
+    if (has_position) {
+        fix->altitude = altitude;
+        fix->satellites = (uint8_t)MIN(satellites, UINT8_MAX);
+        fix->validity = (enum ufbii_fix_validity)quality;
+        fix->latitude = latitude;
+        fix->longitude = longitude;
+        fix->valid = quality != FIX_VALIDITY_INVALID;
+        fix->fields |= UFBII_FIX_HAS_POSITION;
+
+        if (!(fix->fields & UFBII_FIX_HAS_DOP))
+            fix->hdop = (uint16_t)CLAMP(hdop, 0, UINT16_MAX); // GSA carries all three if it shows up
     }
 
-    content_no_ts += 1;
-    
-    size_t n = (size_t)((content + content_len) - content_no_ts);
-    if (n >= GGA_PARSE_BUF_SZ) {
+    return epoch_end(epoch, KIND_GGA, closed);
+}
+
+enum rmc_field {
+    RMC_TIME,
+    RMC_STATUS,
+    RMC_LAT,
+    RMC_LAT_DIR,
+    RMC_LON,
+    RMC_LON_DIR,
+    RMC_SPEED,
+    RMC_COURSE,
+    RMC_DATE,
+    RMC_NUM_FIELDS, // fields past date are not used
+};
+
+static const int parse_rmc(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufirebirdii_utc utc;
+    int32_t latitude, longitude, speed, course = 0;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_RMC))
+        return 0;
+
+    if (s->num_fields < RMC_NUM_FIELDS)
         return -EINVAL;
+
+    int32_t time_ms = decode_time(field_at(s, RMC_TIME), &utc);
+    if (time_ms < 0)
+        return -EINVAL;
+
+    bool has_date = decode_date(field_at(s, RMC_DATE), &utc) == 0;
+
+    // course is empty when standing still
+    bool active = field_at(s, RMC_STATUS).len == 1 && field_at(s, RMC_STATUS).str[0] == 'A';
+    if (active && (decode_coord(field_at(s, RMC_LAT), field_at(s, RMC_LAT_DIR), &latitude) < 0
+            || decode_coord(field_at(s, RMC_LON), field_at(s, RMC_LON_DIR), &longitude) < 0
+            || decode_fixed(field_at(s, RMC_SPEED), 3, &speed) < 0
+            || (field_at(s, RMC_COURSE).len > 0 && decode_fixed(field_at(s, RMC_COURSE), 2, &course) < 0)))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_RMC, time_ms);
+    if (closed < 0)
+        return 0;
+
+    struct ufirebirdii_fix* fix = &epoch->work;
+    fix->utc.hour = utc.hour;
+    fix->utc.minute = utc.minute;
+    fix->utc.second = utc.second;
+    fix->utc.millisecond = utc.millisecond;
+    fix->fields |= UFBII_FIX_HAS_TIME;
+
+    if (has_date) {
+        fix->utc.year = utc.year;
+        fix->utc.month = utc.month;
+        fix->utc.day = utc.day;
+        fix->fields |= UFBII_FIX_HAS_DATE;
+    }
+
+    if (active) {
+        // GGA has altitude and quality, only fall back to RMC position without it
+        if (!(fix->fields & UFBII_FIX_HAS_POSITION)) {
+            fix->latitude = latitude;
+            fix->longitude = longitude;
+            fix->valid = true;
+            fix->fields |= UFBII_FIX_HAS_POSITION;
+        }
+
+        if (!(fix->fields & UFBII_FIX_HAS_VELOCITY)) {
+            fix->speed = KNOTS_E3_TO_MM_S(MAX(speed, 0));
+            fix->course = (uint16_t)CLAMP(course, 0, 35999);
+            fix->fields |= UFBII_FIX_HAS_VELOCITY;
+        }
     }
-    
-    char buf[GGA_PARSE_BUF_SZ];
-    memcpy(buf, content_no_ts, n);
-    buf[n] = '\0';
-
-    int ret = sscanf(buf, DEFAULT_FORMAT,
-        &local_fix.latitude.deg, &local_fix.latitude.min, (char*)&local_fix.latitude.dir,
-        &local_fix.longitude.deg, &local_fix.longitude.min, (char*)&local_fix.longitude.dir,
-        (int*)&local_fix.validity,
-        (int*)&local_fix.satellites,
-        &local_fix.hdop,
-        &local_fix.altitude
-    );
-
-    // DELETEME debugging parsing:
-    if (ret != FORMAT_NUM_FIELDS) {
-        // Only log error when debugging as invalid fixes are common during cold start and trigger this
-        // LOG_ERR("Failed to parse GGA sentence, expected %d fields but got %d", FORMAT_NUM_FIELDS, ret);
+
+    return epoch_end(epoch, KIND_RMC, closed);
+}
+
+enum vtg_field {
+    VTG_COURSE_TRUE,
+    VTG_COURSE_TRUE_UNIT,
+    VTG_COURSE_MAG,
+    VTG_COURSE_MAG_UNIT,
+    VTG_SPEED_KNOTS,
+    VTG_SPEED_KNOTS_UNIT,
+    VTG_SPEED_KMH,
+    VTG_NUM_FIELDS, // fields past km/h speed are not used
+};
+
+static const int parse_vtg(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    int32_t speed, course = 0;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_VTG))
+        return 0;
+
+    if (s->num_fields < VTG_NUM_FIELDS)
         return -EINVAL;
+
+    // speed is empty without a fix
+    bool has_velocity = field_at(s, VTG_SPEED_KMH).len > 0;
+    if (has_velocity && (decode_fixed(field_at(s, VTG_SPEED_KMH), 3, &speed) < 0
+            || (field_at(s, VTG_COURSE_TRUE).len > 0 && decode_fixed(field_at(s, VTG_COURSE_TRUE), 2, &course) < 0)))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_VTG, -1);
+    if (closed < 0)
+        return 0;
+
+    struct ufirebirdii_fix* fix = &epoch->work;
+    if (has_velocity) {
+        fix->speed = KMH_E3_TO_MM_S(MAX(speed, 0));
+        fix->course = (uint16_t)CLAMP(course, 0, 35999);
+        fix->fields |= UFBII_FIX_HAS_VELOCITY;
     }
 
-    if (!fix->valid)
-        LOG_INF("Got valid fix!");
+    return epoch_end(epoch, KIND_VTG, closed);
+}
 
-    fix->altitude = local_fix.altitude;
-    fix->hdop = local_fix.hdop;
-    fix->satellites = local_fix.satellites;
-    fix->validity = local_fix.validity;
-    fix->latitude = local_fix.latitude;
-    fix->longitude = local_fix.longitude;
-    fix->valid = true;
-    return 0;
+enum gsa_field {
+    GSA_MODE,
+    GSA_FIX_TYPE,
+    GSA_SV_FIRST,
+    GSA_PDOP = GSA_SV_FIRST + 12,
+    GSA_HDOP,
+    GSA_VDOP,
+    GSA_NUM_FIELDS, // system id is not used
+};
+
+static const int parse_gsa(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    int32_t pdop, hdop, vdop;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_GSA))
+        return 0;
+
+    if (s->num_fields < GSA_NUM_FIELDS)
+        return -EINVAL;
+
+    bool has_dop = field_at(s, GSA_PDOP).len > 0;
+    if (has_dop && (decode_fixed(field_at(s, GSA_PDOP), 2, &pdop) < 0
+            || decode_fixed(field_at(s, GSA_HDOP), 2, &hdop) < 0
+            || decode_fixed(field_at(s, GSA_VDOP), 2, &vdop) < 0))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_GSA, -1);
+    if (closed < 0)
+        return 0;
+
+    // GNGSA repeats once per constellation with the same DOPs, keep the first
+    struct ufirebirdii_fix* fix = &epoch->work;
+    if (has_dop && !(fix->fields & UFBII_FIX_HAS_DOP)) {
+        fix->pdop = (uint16_t)CLAMP(pdop, 0, UINT16_MAX);
+        fix->hdop = (uint16_t)CLAMP(hdop, 0, UINT16_MAX);
+        fix->vdop = (uint16_t)CLAMP(vdop, 0, UINT16_MAX);
+        fix->fields |= UFBII_FIX_HAS_DOP;
+    }
+
+    return epoch_end(epoch, KIND_GSA, closed);
 }
 
-// NO PLANNED SUPPORT YET: Any messages not applicable to UC6580
-// parser_table MUST BE SORTED
-const struct ufbii_parser_table parser_table[] = {
-    {.sentence_type = "AIDINFO", .parser = echo},
-    {.sentence_type = "ANTSTAT", .parser = echo},
-    {.sentence_type = "ANTSTAT", .parser = echo},
-    {.sentence_type = "CFGACC", .parser = echo},
-    {.sentence_type = "CFGCOG", .parser = echo},
-    {.sentence_type = "CFGDOP", .parser = echo},
-    {.sentence_type = "CFGDYN", .parser = echo},
-    {.sentence_type = "CFGELAPSEC", .parser = echo},
-    {.sentence_type = "CFGEOID", .parser = echo},
-    {.sentence_type = "CFGFWCHECK", .parser = echo},
-    {.sentence_type = "CFGGLARM", .parser = echo},
-    {.sentence_type = "CFGILARM", .parser = echo},
-    {.sentence_type = "CFGIMUMEAS", .parser = echo},
-    {.sentence_type = "CFGINS", .parser = echo},
-    {.sentence_type = "CFGKILOWEEK", .parser = echo},
-    {.sentence_type = "CFGLOGLIST", .parser = echo},
-    {.sentence_type = "CFGMSG", .parser = echo},
-    {.sentence_type = "CFGMSK", .parser = echo},
-    {.sentence_type = "CFGMSM", .parser = echo},
-    {.sentence_type = "CFGNAV", .parser = echo},
-    {.sentence_type = "CFGNMEA", .parser = echo},
-    {.sentence_type = "CFGNMEAMODE", .parser = echo},
-    {.sentence_type = "CFGODOFWD", .parser = echo},
-    {.sentence_type = "CFGPRT", .parser = echo},
-    {.sentence_type = "CFGROTAT", .parser = echo},
-    {.sentence_type = "CFGRTK", .parser = echo},
-    {.sentence_type = "CFGSYS", .parser = echo},
-    {.sentence_type = "CFGTP", .parser = echo},
-    {.sentence_type = "CFGWMODE", .parser = echo},
-    {.sentence_type = "ENVINFO", .parser = echo},
-    {.sentence_type = "FAIL", .parser = fail},
-    {.sentence_type = "GAGBS", .parser = NULL},
-    {.sentence_type = "GAGGA", .parser = parse_gga},
-    {.sentence_type = "GAGLL", .parser = NULL},
-    {.sentence_type = "GAGSA", .parser = NULL},
-    {.sentence_type = "GAGST", .parser = NULL},
-    {.sentence_type = "GARMC", .parser = NULL},
-    {.sentence_type = "GAVTG", .parser = NULL},
-    {.sentence_type = "GAZDA", .parser = NULL},
-    {.sentence_type = "GBGBS", .parser = NULL},
-    {.sentence_type = "GBGGA", .parser = parse_gga},
-    {.sentence_type = "GBGLL", .parser = NULL},
-    {.sentence_type = "GBGSA", .parser = NULL},
-    {.sentence_type = "GBGST", .parser = NULL},
-    {.sentence_type = "GBRMC", .parser = NULL},
-    {.sentence_type = "GBVTG", .parser = NULL},
-    {.sentence_type = "GBZDA", .parser = NULL},
-    {.sentence_type = "GIGBS", .parser = NULL},
-    {.sentence_type = "GIGGA", .parser = parse_gga},
-    {.sentence_type = "GIGLL", .parser = NULL},
-    {.sentence_type = "GIGSA", .parser = NULL},
-    {.sentence_type = "GIGST", .parser = NULL},
-    {.sentence_type = "GIRMC", .parser = NULL},
-    {.sentence_type = "GIVTG", .parser = NULL},
-    {.sentence_type = "GIZDA", .parser = NULL},
-    {.sentence_type = "GLGBS", .parser = NULL},
-    {.sentence_type = "GLGGA", .parser = parse_gga},
-    {.sentence_type = "GLGLL", .parser = NULL},
-    {.sentence_type = "GLGSA", .parser = NULL},
-    {.sentence_type = "GLGST", .parser = NULL},
-    {.sentence_type = "GLRMC", .parser = NULL},
-    {.sentence_type = "GLVTG", .parser = NULL},
-    {.sentence_type = "GLZDA", .parser = NULL},
-    {.sentence_type = "GNGBS", .parser = NULL},
-    {.sentence_type = "GNGGA", .parser = parse_gga},
-    {.sentence_type = "GNGLL", .parser = NULL},
-    {.sentence_type = "GNGSA", .parser = NULL},
-    {.sentence_type = "GNGST", .parser = NULL},
-    {.sentence_type = "GNRMC", .parser = NULL},
-    {.sentence_type = "GNVTG", .parser = NULL},
-    {.sentence_type = "GNZDA", .parser = NULL},
-    {.sentence_type = "GPGBS", .parser = NULL},
-    {.sentence_type = "GPGGA", .parser = parse_gga},
-    {.sentence_type = "GPGLL", .parser = NULL},
-    {.sentence_type = "GPGSA", .parser = NULL},
-    {.sentence_type = "GPGST", .parser = NULL},
-    {.sentence_type = "GPRMC", .parser = NULL},
-    {.sentence_type = "GPVTG", .parser = NULL},
-    {.sentence_type = "GPZDA", .parser = NULL},
-    {.sentence_type = "GYOACC", .parser = echo},
-    {.sentence_type = "IMURAW", .parser = echo},
-    {.sentence_type = "IMUVEH", .parser = echo},
-    {.sentence_type = "INSPVA", .parser = echo},
-    {.sentence_type = "INSTALL", .parser = echo},
-    {.sentence_type = "LSF", .parser = echo},
-    {.sentence_type = "MAPFB", .parser = echo},
-    {.sentence_type = "NAVATT", .parser = echo},
-    {.sentence_type = "ODODATA", .parser = echo},
-    {.sentence_type = "OK", .parser = ok},
-    {.sentence_type = "PDTINFO", .parser = echo},
-    {.sentence_type = "PNAVMSG", .parser = echo},
-    {.sentence_type = "PRODUCTINFO", .parser = echo},
-    {.sentence_type = "QZQSM", .parser = echo},
-    {.sentence_type = "SNRSTAT", .parser = echo},
+enum gst_field {
+    GST_TIME,
+    GST_RMS,
+    GST_MAJOR,
+    GST_MINOR,
+    GST_ORIENTATION,
+    GST_LAT_ERR,
+    GST_LON_ERR,
+    GST_ALT_ERR,
+    GST_NUM_FIELDS,
 };
 
+static const int parse_gst(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufirebirdii_utc utc;
+    int32_t lat_err, lon_err, alt_err;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_GST))
+        return 0;
+
+    if (s->num_fields < GST_NUM_FIELDS)
+        return -EINVAL;
+
+    int32_t time_ms = decode_time(field_at(s, GST_TIME), &utc);
+    if (time_ms < 0)
+        return -EINVAL;
+
+    bool has_error = field_at(s, GST_LAT_ERR).len > 0;
+    if (has_error && (decode_fixed(field_at(s, GST_LAT_ERR), 3, &lat_err) < 0
+            || decode_fixed(field_at(s, GST_LON_ERR), 3, &lon_err) < 0
+            || decode_fixed(field_at(s, GST_ALT_ERR), 3, &alt_err) < 0))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_GST, time_ms);
+    if (closed < 0)
+        return 0;
+
+    struct ufirebirdii_fix* fix = &epoch->work;
+    if (has_error) {
+        fix->lat_err = (uint32_t)MAX(lat_err, 0);
+        fix->lon_err = (uint32_t)MAX(lon_err, 0);
+        fix->alt_err = (uint32_t)MAX(alt_err, 0);
+        fix->fields |= UFBII_FIX_HAS_ERROR;
+    }
+
+    return epoch_end(epoch, KIND_GST, closed);
+}
+
+enum zda_field {
+    ZDA_TIME,
+    ZDA_DAY,
+    ZDA_MONTH,
+    ZDA_YEAR,
+    ZDA_NUM_FIELDS, // local zone is not used
+};
+
+static const int parse_zda(int sentence_idx, const struct ufbii_sentence* s, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufirebirdii_utc utc;
+    uint32_t day, month, year;
+
+    if (!epoch_accept(epoch, sentence_idx, KIND_ZDA))
+        return 0;
+
+    if (s->num_fields < ZDA_NUM_FIELDS)
+        return -EINVAL;
+
+    int32_t time_ms = decode_time(field_at(s, ZDA_TIME), &utc);
+    if (time_ms < 0)
+        return -EINVAL;
+
+    // date is empty until the receiver has decoded it
+    bool has_date = field_at(s, ZDA_YEAR).len > 0;
+    if (has_date && (decode_uint(field_at(s, ZDA_DAY), &day) < 0
+            || decode_uint(field_at(s, ZDA_MONTH), &month) < 0
+            || decode_uint(field_at(s, ZDA_YEAR), &year) < 0
+            || day < 1 || day > 31 || month < 1 || month > 12 || year > UINT16_MAX))
+        return -EINVAL;
+
+    int closed = epoch_begin(epoch, KIND_ZDA, time_ms);
+    if (closed < 0)
+        return 0;
+
+    struct ufirebirdii_fix* fix = &epoch->work;
+    fix->utc.hour = utc.hour;
+    fix->utc.minute = utc.minute;
+    fix->utc.second = utc.second;
+    fix->utc.millisecond = utc.millisecond;
+    fix->fields |= UFBII_FIX_HAS_TIME;
+
+    if (has_date) {
+        fix->utc.year = (uint16_t)year;
+        fix->utc.month = (uint8_t)month;
+        fix->utc.day = (uint8_t)day;
+        fix->fields |= UFBII_FIX_HAS_DATE;
+    }
+
+    return epoch_end(epoch, KIND_ZDA, closed);
+}
+
+// Perfect hash dispatch table, see parser_table.txt and gen_parser_table.py
+static const uint16_t parser_displacements[1 << UFBII_PARSER_BUCKET_BITS] = {
+    UFBII_PARSER_DISPLACEMENTS
+};
+
+static const struct ufbii_parser_table parser_table[UFBII_PARSER_TABLE_SIZE] = {
+    UFBII_PARSER_TABLE_ENTRIES
+};
+
+// MUST match fnv1a()/slot() in gen_parser_table.py
+static uint32_t parser_slot(const char* sentence_type, uint32_t len) {
+    uint32_t h = 0x811C9DC5u;
+
+    for (uint32_t i = 0; i < len; i++) {
+        h ^= (uint8_t)sentence_type[i];
+        h *= 0x01000193u;
+    }
+
+    h ^= parser_displacements[h & ((1u << UFBII_PARSER_BUCKET_BITS) - 1)];
+    return (h * 0x9E3779B1u) >> (32 - UFBII_PARSER_HASH_BITS);
+}
+
 int ufirebirdii_init(const struct device* dev, struct ufirebirdii_driver_config* cfg) {
     return 0;
 }
 
-int ufirebirdii_parse_sentence(const char *sentence, uint32_t sentence_len, struct ufirebirdii_fix *fix, struct ufirebirdii_driver_config* cfg) {
-    // fix->valid = false;
+int64_t ufirebirdii_utc_to_unix_us(const struct ufirebirdii_utc* utc) {
+    // days from civil, proleptic gregorian with march based years
+    int32_t y = (int32_t)utc->year - (utc->month <= 2);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (utc->month + (utc->month > 2 ? -3 : 9)) + 2) / 5 + utc->day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+    int64_t secs = days * 86400 + utc->hour * 3600 + utc->minute * 60 + utc->second;
+    return secs * 1000000 + (int64_t)utc->millisecond * 1000;
+}
 
-    if (cfg->user_config.do_checksum) {
-        if (sentence_len < 4 || sentence[sentence_len - 3] != '*')
-            return -EINVAL;
+int64_t ufirebirdii_cycles_to_utc_us(const struct ufirebirdii_timebase* tb, uint32_t cycles) {
+    int32_t delta = (int32_t)(cycles - tb->pps_cycles); // wraps cleanly within half the counter range
+    return tb->pps_utc_us + ((int64_t)delta * 1000000) / tb->cycles_per_sec;
+}
+
+int ufirebirdii_manage_callback(sys_slist_t* callbacks, struct ufirebirdii_fix_callback* cb, bool set) {
+    if (cb == NULL || cb->handler == NULL)
+        return -EINVAL;
+
+    // re-adding moves the callback to the end instead of linking it twice
+    bool found = sys_slist_find_and_remove(callbacks, &cb->node);
 
-        char* endp;
-        char csum_ptr[3] = {sentence[sentence_len - 2], sentence[sentence_len - 1], '\0'};
-        uint8_t expect = (uint8_t)strtol(csum_ptr, &endp, 16);
+    if (!set)
+        return found ? 0 : -EINVAL;
 
-        if (endp == csum_ptr || *endp != '\0')
+    cb->countdown = 0;
+    sys_slist_append(callbacks, &cb->node);
+    return 0;
+}
+
+void ufirebirdii_fire_callbacks(sys_slist_t* callbacks, const struct device* dev, const struct ufirebirdii_fix* fix) {
+    struct ufirebirdii_fix_callback* cb;
+    struct ufirebirdii_fix_callback* tmp;
+
+    // safe iteration, handlers may remove themselves
+    SYS_SLIST_FOR_EACH_CONTAINER_SAFE(callbacks, cb, tmp, node) {
+        if (cb->countdown > 0) {
+            cb->countdown--;
+            continue;
+        }
+
+        cb->countdown = cb->decimation > 1 ? cb->decimation - 1 : 0;
+        cb->handler(dev, cb, fix);
+    }
+}
+
+static int decode_hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+int ufirebirdii_parse_sentence(const char *sentence, uint32_t sentence_len, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg) {
+    struct ufbii_sentence s = {.str = sentence, .num_fields = 0};
+    uint8_t actual = 0;
+    uint32_t i;
+
+    if (sentence_len < 2 || sentence_len > UFBII_MAX_SENTENCE_LEN)
+        return -EINVAL;
+
+    // the only pass over the sentence: checksum and field delimiters together
+    for (i = 1; i < sentence_len && sentence[i] != '*'; i++) {
+        actual ^= (uint8_t)sentence[i];
+
+        if (sentence[i] == ',') {
+            if (s.num_fields == UFBII_MAX_FIELDS)
+                return -EINVAL;
+            s.delim[s.num_fields++] = (uint8_t)i;
+        }
+    }
+
+    uint32_t star = i; // sentence_len if there is no checksum
+    s.delim[s.num_fields] = (uint8_t)star;
+
+    // the type ends at the first ',', or at the '*' for replies like $OK*xx
+    uint32_t sentence_type_len = s.delim[0] - 1u;
+
+    if (cfg->user_config.do_checksum) {
+        if (star + 3 != sentence_len)
             return -EINVAL;
 
-        uint8_t actual = 0;
-        for (uint32_t i = 1; i < sentence_len - 3; i++)
-            actual ^= (uint8_t)sentence[i];
+        int hi = decode_hex_digit(sentence[star + 1]);
+        int lo = decode_hex_digit(sentence[star + 2]);
+        if (hi < 0 || lo < 0)
+            return -EINVAL;
 
-        if (expect != actual)
+        if (((hi << 4) | lo) != actual)
             return -EILSEQ;
     }
 
-    const char* sentence_type = memchr(sentence, ',', sentence_len);
-    if (!sentence_type)
-        return -EINVAL;
+    if (sentence_type_len == 0 || sentence_type_len > UFBII_PARSER_MAX_TYPE_LEN)
+        return -ENOTSUP;
+
+    uint32_t idx = parser_slot(sentence + 1, sentence_type_len);
+    const struct ufbii_parser_table* entry = &parser_table[idx];
+
+    // slots are unique per known type, unknown types can still land on one
+    if (entry->sentence_len != sentence_type_len || memcmp(sentence + 1, entry->sentence_type, sentence_type_len) != 0)
+        return -ENOTSUP;
+
+    if (!entry->parser)
+        return -ENOTSUP;
+
+    return entry->parser((int)idx, &s, epoch, cfg);
+}
+
+int ufirebirdii_build_command(char* buf, uint32_t buf_len, const char* body) {
+    uint32_t body_len = strlen(body);
+
+    // '$' + body + "*XX\r\n" + '\0'
+    if (body_len + 7 > buf_len)
+        return -ENOMEM;
+
+    uint8_t csum = 0;
+    for (uint32_t i = 0; i < body_len; i++)
+        csum ^= (uint8_t)body[i];
+
+    buf[0] = '$';
+    memcpy(buf + 1, body, body_len);
+    snprintk(buf + 1 + body_len, buf_len - 1 - body_len, "*%02X\r\n", csum);
+
+    return (int)(body_len + 6);
+}
+
+// RTCM3
+
+// CRC-24Q a nibble at a time, a 16 entry table instead of 256
+static const uint32_t crc24q_nibble[16] = {
+    0x000000, 0x864CFB, 0x8AD50D, 0x0C99F6, 0x93E6E1, 0x15AA1A, 0x1933EC, 0x9F7F17,
+    0xA18139, 0x27CDC2, 0x2B5434, 0xAD18CF, 0x3267D8, 0xB42B23, 0xB8B2D5, 0x3EFE2E,
+};
+
+uint32_t ufirebirdii_crc24q(const uint8_t* data, uint32_t len) {
+    uint32_t crc = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ crc24q_nibble[((crc >> 20) ^ (data[i] >> 4)) & 0xF];
+        crc = (crc << 4) ^ crc24q_nibble[((crc >> 20) ^ data[i]) & 0xF];
+    }
+
+    return crc & 0xFFFFFF;
+}
+
+int ufirebirdii_rtcm3_check(const uint8_t* frame, uint32_t len) {
+    if (len < UFBII_RTCM3_HEADER_LEN + UFBII_RTCM3_CRC_LEN || frame[0] != UFBII_RTCM3_PREAMBLE ||
+            (frame[1] & 0xFC) != 0 || ufirebirdii_rtcm3_frame_len(frame) != len)
+        return -EBADMSG;
+
+    if (ufirebirdii_crc24q(frame, len - UFBII_RTCM3_CRC_LEN) != sys_get_be24(frame + len - UFBII_RTCM3_CRC_LEN))
+        return -EBADMSG;
+
+    return 0;
+}
+
+void ufirebirdii_rtcm3_framer_init(struct ufirebirdii_rtcm3_framer* fr) {
+    fr->len = 0;
+    fr->delivered = 0;
+    memset(&fr->stats, 0, sizeof(fr->stats));
+}
+
+// drops held bytes up to the next preamble at or after `from`
+static void rtcm3_skip(struct ufirebirdii_rtcm3_framer* fr, uint32_t from) {
+    const uint8_t* p = from < fr->len ? memchr(fr->frame + from, UFBII_RTCM3_PREAMBLE, fr->len - from) : NULL;
+    uint32_t skip = p != NULL ? (uint32_t)(p - fr->frame) : fr->len;
+
+    memmove(fr->frame, fr->frame + skip, fr->len - skip);
+    fr->len -= skip;
+    fr->stats.discarded += skip;
+}
+
+/*
+ * Looks at the held bytes, returns the length of a valid frame at the start or 0 if more
+ * bytes are needed. A bad header or CRC drops only the preamble, the frame may have been a
+ * false start inside a real one, so the bytes after it are searched again.
+ */
+static uint32_t rtcm3_settle(struct ufirebirdii_rtcm3_framer* fr) {
+    while (fr->len > 0) {
+        if (fr->frame[0] != UFBII_RTCM3_PREAMBLE || (fr->len >= 2 && (fr->frame[1] & 0xFC) != 0)) {
+            rtcm3_skip(fr, 1);
+            continue;
+        }
+
+        if (fr->len < UFBII_RTCM3_HEADER_LEN)
+            return 0;
+
+        uint32_t frame_len = ufirebirdii_rtcm3_frame_len(fr->frame);
+        if (fr->len < frame_len)
+            return 0;
+
+        if (ufirebirdii_crc24q(fr->frame, frame_len - UFBII_RTCM3_CRC_LEN) ==
+                sys_get_be24(fr->frame + frame_len - UFBII_RTCM3_CRC_LEN)) {
+            fr->stats.frames++;
+            return frame_len;
+        }
+
+        fr->stats.crc_errors++;
+        rtcm3_skip(fr, 1);
+    }
+
+    return 0;
+}
+
+uint32_t ufirebirdii_rtcm3_feed(struct ufirebirdii_rtcm3_framer* fr, const uint8_t* data, uint32_t len, uint32_t* used) {
+    uint32_t i = 0;
+
+    if (fr->delivered > 0) {
+        // a resync can leave bytes of the next frame behind the one handed out
+        memmove(fr->frame, fr->frame + fr->delivered, fr->len - fr->delivered);
+        fr->len -= fr->delivered;
+        fr->delivered = 0;
+    }
+
+    for (;;) {
+        uint32_t frame_len = rtcm3_settle(fr);
+        if (frame_len > 0) {
+            fr->delivered = frame_len;
+            break;
+        }
 
-    uint32_t sentence_type_len = (uint32_t)(sentence_type - sentence - 1);
+        if (i == len)
+            break;
 
-    int left = 0;
-    int right = (int)(sizeof(parser_table) / sizeof(parser_table[0])) - 1;
+        if (fr->len == 0) {
+            const uint8_t* p = memchr(data + i, UFBII_RTCM3_PREAMBLE, len - i);
+            uint32_t start = p != NULL ? (uint32_t)(p - data) : len;
+            fr->stats.discarded += start - i;
+            i = start;
+            if (i == len)
+                break;
+        }
 
-    while (left <= right) {
-        int mid = left + (right - left) / 2;
-        int cmp = strncmp(sentence + 1, parser_table[mid].sentence_type, sentence_type_len);
-        if (cmp == 0) {
-            if (!parser_table[mid].parser)
-                return -ENOTSUP;
+        // take only what the frame still needs, so the rest stays with the caller
+        uint32_t need = fr->len < UFBII_RTCM3_HEADER_LEN
+            ? UFBII_RTCM3_HEADER_LEN - fr->len
+            : ufirebirdii_rtcm3_frame_len(fr->frame) - fr->len;
+        uint32_t n = MIN(need, len - i);
 
-            const char *payload = sentence + sentence_type_len + 2;
-            uint32_t payload_len = sentence_len - sentence_type_len - 2;
+        memcpy(fr->frame + fr->len, data + i, n);
+        fr->len += n;
+        i += n;
+    }
 
-            const char *star = memchr(payload, '*', payload_len); // strip off checksum
-            if (star != NULL) {
-                payload_len = (uint32_t)(star - payload);
-            }
+    *used = i;
+    return fr->delivered;
+}
+
+void ufirebirdii_nmea_framer_reset(struct ufirebirdii_nmea_framer* fr) {
+    fr->scanned = 0;
+    fr->staged = 0;
+    fr->synced = false;
+}
 
-            return parser_table[mid].parser(mid, payload, payload_len, fix, cfg);
-        } else if (cmp < 0) {
-            right = mid - 1;
+int ufirebirdii_nmea_feed(struct ufirebirdii_nmea_framer* fr, const uint8_t* data, uint32_t len, bool wraps, const uint8_t** sentence, uint32_t* used) {
+    uint32_t skip = 0;
+
+    if (!fr->synced) {
+        const uint8_t* start = memchr(data, '$', len);
+        if (start == NULL) {
+            *used = len; // no start in sight, discard
+            return 0;
+        }
+
+        // discard bytes before '$'
+        skip = (uint32_t)(start - data);
+        data += skip;
+        len -= skip;
+        fr->synced = true;
+        fr->scanned = 0;
+    }
+
+    const uint8_t* end = memchr(data + fr->scanned, '\n', len - fr->scanned);
+    if (end != NULL) {
+        uint32_t tail_len = (uint32_t)(end - data) + 1;
+        int ret = (int)(fr->staged + tail_len);
+
+        // the same bound in place as staged, so how the bytes arrived does not decide what is dropped
+        if (ret > (int)sizeof(fr->stage_buf)) {
+            ret = -EMSGSIZE;
+        } else if (fr->staged == 0) {
+            *sentence = data; // parse straight out of the ring
         } else {
-            left = mid + 1;
+            memcpy(fr->stage_buf + fr->staged, data, tail_len);
+            *sentence = fr->stage_buf;
         }
+
+        *used = skip + tail_len;
+        ufirebirdii_nmea_framer_reset(fr);
+        return ret;
+    }
+
+    *used = skip + len;
+    if (fr->staged + len > sizeof(fr->stage_buf)) {
+        // no line end within the longest sentence we accept, drop it and resync
+        ufirebirdii_nmea_framer_reset(fr);
+        return -EMSGSIZE;
+    }
+
+    if (wraps) {
+        // sentence runs off the end of the ring, stage what we have and take the rest from its start
+        memcpy(fr->stage_buf + fr->staged, data, len);
+        fr->staged += len;
+        fr->scanned = 0;
+        return 0;
     }
 
-    return -ENOTSUP;
+    // wait for more data, picking up where this scan left off
+    *used = skip;
+    fr->scanned = len;
+    return 0;
 }
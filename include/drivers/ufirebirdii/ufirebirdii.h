@@ -10,6 +10,9 @@
 #include <stdbool.h>
 #include <zephyr/device.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/sys/byteorder.h>
 #include <time.h>
 
 enum ufbii_direction {
@@ -20,11 +23,8 @@ enum ufbii_direction {
     DIRECTION_INVALID = 'I'
 };
 
-typedef struct {
-    int deg;
-    double min;
-    enum ufbii_direction dir;
-} coord_t;
+/// Latitude/longitude scale, coordinates are stored as degrees * UFBII_COORD_SCALE
+#define UFBII_COORD_SCALE 10000000
 
 enum ufbii_fix_validity {
     FIX_VALIDITY_INVALID = 0,
@@ -35,16 +35,67 @@ enum ufbii_fix_validity {
     FIX_VALITIDY_INS_POSITIONING = 6,
 };
 
+/// ufirebirdii_fix.fields bits, set for each group of fields the epoch actually carried
+#define UFBII_FIX_HAS_POSITION  BIT(0)  // latitude, longitude, altitude, satellites
+#define UFBII_FIX_HAS_VELOCITY  BIT(1)  // speed, course
+#define UFBII_FIX_HAS_TIME      BIT(2)  // utc hour through millisecond
+#define UFBII_FIX_HAS_DATE      BIT(3)  // utc year, month, day
+#define UFBII_FIX_HAS_DOP       BIT(4)  // pdop, hdop, vdop
+#define UFBII_FIX_HAS_ERROR     BIT(5)  // lat_err, lon_err, alt_err
+#define UFBII_FIX_HAS_PPS       BIT(6)  // pps_cycles
+
+struct ufirebirdii_utc {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint16_t millisecond;
+};
+
 struct ufirebirdii_fix {
-    coord_t latitude;
-    coord_t longitude;
-    double altitude;
-    double hdop;
+    int32_t latitude;   // degrees * UFBII_COORD_SCALE, north positive
+    int32_t longitude;  // degrees * UFBII_COORD_SCALE, east positive
+    int32_t altitude;   // millimeters above mean sea level
+    uint32_t speed;     // millimeters per second over ground
+    uint16_t course;    // degrees true * 100
+    uint16_t pdop;      // pdop * 100
+    uint16_t hdop;      // hdop * 100
+    uint16_t vdop;      // vdop * 100
+    uint32_t lat_err;   // 1 sigma latitude error, millimeters
+    uint32_t lon_err;   // 1 sigma longitude error, millimeters
+    uint32_t alt_err;   // 1 sigma altitude error, millimeters
+    struct ufirebirdii_utc utc;
+    uint32_t pps_cycles; // k_cycle_get_32() stamp of the PPS edge that started the utc second
+    uint32_t epoch;     // publish count of this fix, increases by one per epoch
     uint8_t satellites;
+    uint8_t fields;     // UFBII_FIX_HAS_* bits
     bool valid;
     enum ufbii_fix_validity validity;
 };
 
+/// Returned by ufirebirdii_parse_sentence when a sentence closed an epoch
+#define UFBII_EPOCH_CLOSED 1
+/// ufirebirdii_parse_sentence results for the receiver's reply to a command
+#define UFBII_CMD_ACK 2
+#define UFBII_CMD_NACK 3
+
+/**
+ * Merges the sentences of one navigation epoch into a single fix. Combined (GN) sentences
+ * are preferred, per constellation copies are skipped once the receiver is known to output
+ * the combined one.
+ */
+struct ufirebirdii_epoch {
+    struct ufirebirdii_fix work;        // epoch being assembled
+    struct ufirebirdii_fix solution;    // last closed epoch
+    int32_t work_time;                  // utc ms of day of the epoch being assembled, -1 if unknown
+    int32_t closed_time;                // utc ms of day of the last closed epoch, -1 if unknown
+    uint8_t seen;                       // sentence kinds merged into work
+    uint8_t expected;                   // sentence kinds the receiver outputs per epoch, learned
+    uint8_t combined;                   // sentence kinds the receiver outputs with the GN talker
+};
+
 #define UFBII_ADDR_I2C 0x46
 #define UFBII_ADDR_DEFAULT 0x00
 
@@ -135,6 +186,54 @@ enum ufirebirdii_msg_class {
     UFBII_MSG_CLASS_OBSERVATION_RF = 9, // UC6580 & UM670A & UM680A
 };
 
+/*
+ * RTCM3 correction frame: preamble (1) | 6 reserved zero bits, 10 bit payload length (2, BE) | payload | CRC-24Q (3, BE)
+ * The CRC covers preamble through payload.
+ */
+#define UFBII_RTCM3_PREAMBLE    0xD3
+#define UFBII_RTCM3_HEADER_LEN  3
+#define UFBII_RTCM3_CRC_LEN     3
+#define UFBII_RTCM3_PAYLOAD_MAX 1023
+#define UFBII_RTCM3_FRAME_MAX   (UFBII_RTCM3_HEADER_LEN + UFBII_RTCM3_PAYLOAD_MAX + UFBII_RTCM3_CRC_LEN)
+
+/// Total length of the RTCM3 frame starting with `header`, which must hold UFBII_RTCM3_HEADER_LEN bytes
+static inline uint32_t ufirebirdii_rtcm3_frame_len(const uint8_t* header) {
+    return UFBII_RTCM3_HEADER_LEN + (((header[1] & 0x03) << 8) | header[2]) + UFBII_RTCM3_CRC_LEN;
+}
+
+/// RTCM3 framer stats
+struct ufirebirdii_rtcm3_stats {
+    uint32_t frames;        // frames that passed the CRC
+    uint32_t crc_errors;    // frames that did not, the framer resyncs on the next preamble
+    uint32_t discarded;     // bytes skipped while hunting for a preamble
+};
+
+/**
+ * Reassembles RTCM3 frames from a byte stream that may split them anywhere, such as radio
+ * payloads or file reads. Not thread safe, feed it from one context.
+ */
+struct ufirebirdii_rtcm3_framer {
+    uint32_t len;           // bytes held in frame
+    uint32_t delivered;     // length of the frame handed out by the last feed, dropped on the next one
+    struct ufirebirdii_rtcm3_stats stats;
+    uint8_t frame[UFBII_RTCM3_FRAME_MAX];
+};
+
+// longest sentence the NMEA framer will stage, NMEA allows 82 but unicore sentences run longer
+#define UFBII_SENTENCE_MAX 128
+
+/**
+ * Frames NMEA and unicore sentences in place out of a receive ring the caller owns. The scan
+ * position persists across calls so no byte is searched twice, only a sentence that wraps
+ * the end of the ring is copied. Not thread safe, feed it from one context.
+ */
+struct ufirebirdii_nmea_framer {
+    uint32_t scanned;   // bytes past the ring head already searched for '\n'
+    uint32_t staged;    // bytes of a sentence that wrapped the ring, held in stage_buf
+    bool synced;        // ring head (or stage_buf) starts with '$'
+    uint8_t stage_buf[UFBII_SENTENCE_MAX];
+};
+
 struct ufirebirdii_user_config {
     bool do_checksum;
     // TODO
@@ -150,25 +249,257 @@ struct ufirebirdii_driver_config {
     // TODO
 };
 
+/**
+ * PPS disciplined mapping from the local hardware cycle counter to UTC. Only valid while
+ * the PPS keeps arriving, the anchor is refreshed every second.
+ */
+struct ufirebirdii_timebase {
+    uint32_t pps_cycles;        // k_cycle_get_32() stamp of the anchor PPS edge
+    int64_t pps_utc_us;         // UTC of the anchor edge, microseconds since the unix epoch
+    uint32_t cycles_per_sec;    // cycle counter rate measured between PPS edges
+    uint32_t latency_us;        // PPS edge to publish of the last epoch (UART, framing and parsing)
+    uint32_t latency_max_us;
+    uint32_t pps_edges;         // PPS edges seen
+};
+
+/// Ingest counters since init, for sizing buffers and baud from data
+struct ufirebirdii_stats {
+    uint32_t bytes_rx;          // bytes read from the UART
+    uint32_t bytes_dropped;     // bytes lost to a full ring buffer
+    uint32_t overruns;          // times the ring buffer filled, each forces a resync
+    uint32_t sentences;         // sentences and frames parsed
+    uint32_t checksum_errors;   // -EILSEQ
+    uint32_t unsupported;       // -ENOTSUP, unknown type or no parser
+    uint32_t parse_errors;      // any other parse failure, including overlong sentences
+    uint32_t ring_high_water;   // most bytes ever waiting in the ring buffer
+    uint32_t handler_max_us;    // longest rx work handler run
+    uint32_t ttff_ms;           // receiver start to first valid fix, 0 until then
+    uint32_t reacq_ms;          // last resume from standby to first valid fix, 0 until then
+    uint32_t resumes;           // times the receiver was woken from standby
+    uint32_t standby_errors;    // stops the receiver did not confirm, it may have kept running
+    uint32_t bytes_tx;          // bytes written to the UART, commands and corrections
+    uint32_t rtcm_frames;       // RTCM3 frames queued to the receiver
+    uint32_t rtcm_dropped;      // RTCM3 frames refused for a bad CRC, a stopped receiver or no room in time
+    uint32_t tx_high_water;     // most bytes ever waiting in the tx ring buffer
+    uint64_t handler_cycles;    // all rx work handler runs, framing, parsing and fix callbacks
+};
+
+struct ufirebirdii_fix_callback;
+
+/**
+ * @brief Fix subscriber, called from the driver's rx work item each time an epoch is
+ * published (after decimation). `fix` is only valid for the duration of the call. 
+ * Keep it short, sentences are not framed while it runs.
+ */
+typedef void (*ufirebirdii_fix_handler_t)(const struct device* dev, struct ufirebirdii_fix_callback* cb, const struct ufirebirdii_fix* fix);
+
+struct ufirebirdii_fix_callback {
+    sys_snode_t node;                   // driver use only
+    ufirebirdii_fix_handler_t handler;
+    uint16_t decimation;                // deliver every Nth epoch, 0 and 1 deliver every epoch
+    uint16_t countdown;                 // driver use only
+};
+
 struct ufirebirdii_api {
     int (*start)(const struct device* dev);
     int (*stop)(const struct device* dev);
     int (*get_fix)(const struct device* dev, struct ufirebirdii_fix* fix);
+    uint32_t (*get_epoch)(const struct device* dev);
+    int (*manage_callback)(const struct device* dev, struct ufirebirdii_fix_callback* cb, bool set);
+    int (*get_timebase)(const struct device* dev, struct ufirebirdii_timebase* tb);
+    void (*get_stats)(const struct device* dev, struct ufirebirdii_stats* stats);
+    int (*aid)(const struct device* dev, const struct ufirebirdii_fix* fix);
+    int (*send_rtcm)(const struct device* dev, const uint8_t* frame, uint32_t len, k_timeout_t timeout);
 };
 
+/**
+ * @brief Wakes the receiver from standby and resumes reception. The receiver kept its
+ * ephemeris and last position, so the next fix is usually a hot start, its time is reported
+ * in `ufirebirdii_stats.reacq_ms`. Blocks on the receiver, do not call it from a fix callback.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EALREADY if the receiver is already running.
+ */
 static inline int ufirebirdii_start(const struct device* dev) {
     return ((const struct ufirebirdii_api*)dev->api)->start(dev);
 }
 
+/**
+ * @brief Puts the receiver into standby and stops reception until `ufirebirdii_start`.
+ * The last fix stays readable with `ufirebirdii_get_fix`. Blocks on the receiver, do not
+ * call it from a fix callback.
+ * Reception stops even if the receiver does not confirm standby, that is counted in
+ * `ufirebirdii_stats.standby_errors` and the receiver may keep drawing full power.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EALREADY if the receiver is already stopped.
+ */
 static inline int ufirebirdii_stop(const struct device* dev) {
     return ((const struct ufirebirdii_api*)dev->api)->stop(dev);
 }
 
+/**
+ * @brief Copies the latest published fix. Never blocks the parser, and only retries if
+ * a new epoch is published mid-copy.
+ * @returns 0 on success, `errno < 0` on failure. 
+ * @retval -EAGAIN if no valid fix has been published yet, `fix` still holds the latest epoch if any.
+ */
 static inline int ufirebirdii_get_fix(const struct device* dev, struct ufirebirdii_fix* fix) {
     return ((const struct ufirebirdii_api*)dev->api)->get_fix(dev, fix);
 }
 
+/**
+ * @brief Cheap check for new data, compare against `ufirebirdii_fix.epoch` of the last fix read.
+ * @returns number of epochs published so far, 0 if none.
+ */
+static inline uint32_t ufirebirdii_get_epoch(const struct device* dev) {
+    return ((const struct ufirebirdii_api*)dev->api)->get_epoch(dev);
+}
+
+/**
+ * @brief Copies the PPS timebase, see `ufirebirdii_cycles_to_utc_us`. 
+ * @returns 0 on success, `errno < 0` on failure. 
+ * @retval -EAGAIN if no PPS edge has been tied to a dated epoch yet, latency fields are still filled.
+ * @retval -ENOTSUP if the device has no PPS pin.
+ */
+static inline int ufirebirdii_get_timebase(const struct device* dev, struct ufirebirdii_timebase* tb) {
+    return ((const struct ufirebirdii_api*)dev->api)->get_timebase(dev, tb);
+}
+
+/**
+ * @brief Copies the ingest counters. Counters are updated without locking, so a copy
+ * taken mid-update can be off by one event.
+ */
+static inline void ufirebirdii_get_stats(const struct device* dev, struct ufirebirdii_stats* stats) {
+    ((const struct ufirebirdii_api*)dev->api)->get_stats(dev, stats);
+}
+
+/**
+ * @brief Injects a previous fix as aiding to speed up the next first fix. The date and time
+ * are sent if the fix has both, then the position. Blocks until the receiver acknowledges,
+ * so do not call it from a fix callback.
+ * @returns 0 on success, `errno < 0` on failure. 
+ * @retval -ENODATA if the fix has neither position nor date and time.
+ * @retval -ETIMEDOUT if the receiver did not answer.
+ * @retval -EIO if the receiver rejected the aiding.
+ */
+static inline int ufirebirdii_aid(const struct device* dev, const struct ufirebirdii_fix* fix) {
+    return ((const struct ufirebirdii_api*)dev->api)->aid(dev, fix);
+}
+
+/**
+ * @brief Queues one whole RTCM3 frame (preamble through CRC) for the receiver's UART. The
+ * frame is copied and sent behind anything already queued, the UART interrupt keeps draining
+ * received sentences while it goes out. Waits up to `timeout` for room, a frame is never
+ * split or partially queued. Corrections go stale fast, so a short timeout that drops frames
+ * is better than a long one that delays every frame after it.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EBADMSG if the frame is malformed or fails its CRC.
+ * @retval -EAGAIN if the receiver is stopped or there was no room in time.
+ */
+static inline int ufirebirdii_send_rtcm(const struct device* dev, const uint8_t* frame, uint32_t len, k_timeout_t timeout) {
+    return ((const struct ufirebirdii_api*)dev->api)->send_rtcm(dev, frame, len, timeout);
+}
+
+/**
+ * @brief Prepares a fix callback for `ufirebirdii_add_fix_callback`. 
+ * @param cb the callback to initialize
+ * @param handler called once every `decimation` published epochs
+ * @param decimation deliver every Nth epoch, 0 or 1 to deliver every epoch
+ */
+static inline void ufirebirdii_init_fix_callback(struct ufirebirdii_fix_callback* cb, ufirebirdii_fix_handler_t handler, uint16_t decimation) {
+    cb->handler = handler;
+    cb->decimation = decimation;
+    cb->countdown = 0;
+}
+
+/**
+ * @brief Subscribes `cb` to published epochs, the first epoch after adding is always delivered. 
+ * Add and remove callbacks from thread context.
+ * @returns 0 on success, `errno < 0` on failure. 
+ */
+static inline int ufirebirdii_add_fix_callback(const struct device* dev, struct ufirebirdii_fix_callback* cb) {
+    return ((const struct ufirebirdii_api*)dev->api)->manage_callback(dev, cb, true);
+}
+
+/**
+ * @brief Unsubscribes `cb`. 
+ * @returns 0 on success, `errno < 0` on failure. 
+ * @retval -EINVAL if `cb` was not subscribed.
+ */
+static inline int ufirebirdii_remove_fix_callback(const struct device* dev, struct ufirebirdii_fix_callback* cb) {
+    return ((const struct ufirebirdii_api*)dev->api)->manage_callback(dev, cb, false);
+}
+
 // ufirebirdii api
-int ufirebirdii_parse_sentence(const char *sentence, uint32_t sentence_len, struct ufirebirdii_fix *fix, struct ufirebirdii_driver_config* cfg);
+int64_t ufirebirdii_utc_to_unix_us(const struct ufirebirdii_utc* utc);
+
+/**
+ * @brief Converts a `k_cycle_get_32()` stamp to UTC through a timebase from `ufirebirdii_get_timebase`.
+ * Stamps must be within half a counter wrap of the anchor edge.
+ * @returns UTC in microseconds since the unix epoch.
+ */
+int64_t ufirebirdii_cycles_to_utc_us(const struct ufirebirdii_timebase* tb, uint32_t cycles);
+
+int ufirebirdii_manage_callback(sys_slist_t* callbacks, struct ufirebirdii_fix_callback* cb, bool set);
+void ufirebirdii_fire_callbacks(sys_slist_t* callbacks, const struct device* dev, const struct ufirebirdii_fix* fix);
+
+void ufirebirdii_epoch_init(struct ufirebirdii_epoch* epoch);
+/// Drops the epoch being assembled after a gap in the stream, keeps what was learned about the receiver's output
+void ufirebirdii_epoch_restart(struct ufirebirdii_epoch* epoch);
+
+/**
+ * @brief Parses one sentence (without line ending) and merges it into `epoch`. 
+ * @returns 0 on success, `errno < 0` on failure. 
+ * @retval `UFBII_EPOCH_CLOSED` if an epoch was closed and `epoch->solution` was updated.
+ * @retval `UFBII_CMD_ACK`/`UFBII_CMD_NACK` if the sentence is an OK/FAIL reply to a command.
+ * @retval -EILSEQ if the checksum does not match.
+ * @retval -ENOTSUP if the sentence type is unknown or has no parser.
+ * @retval -EINVAL if the sentence is malformed.
+ */
+int ufirebirdii_parse_sentence(const char *sentence, uint32_t sentence_len, struct ufirebirdii_epoch* epoch, struct ufirebirdii_driver_config* cfg);
+
+/**
+ * @brief Formats `$<body>*<checksum>\r\n` into `buf`. 
+ * @returns length written on success, `errno < 0` on failure. 
+ * @retval -ENOMEM if `buf` is too small.
+ */
+int ufirebirdii_build_command(char* buf, uint32_t buf_len, const char* body);
+
+/// @returns the CRC-24Q (RTCM3, polynomial 0x1864CFB, zero seed) of `len` bytes
+uint32_t ufirebirdii_crc24q(const uint8_t* data, uint32_t len);
+
+/**
+ * @brief Checks an RTCM3 frame's preamble, reserved bits, length and CRC.
+ * @returns 0 if `frame` holds exactly one valid frame, -EBADMSG otherwise.
+ */
+int ufirebirdii_rtcm3_check(const uint8_t* frame, uint32_t len);
+
+/// @brief Empties the framer and clears its stats.
+void ufirebirdii_rtcm3_framer_init(struct ufirebirdii_rtcm3_framer* fr);
+
+/**
+ * @brief Feeds bytes to the framer until a frame completes. Call again with the rest of
+ * the bytes (`data + *used`) until it returns 0, a completed frame may already be waiting
+ * from the bytes of earlier calls.
+ * @param used set to the number of bytes consumed
+ * @returns length of the frame completed at `fr->frame`, valid until the next call,
+ *      0 once every byte was consumed without completing one.
+ */
+uint32_t ufirebirdii_rtcm3_feed(struct ufirebirdii_rtcm3_framer* fr, const uint8_t* data, uint32_t len, uint32_t* used);
+
+/// @brief Drops any partial sentence, the next feed hunts for a '$'.
+void ufirebirdii_nmea_framer_reset(struct ufirebirdii_nmea_framer* fr);
+
+/**
+ * @brief Looks for the next sentence in the oldest `len` bytes left in a ring, contiguous at
+ * `data`. Bytes searched without finding the end of a sentence are left with the caller, pass
+ * them again along with what arrived after them.
+ * @param wraps true if `data + len` is the end of the ring, a sentence cut there is staged
+ * @param sentence set to the sentence, '$' through '\n', in `data` or the framer's stage_buf.
+ *      Valid until the caller drops `*used` bytes from the ring.
+ * @param used set to the number of bytes the caller may drop from the ring
+ * @returns length of the sentence, 0 if more bytes are needed, `errno < 0` on failure.
+ * @retval -EMSGSIZE if no line end came within UFBII_SENTENCE_MAX bytes, the sentence was dropped.
+ */
+int ufirebirdii_nmea_feed(struct ufirebirdii_nmea_framer* fr, const uint8_t* data, uint32_t len, bool wraps, const uint8_t** sentence, uint32_t* used);
 
 #endif // UFIREBIRDII_H
@@ -0,0 +1,160 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+/// Index value for "no zone"/"no entry" in the zone and bucket tables
+#define GEOFENCE_NONE UINT16_MAX
+
+enum geofence_shape {
+    GEOFENCE_CIRCLE,
+    GEOFENCE_POLYGON,
+};
+
+enum geofence_event {
+    GEOFENCE_ENTER,
+    GEOFENCE_EXIT,
+};
+
+/// A zone corner or center, degrees * UFBII_COORD_SCALE like ufirebirdii_fix
+struct geofence_point {
+    int32_t lat;
+    int32_t lon;
+};
+
+/// Compiled in zone table entry for geofence_load_table
+struct geofence_zone_def {
+    uint16_t id;
+    enum geofence_shape shape;
+    uint32_t radius_m;                      // circle only
+    const struct geofence_point* points;    // circle center, or polygon corners in order
+    uint16_t num_points;                    // 1 for a circle
+};
+
+struct geofence_zone {
+    uint16_t id;
+    uint8_t shape;                          // enum geofence_shape
+    bool inside;
+    uint16_t stamp;                         // last evaluation that tested this zone, so a zone found twice is tested once
+    int32_t min_lat, max_lat;               // bounding box, checked before the exact test
+    int32_t min_lon, max_lon;
+    union {
+        struct {
+            struct geofence_point center;
+            uint32_t lon_scale;             // cos(center latitude) in Q16, squares up longitude degrees
+            uint64_t radius_sq;             // radius squared, in latitude units
+        } circle;
+        struct {
+            uint16_t first;                 // index into geofence.vertices
+            uint16_t count;
+        } polygon;
+    };
+};
+
+/// Grid bucket chain link, a zone has one per grid cell its bounding box covers
+struct geofence_cell_entry {
+    uint16_t zone;
+    uint16_t next;
+};
+
+struct geofence_stats {
+    uint32_t evaluations;   // fixes evaluated
+    uint32_t candidates;    // zones pulled from the grid, the inside list and the wide list
+    uint32_t exact_tests;   // candidates whose bounding box held the fix
+    uint32_t transitions;   // enter and exit events emitted
+};
+
+struct geofence;
+
+/**
+ * @brief Called on every transition, from the context that called `geofence_update`.
+ * @param gf the geofence the zone belongs to
+ * @param zone_id the id the zone was added with
+ * @param event whether the fix entered or left the zone
+ * @param fix the fix that caused the transition
+ */
+typedef void (*geofence_handler_t)(struct geofence* gf, uint16_t zone_id, enum geofence_event event,
+    const struct ufirebirdii_fix* fix, void* user_data);
+
+/**
+ * A set of zones, bucketed on a hashed grid of CONFIG_GEOFENCE_CELL_SIZE_M cells. An update
+ * only tests the zones of the fix's cell, the zones the last fix was inside (to catch exits)
+ * and the few zones too big for the grid, so its cost does not grow with the number of zones.
+ * Not thread safe, load zones before the first update and update from one context.
+ */
+struct geofence {
+    struct geofence_zone zones[CONFIG_GEOFENCE_MAX_ZONES];
+    struct geofence_point vertices[CONFIG_GEOFENCE_MAX_VERTICES];
+    struct geofence_cell_entry entries[CONFIG_GEOFENCE_MAX_CELL_ENTRIES];
+    uint16_t buckets[CONFIG_GEOFENCE_GRID_BUCKETS];     // first entry per bucket, GEOFENCE_NONE if empty
+    uint16_t wide[CONFIG_GEOFENCE_MAX_ZONES];           // zones covering too many cells, tested on every update
+    uint16_t inside[CONFIG_GEOFENCE_MAX_ZONES];         // zones the last fix was inside
+    uint16_t num_zones;
+    uint16_t num_vertices;
+    uint16_t num_entries;
+    uint16_t num_wide;
+    uint16_t num_inside;
+    uint16_t stamp;
+    geofence_handler_t handler;
+    void* user_data;
+    struct geofence_stats stats;
+};
+
+/**
+ * @brief Empties `gf` and sets the transition handler.
+ * @param handler called on every enter and exit, may be NULL
+ */
+void geofence_init(struct geofence* gf, geofence_handler_t handler, void* user_data);
+
+/**
+ * @brief Adds a circular zone.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EINVAL if the center is out of range or the radius is 0.
+ * @retval -ENOMEM if the zone or grid tables are full.
+ */
+int geofence_add_circle(struct geofence* gf, uint16_t id, struct geofence_point center, uint32_t radius_m);
+
+/**
+ * @brief Adds a polygon zone, the points are copied. The polygon closes itself, do not
+ * repeat the first point, and must not cross the antimeridian.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EINVAL if there are fewer than 3 points or a point is out of range.
+ * @retval -ENOMEM if the zone, vertex or grid tables are full.
+ */
+int geofence_add_polygon(struct geofence* gf, uint16_t id, const struct geofence_point* points, uint16_t num_points);
+
+/**
+ * @brief Adds every zone of a compiled in table, stops at the first one that fails.
+ * @returns number of zones added on success, `errno < 0` on failure.
+ */
+int geofence_load_table(struct geofence* gf, const struct geofence_zone_def* defs, size_t num_defs);
+
+/**
+ * @brief Adds the zone described by one line of a zone file. Decimal degrees, meters:
+ *      `C,<id>,<lat>,<lon>,<radius>` for a circle,
+ *      `P,<id>,<lat>,<lon>,<lat>,<lon>,<lat>,<lon>[,...]` for a polygon.
+ * Blank lines and lines starting with '#' are skipped.
+ * @returns 1 if a zone was added, 0 if the line was skipped, `errno < 0` on failure.
+ * @retval -EINVAL if the line is malformed.
+ * @retval -ENOMEM if the zone, vertex or grid tables are full.
+ */
+int geofence_parse_line(struct geofence* gf, const char* line);
+
+/**
+ * @brief Evaluates a new fix and calls the handler for each zone entered or left since the
+ * last one. Fixes without a valid position are ignored.
+ * @returns number of transitions.
+ */
+int geofence_update(struct geofence* gf, const struct ufirebirdii_fix* fix);
+
+/// @returns true if the last evaluated fix was inside zone `id`
+bool geofence_is_inside(const struct geofence* gf, uint16_t id);
+
+#endif // GEOFENCE_H
@@ -0,0 +1,49 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+
+/// Q15 gain that passes samples through untouched, 1.0 is not representable so 0x7FFF stands in for it
+#define MIXER_GAIN_UNITY INT16_MAX
+/// Q15 gain that silences a voice
+#define MIXER_GAIN_MUTE 0
+
+/// @returns the product of two Q15 gains, `MIXER_GAIN_UNITY` is exact
+static inline int16_t mixer_gain_mul(int16_t a, int16_t b) {
+    if (a == MIXER_GAIN_UNITY)
+        return b;
+    if (b == MIXER_GAIN_UNITY)
+        return a;
+    return (int16_t)(((int32_t)a * b + (1 << 14)) >> 15);
+}
+
+/// @returns `percent` of unity as a Q15 gain
+static inline int16_t mixer_gain_percent(uint32_t percent) {
+    return percent >= 100 ? MIXER_GAIN_UNITY : (int16_t)((percent * 32768 + 50) / 100);
+}
+
+/**
+ * @brief Scales `n` samples in place by the Q15 `gain`, rounding to nearest. The first voice of
+ *      a mix goes through this, the rest are added on with `mixer_add`.
+ */
+void mixer_scale(int16_t* buf, uint32_t n, int16_t gain);
+
+/**
+ * @brief Adds `n` samples of `in` scaled by the Q15 `gain` to `acc`, saturating each sum to
+ *      16 bits. The loop has no branches or dependencies between samples, so it vectorizes.
+ */
+void mixer_add(int16_t* acc, const int16_t* in, uint32_t n, int16_t gain);
+
+/**
+ * @brief Like `mixer_scale`, with the gain ramped linearly from `from` to `to` over the block,
+ *      so a gain change does not click.
+ */
+void mixer_scale_ramp(int16_t* buf, uint32_t n, int16_t from, int16_t to);
+
+/// @brief Like `mixer_add`, with the gain ramped linearly from `from` to `to` over the block.
+void mixer_add_ramp(int16_t* acc, const int16_t* in, uint32_t n, int16_t from, int16_t to);
+
+#endif // MIXER_H
@@ -0,0 +1,75 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef PCM_H
+#define PCM_H
+
+#include <stdint.h>
+
+/// Filter taps per output sample, the kernel spans half as many zero crossings either side
+#define PCM_RESAMPLER_TAPS 16
+/// Fractional positions between two input frames the filter bank is computed for, outputs in between are interpolated
+#define PCM_RESAMPLER_PHASES 32
+/// Highest input rate accepted, as a multiple of the output rate
+#define PCM_RESAMPLER_MAX_RATIO 4
+
+/// Polyphase resampler for 16 bit stereo, one per stream
+struct pcm_resampler {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t frac;      // the next output sits frac / out_rate input frames past the filter centre, an input frame is due at out_rate
+    uint32_t head;      // where the next input frame goes in `hist`
+    int16_t hist[2][2 * PCM_RESAMPLER_TAPS];    // each frame is stored twice, so the last TAPS of a channel are contiguous
+    int16_t bank[PCM_RESAMPLER_PHASES + 1][PCM_RESAMPLER_TAPS]; // Q15, each phase sums to unity
+};
+
+/// IMA/DVI ADPCM decoder state, carried between calls within one block
+struct pcm_ima {
+    uint32_t pos;           // next frame of the block, 0 starts it over from its header
+    int32_t predictor[2];
+    int32_t index[2];       // into the step size table
+};
+
+/**
+ * @brief Converts `frames` frames of little endian `bits` bit PCM with `channels` channels to
+ *      16 bit stereo. 8 bit is unsigned, the rest signed, and 24 and 32 bit are truncated to
+ *      their top 16 bits. Mono is copied to both sides, channels past the second are dropped.
+ * @param out `2 * frames` samples
+ * @param in `frames * channels * bits / 8` bytes
+ */
+void pcm_to_s16_stereo(int16_t* out, const uint8_t* in, uint32_t frames, uint16_t bits, uint16_t channels);
+
+/**
+ * @brief Sets `rs` up to resample from `in_rate` to `out_rate`, with an empty history. The
+ *      filter is a Kaiser windowed sinc, cut off at the lower of the two Nyquist rates.
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -EINVAL if a rate is 0 or `in_rate` is above `PCM_RESAMPLER_MAX_RATIO` times `out_rate`.
+ */
+int pcm_resampler_init(struct pcm_resampler* rs, uint32_t in_rate, uint32_t out_rate);
+
+/// @returns the input frames `pcm_resample` takes to make the next `out_frames` frames
+uint32_t pcm_resampler_demand(const struct pcm_resampler* rs, uint32_t out_frames);
+
+/**
+ * @brief Resamples 16 bit stereo, until `out_frames` frames are made or the next one needs
+ *      more than the `in_frames` frames given. Input is taken only as it is needed, so given
+ *      `pcm_resampler_demand(rs, out_frames)` frames or fewer, all of it is taken.
+ * @returns the frames written to `out`
+ */
+uint32_t pcm_resample(struct pcm_resampler* rs, int16_t* out, uint32_t out_frames, const int16_t* in, uint32_t in_frames);
+
+/**
+ * @returns the frames in a WAV IMA ADPCM block of `len` bytes with `channels` channels: the
+ *      header sample, then 8 per 4 bytes of each channel. 0 if it does not hold the headers.
+ */
+uint32_t pcm_ima_block_frames(uint32_t len, uint16_t channels);
+
+/**
+ * @brief Decodes the next `frames` frames of the WAV IMA ADPCM block `block`, mono or stereo,
+ *      to 16 bit stereo. A block may be decoded in any number of calls, `st->pos` set to 0
+ *      starts the next one.
+ * @param out `2 * frames` samples
+ */
+void pcm_ima_decode(struct pcm_ima* st, int16_t* out, const uint8_t* block, uint32_t frames, uint16_t channels);
+
+#endif // PCM_H
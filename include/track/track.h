@@ -0,0 +1,115 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <zephyr/kernel.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+/// Longest encoded record, three 32 bit varints
+#define TRACK_RECORD_MAX 15
+
+/// A stored track point, latitude and longitude in CONFIG_TRACK_RESOLUTION steps
+struct track_point {
+    int32_t lat;    // degrees * UFBII_COORD_SCALE / CONFIG_TRACK_RESOLUTION
+    int32_t lon;
+    uint32_t time;  // unix seconds
+};
+
+struct track_stats {
+    uint32_t fixes;     // fixes offered to the track
+    uint32_t points;    // points stored after simplification
+    uint32_t evicted;   // oldest points dropped to make room
+};
+
+/**
+ * Online simplifier state. Points within `max_error_m` of the anchor (the last stored point)
+ * are a dead band. Beyond it, every point narrows the cone of directions from the anchor that
+ * pass within `max_error_m` of it. Points must also keep moving away along the cone, or one
+ * coming back would leave the far end of the segment behind. The point before the first one
+ * that breaks either rule is stored and becomes the anchor, so every dropped point lies within
+ * `max_error_m` of the track.
+ */
+struct track_simplifier {
+    struct track_point pending;     // latest point inside the cone, stored when the cone breaks
+    bool has_pending;
+    bool cone_open;                 // no point has left the dead band since the anchor
+    float cone_ref;                 // direction of the first point out of the dead band, radians
+    float cone_lo, cone_hi;         // directions still allowed, relative to cone_ref
+    float cone_far;                 // farthest any point has got along cone_ref, meters
+    float m_per_lat;                // meters per latitude step
+    float m_per_lon;                // meters per longitude step at the anchor's latitude
+};
+
+/**
+ * Position history. The oldest point is kept absolute in `base`, every later one as zig-zag
+ * varint deltas (latitude, longitude, seconds) from the point before it in a byte ring.
+ * When the ring is full the oldest delta is folded into `base`.
+ */
+struct track {
+    struct k_mutex lock;
+    struct track_point base;        // oldest stored point
+    struct track_point newest;      // newest stored point, the anchor of the simplifier
+    uint32_t count;                 // stored points, including base
+    uint32_t head;                  // ring index of the oldest record
+    uint32_t used;                  // ring bytes holding records
+    uint32_t max_error_m;
+    struct track_simplifier simp;
+    struct track_stats stats;
+    uint8_t ring[CONFIG_TRACK_BUFFER_SIZE];
+};
+
+/**
+ * @brief Empties the track.
+ * @param max_error_m how far a dropped fix may be from the stored track, in meters,
+ *      on top of the CONFIG_TRACK_RESOLUTION quantization
+ */
+void track_init(struct track* track, uint32_t max_error_m);
+
+/**
+ * @brief Offers a fix to the track. Fixes without a valid position, date and time are ignored.
+ * @returns 1 if a point was stored, 0 otherwise.
+ */
+int track_add_fix(struct track* track, const struct ufirebirdii_fix* fix);
+
+/**
+ * @brief Stores the point the simplifier is holding back, so the newest position is in the
+ * history before it is encoded.
+ * @returns 1 if a point was stored, 0 if there was none pending.
+ */
+int track_flush(struct track* track);
+
+/**
+ * @brief Encodes stored points into `buf`, starting `skip` points after the oldest, for
+ * sending over a small link. Every buffer decodes on its own: the first point is absolute
+ * (zig-zag varint latitude and longitude, varint time), the rest are records. Only whole
+ * points are written, call again with `skip` advanced by `*points` for the next buffer.
+ * @param points set to the number of points written
+ * @returns bytes written, `errno < 0` on failure.
+ * @retval -ENOENT if there are no points past `skip`.
+ * @retval -ENOMEM if `buf` cannot hold even one point.
+ */
+int track_encode(struct track* track, uint32_t skip, uint8_t* buf, size_t len, uint32_t* points);
+
+/**
+ * @brief Decodes the next point of a `track_encode` buffer.
+ * @param pos read position, start at the buffer and keep passing it back
+ * @param point the previous point, replaced with the next one. Ignored for the first point.
+ * @param first true for the first point of a buffer
+ * @returns 0 on success, `errno < 0` on failure.
+ * @retval -ENOENT at the end of the buffer.
+ * @retval -EBADMSG if the buffer is truncated or corrupt.
+ */
+int track_decode(const uint8_t** pos, const uint8_t* end, struct track_point* point, bool first);
+
+/// @returns bytes the stored points take, base included
+static inline uint32_t track_bytes_used(const struct track* track) {
+    return track->used + sizeof(track->base);
+}
+
+#endif // TRACK_H
@@ -0,0 +1,408 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <geofence/geofence.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(geofence);
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_GEOFENCE_GRID_BUCKETS), "CONFIG_GEOFENCE_GRID_BUCKETS must be a power of two");
+BUILD_ASSERT(CONFIG_GEOFENCE_MAX_ZONES < GEOFENCE_NONE && CONFIG_GEOFENCE_MAX_VERTICES < GEOFENCE_NONE &&
+    CONFIG_GEOFENCE_MAX_CELL_ENTRIES < GEOFENCE_NONE, "geofence tables are indexed with uint16_t");
+
+// mean meridian degree, close enough for zones of a few km that only need to be consistent
+#define GEOFENCE_M_PER_DEG 111195
+#define GEOFENCE_LAT_MAX (90 * UFBII_COORD_SCALE)
+#define GEOFENCE_LON_MAX (180 * UFBII_COORD_SCALE)
+// grid cells are square in degrees, so they narrow towards the poles, which only costs a few more entries
+#define GEOFENCE_CELL ((int32_t)(((int64_t)CONFIG_GEOFENCE_CELL_SIZE_M * UFBII_COORD_SCALE) / GEOFENCE_M_PER_DEG))
+// cos(latitude) in Q16 is clamped here, about 89.4 degrees, so a circle's longitude span stays finite
+#define GEOFENCE_LON_SCALE_MIN 655
+
+void geofence_init(struct geofence* gf, geofence_handler_t handler, void* user_data) {
+    memset(gf, 0, sizeof(*gf));
+    for (int i = 0; i < ARRAY_SIZE(gf->buckets); i++)
+        gf->buckets[i] = GEOFENCE_NONE;
+    gf->handler = handler;
+    gf->user_data = user_data;
+}
+
+static inline bool point_valid(struct geofence_point p) {
+    return p.lat >= -GEOFENCE_LAT_MAX && p.lat <= GEOFENCE_LAT_MAX &&
+        p.lon >= -GEOFENCE_LON_MAX && p.lon <= GEOFENCE_LON_MAX;
+}
+
+// floor division, so cells either side of the equator and prime meridian do not merge
+static inline int32_t cell_of(int32_t v) {
+    return v >= 0 ? v / GEOFENCE_CELL : -(int32_t)((-(int64_t)v + GEOFENCE_CELL - 1) / GEOFENCE_CELL);
+}
+
+static inline uint32_t bucket_of(int32_t cell_lat, int32_t cell_lon) {
+    uint32_t h = ((uint32_t)cell_lat * 0x9E3779B1u) ^ ((uint32_t)cell_lon * 0x85EBCA77u);
+    h ^= h >> 16;
+    return h & (CONFIG_GEOFENCE_GRID_BUCKETS - 1);
+}
+
+// files the zone under every cell its bounding box covers, or on the wide list if that is too many
+static int grid_insert(struct geofence* gf, uint16_t idx) {
+    const struct geofence_zone* zone = &gf->zones[idx];
+    int32_t lat0 = cell_of(zone->min_lat), lat1 = cell_of(zone->max_lat);
+    int32_t lon0 = cell_of(zone->min_lon), lon1 = cell_of(zone->max_lon);
+    int64_t cells = (int64_t)(lat1 - lat0 + 1) * (lon1 - lon0 + 1);
+
+    if (cells > CONFIG_GEOFENCE_MAX_CELLS_PER_ZONE) {
+        LOG_DBG("Zone %u spans %lld cells, tested on every update", zone->id, (long long)cells);
+        gf->wide[gf->num_wide++] = idx;
+        return 0;
+    }
+
+    if (gf->num_entries + cells > ARRAY_SIZE(gf->entries))
+        return -ENOMEM;
+
+    for (int32_t lat = lat0; lat <= lat1; lat++) {
+        for (int32_t lon = lon0; lon <= lon1; lon++) {
+            uint32_t bucket = bucket_of(lat, lon);
+            struct geofence_cell_entry* entry = &gf->entries[gf->num_entries];
+
+            entry->zone = idx;
+            entry->next = gf->buckets[bucket];
+            gf->buckets[bucket] = gf->num_entries++;
+        }
+    }
+
+    return 0;
+}
+
+// zones[num_zones] is filled in, make it count if it fits in the grid
+static int zone_commit(struct geofence* gf) {
+    int ret = grid_insert(gf, gf->num_zones);
+    if (ret < 0)
+        return ret;
+
+    gf->num_zones++;
+    return 0;
+}
+
+int geofence_add_circle(struct geofence* gf, uint16_t id, struct geofence_point center, uint32_t radius_m) {
+    if (!point_valid(center) || radius_m == 0)
+        return -EINVAL;
+    if (gf->num_zones >= ARRAY_SIZE(gf->zones))
+        return -ENOMEM;
+
+    struct geofence_zone* zone = &gf->zones[gf->num_zones];
+    int64_t radius = ((int64_t)radius_m * UFBII_COORD_SCALE) / GEOFENCE_M_PER_DEG;
+    float lat_rad = (float)center.lat / UFBII_COORD_SCALE * (float)M_PI / 180.0f;
+    uint32_t lon_scale = MAX((uint32_t)(cosf(lat_rad) * 65536.0f), GEOFENCE_LON_SCALE_MIN);
+    int64_t lon_radius = (radius << 16) / lon_scale;
+
+    memset(zone, 0, sizeof(*zone));
+    zone->id = id;
+    zone->shape = GEOFENCE_CIRCLE;
+    zone->circle.center = center;
+    zone->circle.lon_scale = lon_scale;
+    zone->circle.radius_sq = (uint64_t)(radius * radius);
+    zone->min_lat = (int32_t)MAX(center.lat - radius, -GEOFENCE_LAT_MAX);
+    zone->max_lat = (int32_t)MIN(center.lat + radius, GEOFENCE_LAT_MAX);
+    zone->min_lon = (int32_t)MAX(center.lon - lon_radius, -GEOFENCE_LON_MAX);
+    zone->max_lon = (int32_t)MIN(center.lon + lon_radius, GEOFENCE_LON_MAX);
+
+    return zone_commit(gf);
+}
+
+// the corners are already at the tail of the vertex pool, only committed if the zone is
+static int add_polygon_at_tail(struct geofence* gf, uint16_t id, uint16_t num_points) {
+    const struct geofence_point* points = &gf->vertices[gf->num_vertices];
+
+    if (num_points < 3)
+        return -EINVAL;
+    if (gf->num_zones >= ARRAY_SIZE(gf->zones))
+        return -ENOMEM;
+
+    struct geofence_zone* zone = &gf->zones[gf->num_zones];
+    memset(zone, 0, sizeof(*zone));
+    zone->id = id;
+    zone->shape = GEOFENCE_POLYGON;
+    zone->polygon.first = gf->num_vertices;
+    zone->polygon.count = num_points;
+    zone->min_lat = zone->max_lat = points[0].lat;
+    zone->min_lon = zone->max_lon = points[0].lon;
+
+    for (uint16_t i = 0; i < num_points; i++) {
+        if (!point_valid(points[i]))
+            return -EINVAL;
+
+        zone->min_lat = MIN(zone->min_lat, points[i].lat);
+        zone->max_lat = MAX(zone->max_lat, points[i].lat);
+        zone->min_lon = MIN(zone->min_lon, points[i].lon);
+        zone->max_lon = MAX(zone->max_lon, points[i].lon);
+    }
+
+    // a polygon this wide almost certainly wraps the antimeridian, which the tests do not handle
+    if ((int64_t)zone->max_lon - zone->min_lon > GEOFENCE_LON_MAX)
+        return -EINVAL;
+
+    int ret = zone_commit(gf);
+    if (ret < 0)
+        return ret;
+
+    gf->num_vertices += num_points;
+    return 0;
+}
+
+int geofence_add_polygon(struct geofence* gf, uint16_t id, const struct geofence_point* points, uint16_t num_points) {
+    if (num_points > ARRAY_SIZE(gf->vertices) - gf->num_vertices)
+        return -ENOMEM;
+
+    memcpy(&gf->vertices[gf->num_vertices], points, num_points * sizeof(*points));
+    return add_polygon_at_tail(gf, id, num_points);
+}
+
+int geofence_load_table(struct geofence* gf, const struct geofence_zone_def* defs, size_t num_defs) {
+    for (size_t i = 0; i < num_defs; i++) {
+        const struct geofence_zone_def* def = &defs[i];
+        int ret;
+
+        if (def->shape == GEOFENCE_CIRCLE)
+            ret = def->num_points == 1 ? geofence_add_circle(gf, def->id, def->points[0], def->radius_m) : -EINVAL;
+        else
+            ret = geofence_add_polygon(gf, def->id, def->points, def->num_points);
+
+        if (ret < 0)
+            return ret;
+    }
+
+    return (int)num_defs;
+}
+
+// Zone file parsing
+
+static int parse_uint(const char** s, uint32_t* out) {
+    const char* p = *s;
+    uint64_t val = 0;
+
+    if (*p < '0' || *p > '9')
+        return -EINVAL;
+
+    while (*p >= '0' && *p <= '9') {
+        val = val * 10 + (*p++ - '0');
+        if (val > UINT32_MAX)
+            return -EINVAL;
+    }
+
+    *s = p;
+    *out = (uint32_t)val;
+    return 0;
+}
+
+// decimal degrees to degrees * UFBII_COORD_SCALE, digits past the scale are dropped
+static int parse_coord(const char** s, int32_t* out) {
+    const char* p = *s;
+    bool negative = false;
+    uint32_t whole;
+    int64_t frac = 0;
+    int64_t scale = UFBII_COORD_SCALE;
+
+    if (*p == '-' || *p == '+')
+        negative = *p++ == '-';
+
+    int ret = parse_uint(&p, &whole);
+    if (ret < 0 || whole > 180)
+        return -EINVAL;
+
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (scale > 1) {
+                scale /= 10;
+                frac += (*p - '0') * scale;
+            }
+            p++;
+        }
+    }
+
+    int64_t val = (int64_t)whole * UFBII_COORD_SCALE + frac;
+    *s = p;
+    *out = (int32_t)(negative ? -val : val);
+    return 0;
+}
+
+static inline bool parse_sep(const char** s) {
+    if (**s != ',')
+        return false;
+    (*s)++;
+    return true;
+}
+
+static inline bool at_line_end(const char* s) {
+    while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+        s++;
+    return *s == '\0';
+}
+
+int geofence_parse_line(struct geofence* gf, const char* line) {
+    const char* p = line;
+    uint32_t id;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == '#' || at_line_end(p))
+        return 0;
+
+    char shape = *p++;
+    if (!parse_sep(&p) || parse_uint(&p, &id) < 0 || id >= GEOFENCE_NONE || !parse_sep(&p))
+        return -EINVAL;
+
+    if (shape == 'C') {
+        struct geofence_point center;
+        uint32_t radius_m;
+
+        if (parse_coord(&p, &center.lat) < 0 || !parse_sep(&p) || parse_coord(&p, &center.lon) < 0 ||
+                !parse_sep(&p) || parse_uint(&p, &radius_m) < 0 || !at_line_end(p))
+            return -EINVAL;
+
+        int ret = geofence_add_circle(gf, (uint16_t)id, center, radius_m);
+        return ret < 0 ? ret : 1;
+    }
+
+    if (shape != 'P')
+        return -EINVAL;
+
+    // corners go straight into the free end of the vertex pool
+    uint16_t count = 0;
+    do {
+        if (gf->num_vertices + count >= ARRAY_SIZE(gf->vertices))
+            return -ENOMEM;
+
+        struct geofence_point* point = &gf->vertices[gf->num_vertices + count];
+        if (parse_coord(&p, &point->lat) < 0 || !parse_sep(&p) || parse_coord(&p, &point->lon) < 0)
+            return -EINVAL;
+        count++;
+    } while (parse_sep(&p));
+
+    if (!at_line_end(p))
+        return -EINVAL;
+
+    int ret = add_polygon_at_tail(gf, (uint16_t)id, count);
+    return ret < 0 ? ret : 1;
+}
+
+// Evaluation
+
+// crossing number test, exact in integers, a point on an edge may land either side
+static bool polygon_contains(const struct geofence* gf, const struct geofence_zone* zone, struct geofence_point p) {
+    const struct geofence_point* v = &gf->vertices[zone->polygon.first];
+    uint16_t n = zone->polygon.count;
+    bool inside = false;
+
+    for (uint16_t i = 0, j = n - 1; i < n; j = i++) {
+        if ((v[i].lat > p.lat) == (v[j].lat > p.lat))
+            continue;
+
+        // does the edge cross the parallel through p east of p
+        int64_t dlat = (int64_t)v[j].lat - v[i].lat;
+        int64_t edge = ((int64_t)p.lat - v[i].lat) * ((int64_t)v[j].lon - v[i].lon);
+        int64_t point = ((int64_t)p.lon - v[i].lon) * dlat;
+
+        if (dlat > 0 ? point < edge : point > edge)
+            inside = !inside;
+    }
+
+    return inside;
+}
+
+static bool zone_contains(struct geofence* gf, const struct geofence_zone* zone, struct geofence_point p) {
+    if (p.lat < zone->min_lat || p.lat > zone->max_lat || p.lon < zone->min_lon || p.lon > zone->max_lon)
+        return false;
+
+    gf->stats.exact_tests++;
+
+    if (zone->shape == GEOFENCE_POLYGON)
+        return polygon_contains(gf, zone, p);
+
+    // the bounding box keeps both deltas small enough to square
+    int64_t dlat = (int64_t)p.lat - zone->circle.center.lat;
+    int64_t dlon = (((int64_t)p.lon - zone->circle.center.lon) * zone->circle.lon_scale) >> 16;
+    return (uint64_t)(dlat * dlat) + (uint64_t)(dlon * dlon) <= zone->circle.radius_sq;
+}
+
+static void emit(struct geofence* gf, const struct geofence_zone* zone, enum geofence_event event, const struct ufirebirdii_fix* fix) {
+    gf->stats.transitions++;
+    if (gf->handler != NULL)
+        gf->handler(gf, zone->id, event, fix, gf->user_data);
+}
+
+// tests a zone from the grid or wide list once per update, only an enter can come of it
+static int check_candidate(struct geofence* gf, uint16_t idx, struct geofence_point p, const struct ufirebirdii_fix* fix) {
+    struct geofence_zone* zone = &gf->zones[idx];
+
+    if (zone->stamp == gf->stamp)
+        return 0;
+    zone->stamp = gf->stamp;
+    gf->stats.candidates++;
+
+    if (!zone_contains(gf, zone, p))
+        return 0;
+
+    zone->inside = true;
+    gf->inside[gf->num_inside++] = idx;
+    emit(gf, zone, GEOFENCE_ENTER, fix);
+    return 1;
+}
+
+int geofence_update(struct geofence* gf, const struct ufirebirdii_fix* fix) {
+    if (!fix->valid || !(fix->fields & UFBII_FIX_HAS_POSITION))
+        return 0;
+
+    struct geofence_point p = {.lat = fix->latitude, .lon = fix->longitude};
+    int transitions = 0;
+
+    gf->stats.evaluations++;
+    if (++gf->stamp == 0) {
+        // wrapped, old stamps could now match
+        for (uint16_t i = 0; i < gf->num_zones; i++)
+            gf->zones[i].stamp = 0;
+        gf->stamp = 1;
+    }
+
+    // the zones the last fix was inside are the only ones that can be left, whatever cell p is in now
+    for (uint16_t i = 0; i < gf->num_inside;) {
+        struct geofence_zone* zone = &gf->zones[gf->inside[i]];
+
+        zone->stamp = gf->stamp;
+        gf->stats.candidates++;
+
+        if (zone_contains(gf, zone, p)) {
+            i++;
+            continue;
+        }
+
+        zone->inside = false;
+        gf->inside[i] = gf->inside[--gf->num_inside];
+        emit(gf, zone, GEOFENCE_EXIT, fix);
+        transitions++;
+    }
+
+    uint32_t bucket = bucket_of(cell_of(p.lat), cell_of(p.lon));
+    for (uint16_t e = gf->buckets[bucket]; e != GEOFENCE_NONE; e = gf->entries[e].next)
+        transitions += check_candidate(gf, gf->entries[e].zone, p, fix);
+
+    for (uint16_t i = 0; i < gf->num_wide; i++)
+        transitions += check_candidate(gf, gf->wide[i], p, fix);
+
+    return transitions;
+}
+
+bool geofence_is_inside(const struct geofence* gf, uint16_t id) {
+    for (uint16_t i = 0; i < gf->num_inside; i++) {
+        if (gf->zones[gf->inside[i]].id == id)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <mixer/mixer.h>
+
+static inline int16_t mixer_sat16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+void mixer_scale(int16_t* buf, uint32_t n, int16_t gain) {
+    if (gain == MIXER_GAIN_UNITY)
+        return;
+
+    for (uint32_t i = 0; i < n; i++)
+        buf[i] = (int16_t)(((int32_t)buf[i] * gain + (1 << 14)) >> 15);
+}
+
+void mixer_add(int16_t* restrict acc, const int16_t* restrict in, uint32_t n, int16_t gain) {
+    if (gain == MIXER_GAIN_UNITY) {
+        for (uint32_t i = 0; i < n; i++)
+            acc[i] = mixer_sat16((int32_t)acc[i] + in[i]);
+        return;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+        acc[i] = mixer_sat16((int32_t)acc[i] + (((int32_t)in[i] * gain + (1 << 14)) >> 15));
+}
+
+// the gain steps in Q31 so a whole block of samples ramps without a division per sample
+void mixer_scale_ramp(int16_t* buf, uint32_t n, int16_t from, int16_t to) {
+    if (from == to || n == 0) {
+        mixer_scale(buf, n, to);
+        return;
+    }
+
+    int32_t step = (int32_t)((((int64_t)to - from) << 16) / (int32_t)n);
+    int32_t g = (int32_t)from << 16;
+
+    for (uint32_t i = 0; i < n; i++, g += step)
+        buf[i] = (int16_t)(((int64_t)buf[i] * g + (1 << 30)) >> 31);
+}
+
+void mixer_add_ramp(int16_t* restrict acc, const int16_t* restrict in, uint32_t n, int16_t from, int16_t to) {
+    if (from == to || n == 0) {
+        mixer_add(acc, in, n, to);
+        return;
+    }
+
+    int32_t step = (int32_t)((((int64_t)to - from) << 16) / (int32_t)n);
+    int32_t g = (int32_t)from << 16;
+
+    for (uint32_t i = 0; i < n; i++, g += step)
+        acc[i] = mixer_sat16((int32_t)acc[i] + (int32_t)(((int64_t)in[i] * g + (1 << 30)) >> 31));
+}
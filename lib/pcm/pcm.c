@@ -0,0 +1,225 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcm/pcm.h>
+
+#define PCM_SINC_ZEROS (PCM_RESAMPLER_TAPS / 2)
+#define PCM_SINC_STEPS 32
+
+/*
+ * sinc(x) * kaiser(x / PCM_SINC_ZEROS, beta 6) for x = 0 to PCM_SINC_ZEROS zero crossings in
+ * 1/PCM_SINC_STEPS steps, Q15. The filter banks are interpolated out of it.
+ */
+static const int16_t pcm_sinc[PCM_SINC_ZEROS * PCM_SINC_STEPS + 1] = {
+    32767, 32713, 32551, 32283, 31910, 31434, 30858, 30186, 29422, 28570, 27636, 26624,
+    25542, 24396, 23191, 21936, 20638, 19304, 17941, 16558, 15162, 13761, 12361, 10972,
+    9599, 8251, 6933, 5652, 4414, 3225, 2090, 1014, 0, -947, -1824, -2630,
+    -3360, -4015, -4593, -5093, -5517, -5864, -6135, -6334, -6460, -6518, -6510, -6440,
+    -6311, -6127, -5893, -5612, -5291, -4933, -4544, -4129, -3692, -3238, -2773, -2302,
+    -1828, -1357, -893, -439, 0, 421, 820, 1195, 1544, 1863, 2151, 2407,
+    2629, 2817, 2970, 3088, 3172, 3221, 3237, 3221, 3174, 3098, 2994, 2865,
+    2714, 2541, 2350, 2143, 1923, 1693, 1454, 1211, 964, 718, 473, 233,
+    0, -225, -439, -640, -828, -1001, -1158, -1297, -1419, -1521, -1606, -1671,
+    -1717, -1745, -1755, -1747, -1722, -1681, -1625, -1555, -1473, -1379, -1275, -1162,
+    -1043, -917, -788, -655, -522, -388, -256, -126, 0, 121, 236, 344,
+    445, 537, 620, 694, 757, 811, 855, 888, 911, 924, 928, 922,
+    907, 883, 852, 814, 769, 718, 663, 603, 540, 474, 406, 337,
+    267, 198, 130, 64, 0, -61, -119, -173, -223, -268, -308, -344,
+    -374, -399, -419, -434, -444, -448, -448, -444, -435, -422, -406, -386,
+    -363, -338, -310, -281, -250, -219, -186, -154, -122, -90, -59, -29,
+    0, 27, 52, 76, 97, 116, 133, 147, 159, 169, 176, 181,
+    184, 185, 184, 181, 176, 169, 162, 152, 142, 131, 120, 108,
+    95, 82, 70, 57, 45, 33, 21, 10, 0, -9, -18, -26,
+    -33, -39, -44, -48, -51, -54, -55, -56, -56, -55, -54, -52,
+    -50, -48, -45, -41, -38, -34, -30, -27, -23, -20, -16, -13,
+    -10, -7, -4, -2, 0,
+};
+
+static const int8_t pcm_ima_index[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t pcm_ima_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static inline int16_t pcm_sat16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+void pcm_to_s16_stereo(int16_t* out, const uint8_t* in, uint32_t frames, uint16_t bits, uint16_t channels) {
+    uint32_t bytes = bits / 8;
+    uint32_t stride = bytes * channels;
+    uint32_t right = channels > 1 ? bytes : 0;
+
+    if (bits == 8) {
+        for (uint32_t i = 0; i < frames; i++, in += stride, out += 2) {
+            out[0] = (int16_t)((in[0] - 128) << 8);
+            out[1] = (int16_t)((in[right] - 128) << 8);
+        }
+        return;
+    }
+
+    // the top 16 bits of a little endian sample are its last two bytes
+    in += bytes - 2;
+    for (uint32_t i = 0; i < frames; i++, in += stride, out += 2) {
+        out[0] = (int16_t)(in[0] | (in[1] << 8));
+        out[1] = (int16_t)(in[right] | (in[right + 1] << 8));
+    }
+}
+
+// the prototype at `x` zero crossings, Q16, linearly interpolated
+static int32_t pcm_sinc_at(uint32_t x) {
+    uint32_t pos = x * PCM_SINC_STEPS;
+    uint32_t i = pos >> 16;
+    if (i >= PCM_SINC_ZEROS * PCM_SINC_STEPS)
+        return 0;
+
+    int32_t a = pcm_sinc[i];
+    int32_t b = pcm_sinc[i + 1];
+    return a + (int32_t)(((int64_t)(b - a) * (pos & 0xFFFF)) >> 16);
+}
+
+int pcm_resampler_init(struct pcm_resampler* rs, uint32_t in_rate, uint32_t out_rate) {
+    if (in_rate == 0 || out_rate == 0 || in_rate > PCM_RESAMPLER_MAX_RATIO * out_rate)
+        return -EINVAL;
+
+    memset(rs, 0, sizeof(*rs));
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+
+    // going down in rate, the kernel is stretched to cut off at the output Nyquist rate instead
+    uint32_t scale = in_rate > out_rate ? (uint32_t)(((uint64_t)out_rate << 16) / in_rate) : 1 << 16;
+
+    // the extra phase is a whole frame on, the last one interpolates towards it
+    for (uint32_t p = 0; p <= PCM_RESAMPLER_PHASES; p++) {
+        int32_t coef[PCM_RESAMPLER_TAPS];
+        int32_t sum = 0;
+
+        for (int32_t t = 0; t < PCM_RESAMPLER_TAPS; t++) {
+            // distance of the tap from the output, in input frames, Q16
+            int32_t d = ((t - (PCM_RESAMPLER_TAPS / 2 - 1)) << 16) - (int32_t)((p << 16) / PCM_RESAMPLER_PHASES);
+            coef[t] = pcm_sinc_at((uint32_t)(((uint64_t)abs(d) * scale) >> 16));
+            sum += coef[t];
+        }
+
+        // unity at DC, whatever the stretch and the phase, the negative lobes rounded away from 0 too
+        for (uint32_t t = 0; t < PCM_RESAMPLER_TAPS; t++) {
+            int64_t scaled = (int64_t)coef[t] * 32768;
+            rs->bank[p][t] = pcm_sat16((int32_t)((scaled + (scaled < 0 ? -sum / 2 : sum / 2)) / sum));
+        }
+    }
+
+    return 0;
+}
+
+uint32_t pcm_resampler_demand(const struct pcm_resampler* rs, uint32_t out_frames) {
+    if (out_frames == 0)
+        return 0;
+    return (uint32_t)((rs->frac + (uint64_t)(out_frames - 1) * rs->in_rate) / rs->out_rate);
+}
+
+uint32_t pcm_resample(struct pcm_resampler* rs, int16_t* out, uint32_t out_frames, const int16_t* in, uint32_t in_frames) {
+    uint32_t made = 0;
+
+    while (made < out_frames) {
+        while (rs->frac >= rs->out_rate) {
+            if (in_frames == 0)
+                return made;
+
+            rs->hist[0][rs->head] = rs->hist[0][rs->head + PCM_RESAMPLER_TAPS] = in[0];
+            rs->hist[1][rs->head] = rs->hist[1][rs->head + PCM_RESAMPLER_TAPS] = in[1];
+            rs->head = (rs->head + 1) % PCM_RESAMPLER_TAPS;
+            in += 2;
+            in_frames--;
+            rs->frac -= rs->out_rate;
+        }
+
+        // the output falls between two phases of the bank, Q15 of the way from one to the next
+        uint32_t pos = (uint32_t)(((uint64_t)rs->frac * PCM_RESAMPLER_PHASES << 15) / rs->out_rate);
+        const int16_t* c0 = rs->bank[pos >> 15];
+        const int16_t* c1 = rs->bank[(pos >> 15) + 1];
+        int32_t w = pos & 0x7FFF;
+        const int16_t* l = &rs->hist[0][rs->head];
+        const int16_t* r = &rs->hist[1][rs->head];
+        int32_t acc_l = 1 << 14;
+        int32_t acc_r = 1 << 14;
+
+        for (uint32_t t = 0; t < PCM_RESAMPLER_TAPS; t++) {
+            int32_t c = c0[t] + (((c1[t] - c0[t]) * w) >> 15);
+            acc_l += c * l[t];
+            acc_r += c * r[t];
+        }
+
+        out[0] = pcm_sat16(acc_l >> 15);
+        out[1] = pcm_sat16(acc_r >> 15);
+        out += 2;
+        made++;
+        rs->frac += rs->in_rate;
+    }
+
+    return made;
+}
+
+uint32_t pcm_ima_block_frames(uint32_t len, uint16_t channels) {
+    uint32_t header = 4 * channels;
+    if (channels == 0 || len < header)
+        return 0;
+    return (len - header) / header * 8 + 1;
+}
+
+// one step of the decoder, `nibble` moves the predictor by the current step size and adapts it
+static inline int16_t pcm_ima_step_once(int32_t* predictor, int32_t* index, uint8_t nibble) {
+    int32_t step = pcm_ima_step[*index];
+    int32_t diff = step >> 3;
+
+    if (nibble & 1)
+        diff += step >> 2;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 4)
+        diff += step;
+
+    *predictor = pcm_sat16(nibble & 8 ? *predictor - diff : *predictor + diff);
+    *index += pcm_ima_index[nibble];
+    *index = *index < 0 ? 0 : *index > 88 ? 88 : *index;
+    return (int16_t)*predictor;
+}
+
+void pcm_ima_decode(struct pcm_ima* st, int16_t* out, const uint8_t* block, uint32_t frames, uint16_t channels) {
+    uint32_t right = channels > 1 ? 1 : 0;
+    const uint8_t* data = block + 4 * channels;
+
+    for (uint32_t i = 0; i < frames; i++, st->pos++, out += 2) {
+        if (st->pos == 0) {
+            // each channel opens with its first sample and step index, little endian
+            for (uint32_t c = 0; c < channels; c++) {
+                st->predictor[c] = (int16_t)(block[4 * c] | (block[4 * c + 1] << 8));
+                st->index[c] = block[4 * c + 2] > 88 ? 88 : block[4 * c + 2];
+            }
+            out[0] = (int16_t)st->predictor[0];
+            out[1] = (int16_t)st->predictor[right];
+            continue;
+        }
+
+        // channels take turns with 4 bytes of 8 samples each, low nibble first
+        uint32_t k = st->pos - 1;
+        uint32_t byte = (k / 8) * 4 * channels + (k % 8) / 2;
+        uint32_t shift = (k & 1) * 4;
+
+        out[0] = pcm_ima_step_once(&st->predictor[0], &st->index[0], (data[byte] >> shift) & 0xF);
+        out[1] = right ? pcm_ima_step_once(&st->predictor[1], &st->index[1], (data[byte + 4] >> shift) & 0xF) : out[0];
+    }
+}
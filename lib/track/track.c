@@ -0,0 +1,318 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <track/track.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+BUILD_ASSERT(CONFIG_TRACK_BUFFER_SIZE >= TRACK_RECORD_MAX, "CONFIG_TRACK_BUFFER_SIZE cannot hold a single record");
+
+// mean meridian degree, plenty for an error budget of meters
+#define TRACK_M_PER_DEG 111195.0f
+
+// Varint coding, 7 bits per byte, least significant first, high bit set on all but the last
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static int varint_put(uint8_t* buf, uint32_t v) {
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+// reads a varint from `len` bytes at `buf[*idx]`, indices wrap at `size` so it also walks the ring
+static int varint_get(const uint8_t* buf, uint32_t size, uint32_t* idx, uint32_t len, uint32_t* out) {
+    uint32_t v = 0;
+
+    for (uint32_t i = 0; i < len && i < 5; i++) {
+        uint8_t b = buf[(*idx + i) % size];
+        v |= (uint32_t)(b & 0x7F) << (7 * i);
+        if (!(b & 0x80)) {
+            *idx = (*idx + i + 1) % size;
+            *out = v;
+            return (int)i + 1;
+        }
+    }
+
+    return -EBADMSG;
+}
+
+// differences wrap like the uint32_t they are coded as, so any two points have a delta
+static int record_put(uint8_t* buf, const struct track_point* from, const struct track_point* to) {
+    int n = varint_put(buf, zigzag((int32_t)((uint32_t)to->lat - (uint32_t)from->lat)));
+    n += varint_put(buf + n, zigzag((int32_t)((uint32_t)to->lon - (uint32_t)from->lon)));
+    n += varint_put(buf + n, to->time - from->time);
+    return n;
+}
+
+// applies the record at `buf[*idx]` to `point`, returns its length
+static int record_get(const uint8_t* buf, uint32_t size, uint32_t* idx, uint32_t len, struct track_point* point) {
+    uint32_t dlat, dlon, dtime;
+    int n1, n2, n3;
+
+    if ((n1 = varint_get(buf, size, idx, len, &dlat)) < 0 ||
+            (n2 = varint_get(buf, size, idx, len - n1, &dlon)) < 0 ||
+            (n3 = varint_get(buf, size, idx, len - n1 - n2, &dtime)) < 0)
+        return -EBADMSG;
+
+    point->lat = (int32_t)((uint32_t)point->lat + (uint32_t)unzigzag(dlat));
+    point->lon = (int32_t)((uint32_t)point->lon + (uint32_t)unzigzag(dlon));
+    point->time += dtime;
+    return n1 + n2 + n3;
+}
+
+// Storage
+
+static void evict_oldest(struct track* track) {
+    int n = record_get(track->ring, sizeof(track->ring), &track->head, track->used, &track->base);
+    __ASSERT(n > 0, "track ring corrupt");
+
+    track->used -= n;
+    track->count--;
+    track->stats.evicted++;
+}
+
+static void store_point(struct track* track, const struct track_point* point) {
+    track->stats.points++;
+
+    if (track->count == 0) {
+        track->base = *point;
+        track->newest = *point;
+        track->count = 1;
+        return;
+    }
+
+    uint8_t record[TRACK_RECORD_MAX];
+    int len = record_put(record, &track->newest, point);
+
+    while (track->used + len > sizeof(track->ring))
+        evict_oldest(track);
+
+    uint32_t tail = (track->head + track->used) % sizeof(track->ring);
+    for (int i = 0; i < len; i++)
+        track->ring[(tail + i) % sizeof(track->ring)] = record[i];
+
+    track->used += len;
+    track->newest = *point;
+    track->count++;
+}
+
+// Simplifier
+
+static void simp_anchor(struct track* track) {
+    struct track_simplifier* simp = &track->simp;
+    float lat_deg = (float)track->newest.lat * CONFIG_TRACK_RESOLUTION / UFBII_COORD_SCALE;
+
+    simp->has_pending = false;
+    simp->cone_open = true;
+    simp->m_per_lat = TRACK_M_PER_DEG * CONFIG_TRACK_RESOLUTION / UFBII_COORD_SCALE;
+    simp->m_per_lon = simp->m_per_lat * cosf(lat_deg * (float)M_PI / 180.0f);
+}
+
+static inline float wrap_angle(float a) {
+    if (a > (float)M_PI)
+        a -= 2.0f * (float)M_PI;
+    else if (a < -(float)M_PI)
+        a += 2.0f * (float)M_PI;
+    return a;
+}
+
+// returns 1 if the cone broke and the pending point was stored
+static int simp_offer(struct track* track, const struct track_point* point) {
+    struct track_simplifier* simp = &track->simp;
+    const struct track_point* anchor = &track->newest;
+    float max_error = (float)track->max_error_m;
+
+    float x = (float)((int32_t)((uint32_t)point->lon - (uint32_t)anchor->lon)) * simp->m_per_lon;
+    float y = (float)((int32_t)((uint32_t)point->lat - (uint32_t)anchor->lat)) * simp->m_per_lat;
+    float dist = sqrtf(x * x + y * y);
+
+    // within the dead band the anchor already stands for the point, whatever its direction
+    if (dist <= max_error)
+        return 0;
+
+    float dir = atan2f(y, x);
+    float half = asinf(max_error / dist);
+
+    if (simp->cone_open) {
+        simp->cone_open = false;
+        simp->cone_ref = dir;
+        simp->cone_lo = -half;
+        simp->cone_hi = half;
+        simp->cone_far = dist;
+        simp->pending = *point;
+        simp->has_pending = true;
+        return 0;
+    }
+
+    // pending is always the farthest point, so every dropped one projects onto the segment itself
+    float rel = wrap_angle(dir - simp->cone_ref);
+    float along = dist * cosf(rel);
+    if (rel >= simp->cone_lo && rel <= simp->cone_hi && along >= simp->cone_far) {
+        simp->cone_lo = MAX(simp->cone_lo, rel - half);
+        simp->cone_hi = MIN(simp->cone_hi, rel + half);
+        simp->cone_far = along;
+        simp->pending = *point;
+        return 0;
+    }
+
+    // no line from the anchor passes close to every point anymore, or the track turned back
+    // towards the anchor; the last point that fit ends the segment
+    store_point(track, &simp->pending);
+    simp_anchor(track);
+    simp_offer(track, point); // opens a fresh cone, cannot break it
+    return 1;
+}
+
+void track_init(struct track* track, uint32_t max_error_m) {
+    memset(track, 0, sizeof(*track));
+    k_mutex_init(&track->lock);
+    track->max_error_m = MAX(max_error_m, 1);
+}
+
+static inline int32_t quantize(int32_t v) {
+    int64_t half = CONFIG_TRACK_RESOLUTION / 2;
+    return (int32_t)((v >= 0 ? (int64_t)v + half : (int64_t)v - half) / CONFIG_TRACK_RESOLUTION);
+}
+
+int track_add_fix(struct track* track, const struct ufirebirdii_fix* fix) {
+    const uint8_t needed = UFBII_FIX_HAS_POSITION | UFBII_FIX_HAS_TIME | UFBII_FIX_HAS_DATE;
+    if (!fix->valid || (fix->fields & needed) != needed)
+        return 0;
+
+    struct track_point point = {
+        .lat = quantize(fix->latitude),
+        .lon = quantize(fix->longitude),
+        .time = (uint32_t)(ufirebirdii_utc_to_unix_us(&fix->utc) / 1000000),
+    };
+    int stored = 0;
+
+    k_mutex_lock(&track->lock, K_FOREVER);
+    track->stats.fixes++;
+
+    if (track->count == 0) {
+        store_point(track, &point);
+        simp_anchor(track);
+        stored = 1;
+    } else if (point.time - track->newest.time >= CONFIG_TRACK_MAX_GAP_S) {
+        // a parked car still gets a point now and then, which says when it was last seen there
+        if (track->simp.has_pending)
+            store_point(track, &track->simp.pending);
+        store_point(track, &point);
+        simp_anchor(track);
+        stored = 1;
+    } else {
+        stored = simp_offer(track, &point);
+    }
+
+    k_mutex_unlock(&track->lock);
+    return stored;
+}
+
+int track_flush(struct track* track) {
+    int stored = 0;
+
+    k_mutex_lock(&track->lock, K_FOREVER);
+    if (track->simp.has_pending) {
+        store_point(track, &track->simp.pending);
+        simp_anchor(track);
+        stored = 1;
+    }
+    k_mutex_unlock(&track->lock);
+
+    return stored;
+}
+
+int track_encode(struct track* track, uint32_t skip, uint8_t* buf, size_t len, uint32_t* points) {
+    const uint32_t size = sizeof(track->ring);
+    int ret = 0;
+    size_t out = 0;
+
+    *points = 0;
+    k_mutex_lock(&track->lock, K_FOREVER);
+
+    if (skip >= track->count) {
+        ret = -ENOENT;
+        goto unlock;
+    }
+
+    struct track_point point = track->base;
+    uint32_t idx = track->head;
+    uint32_t left = track->used;
+
+    for (uint32_t i = 0; i < skip; i++) {
+        int n = record_get(track->ring, size, &idx, left, &point);
+        left -= n;
+    }
+
+    // the first point of every buffer is absolute
+    uint8_t first[TRACK_RECORD_MAX];
+    int n = varint_put(first, zigzag(point.lat));
+    n += varint_put(first + n, zigzag(point.lon));
+    n += varint_put(first + n, point.time);
+    if ((size_t)n > len) {
+        ret = -ENOMEM;
+        goto unlock;
+    }
+    memcpy(buf, first, n);
+    out = n;
+    (*points)++;
+
+    // the rest go out as stored, copied record by record while whole ones fit
+    while (left > 0) {
+        uint32_t start = idx;
+        n = record_get(track->ring, size, &idx, left, &point);
+        if (n < 0 || out + n > len)
+            break;
+
+        for (int i = 0; i < n; i++)
+            buf[out++] = track->ring[(start + i) % size];
+        left -= n;
+        (*points)++;
+    }
+
+    ret = (int)out;
+
+unlock:
+    k_mutex_unlock(&track->lock);
+    return ret;
+}
+
+int track_decode(const uint8_t** pos, const uint8_t* end, struct track_point* point, bool first) {
+    uint32_t len = (uint32_t)(end - *pos);
+    uint32_t idx = 0;
+
+    if (len == 0)
+        return -ENOENT;
+
+    if (first) {
+        uint32_t lat, lon, time;
+        if (varint_get(*pos, UINT32_MAX, &idx, len, &lat) < 0 ||
+                varint_get(*pos, UINT32_MAX, &idx, len - idx, &lon) < 0 ||
+                varint_get(*pos, UINT32_MAX, &idx, len - idx, &time) < 0)
+            return -EBADMSG;
+
+        point->lat = unzigzag(lat);
+        point->lon = unzigzag(lon);
+        point->time = time;
+    } else if (record_get(*pos, UINT32_MAX, &idx, len, point) < 0) {
+        return -EBADMSG;
+    }
+
+    *pos += idx;
+    return 0;
+}
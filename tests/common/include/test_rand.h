@@ -0,0 +1,21 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef TEST_RAND_H
+#define TEST_RAND_H
+
+#include <stdint.h>
+
+/**
+ * @brief Steps a 32 bit xorshift generator, so every run of a test sees the same numbers.
+ * @param state nonzero seed, advanced in place
+ * @returns the next number, never 0
+ */
+static inline uint32_t test_rand_next(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+#endif // TEST_RAND_H
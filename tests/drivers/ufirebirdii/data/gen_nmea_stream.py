@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+# Copyright (c) 2026 Nate Aquino
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Writes nmea_stream.txt, the receiver output the framer test replays: 10 Hz GGA, RMC, VTG,
+four GSA and ZDA epochs from a drive, with GSV for every constellation once a second, as a
+UC6580 puts them out at 115200 baud. It opens partway into a sentence and carries one
+sentence with a bad checksum, a run of line noise and one '$' line longer than the framer
+stages. Prints the byte, sentence and epoch totals the test expects.
+"""
+
+import argparse
+import math
+import random
+
+EPOCHS = 50
+
+# talker, first satellite id, satellites in view
+CONSTELLATIONS = [("GP", 1, 11), ("GL", 65, 7), ("GA", 1, 8), ("GB", 1, 12)]
+
+
+def sentence(body):
+    csum = 0
+    for c in body.encode():
+        csum ^= c
+    return f"${body}*{csum:02X}\r\n"
+
+
+def ddmm(value, deg_digits):
+    deg = int(abs(value))
+    return f"{deg:0{deg_digits}d}{(abs(value) - deg) * 60:08.5f}"
+
+
+def epoch_sentences(rng, t, lat, lon, speed, course):
+    hhmmss = f"{12 + t // 36000:02d}{t // 600 % 60:02d}{t // 10 % 60:02d}.{t % 10}0"
+    lat_s = f"{ddmm(lat, 2)},{'N' if lat >= 0 else 'S'}"
+    lon_s = f"{ddmm(lon, 3)},{'E' if lon >= 0 else 'W'}"
+    alt = 120 + 3 * math.sin(t / 40)
+    out = [
+        sentence(f"GNGGA,{hhmmss},{lat_s},{lon_s},1,24,0.7,{alt:.1f},M,-32.1,M,,"),
+        sentence(f"GNRMC,{hhmmss},A,{lat_s},{lon_s},{speed:.3f},{course:.2f},160426,,,A,V"),
+        sentence(f"GNVTG,{course:.2f},T,,M,{speed:.3f},N,{speed * 1.852:.3f},K,A"),
+    ]
+    for system, (_, first, count) in enumerate(CONSTELLATIONS, start=1):
+        ids = ",".join(f"{first + i:02d}" for i in range(min(count, 12)))
+        ids += "," * (12 - min(count, 12))
+        out.append(sentence(f"GNGSA,A,3,{ids},1.2,0.7,1.0,{system}"))
+
+    if t % 10 == 0:
+        for talker, first, count in CONSTELLATIONS:
+            pages = (count + 3) // 4
+            for page in range(pages):
+                sats = ""
+                for i in range(page * 4, min(count, page * 4 + 4)):
+                    sats += f",{first + i:02d},{rng.randint(5, 85):02d},{rng.randint(0, 359):03d},{rng.randint(20, 48):02d}"
+                out.append(sentence(f"{talker}GSV,{pages},{page + 1},{count:02d}{sats},1"))
+
+    out.append(sentence(f"GNZDA,{hhmmss},16,04,2026,00,00"))
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output", required=True)
+    parser.add_argument("--seed", type=int, default=7)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    lat, lon, course, speed = 47.6062, -122.3321, 35.0, 24.3
+    stream = ""
+    sentences = 0
+
+    # the receiver was already talking when the uart came up
+    stream += sentence("GNZDA,115959.90,16,04,2026,00,00")[17:]
+
+    for t in range(EPOCHS):
+        lines = epoch_sentences(rng, t, lat, lon, speed, course)
+        if t == 12:
+            # a flipped bit on the wire, the framer still delivers it and the parser rejects it
+            lines[1] = lines[1].replace(",A,", ",B,", 1)
+        if t == 23:
+            # line noise without a '$' between two epochs
+            stream += "".join(chr(rng.randint(0x21, 0x7E)) for _ in range(40)).replace("$", "#")
+        if t == 37:
+            # a line the framer gives up on before its end, dropped whole
+            stream += "$" + "".join(rng.choice("0123456789ABCDEF,.") for _ in range(180)) + "\r\n"
+
+        stream += "".join(lines)
+        sentences += len(lines)
+
+        course += rng.uniform(-2, 2)
+        lat += speed * 0.5144 * 0.1 * math.cos(math.radians(course)) / 111320
+        lon += speed * 0.5144 * 0.1 * math.sin(math.radians(course)) / (111320 * math.cos(math.radians(lat)))
+
+    with open(args.output, "w", newline="") as f:
+        f.write(stream)
+
+    print(f"{len(stream)} bytes, {sentences} sentences, {EPOCHS} epochs")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2026 Nate Aquino
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Writes rtcm3_stream.bin, the correction stream the framer test replays: a base station's
+1005/1033/1077/1087/1097/1127/1230 cycle with line noise, false preambles and cut frames
+spliced in between. Payload bits past the message number are filler, the framer never
+looks at them. Prints the byte and frame totals and the frames of each message type, what
+cycle[] and STREAM_FRAMES in the test hold. The CRC errors depend on how the framer resyncs
+and are worked out in the test instead.
+"""
+
+import argparse
+import random
+
+
+def crc24q(data):
+    crc = 0
+    for b in data:
+        crc ^= b << 16
+        for _ in range(8):
+            crc <<= 1
+            if crc & 0x1000000:
+                crc ^= 0x1864CFB
+    return crc & 0xFFFFFF
+
+
+def frame(payload):
+    head = bytes([0xD3, len(payload) >> 8, len(payload) & 0xFF]) + payload
+    return head + crc24q(head).to_bytes(3, "big")
+
+
+def message(rng, msg_type, length):
+    body = bytearray(rng.randbytes(length))
+    body[0] = msg_type >> 4
+    body[1] = (msg_type & 0x0F) << 4 | (body[1] & 0x0F)
+    return bytes(body)
+
+
+# message type, payload length
+CYCLE = [(1005, 19), (1033, 40), (1077, 437), (1087, 298), (1097, 351), (1127, 260), (1230, 8)]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output", required=True)
+    parser.add_argument("--seed", type=int, default=3)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    stream = bytearray()
+    frames = {msg_type: 0 for msg_type, _ in CYCLE}
+    epochs = 6
+
+    # a receiver rarely starts on a frame boundary
+    stream += message(rng, 1077, 437)[200:]
+
+    for epoch in range(epochs):
+        for msg_type, length in CYCLE:
+            payload = message(rng, msg_type, length)
+            # a preamble byte inside a payload must not split the frame
+            if epoch == 1 and msg_type == 1077:
+                payload = payload[:40] + b"\xd3\x00\x13" + payload[43:]
+            stream += frame(payload)
+            frames[msg_type] += 1
+
+        noise = epoch % 3
+        if noise == 0:
+            # line noise without a preamble
+            stream += bytes(b for b in rng.randbytes(37) if b != 0xD3)
+        elif noise == 1:
+            # a false preamble whose length runs into the next real frame
+            stream += b"\xd3\x00\x40" + bytes(b for b in rng.randbytes(5) if b != 0xD3)
+        else:
+            # a frame cut off by a dropped radio packet, then a header with the reserved bits set
+            stream += frame(message(rng, 1087, 298))[:150] + b"\xd3\xfc\x10"
+
+    # the tail of a frame the recording stopped in
+    stream += frame(message(rng, 1005, 19))[:10]
+
+    with open(args.output, "wb") as f:
+        f.write(stream)
+
+    print(f"{len(stream)} bytes, {sum(frames.values())} frames in {epochs} epochs")
+    print(", ".join(f"{msg_type}: {count}" for msg_type, count in frames.items()))
+
+
+if __name__ == "__main__":
+    main()
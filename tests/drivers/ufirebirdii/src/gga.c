@@ -0,0 +1,201 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+#include <test_rand.h>
+
+static struct ufirebirdii_driver_config cfg = {
+    .user_config = { .do_checksum = true },
+};
+
+/// What the sscanf parser GGA used to have made of a payload, in the units the fix carries now
+struct legacy_gga {
+    int64_t latitude;
+    int64_t longitude;
+    int64_t altitude;
+    int64_t hdop;
+    int satellites;
+    int quality;
+};
+
+static int64_t legacy_round(double v) {
+    return (int64_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+// the removed parser verbatim, fed everything after the time field
+static int legacy_parse(const char* fields, struct legacy_gga* out) {
+    int lat_deg, lon_deg;
+    double lat_min, lon_min, altitude, hdop;
+    char lat_dir, lon_dir;
+
+    int ret = sscanf(fields, "%2d%lf,%c,%3d%lf,%c,%d,%d,%lf,%lf",
+        &lat_deg, &lat_min, &lat_dir, &lon_deg, &lon_min, &lon_dir,
+        &out->quality, &out->satellites, &hdop, &altitude);
+    if (ret != 10)
+        return -EINVAL;
+
+    out->latitude = legacy_round((lat_deg + lat_min / 60) * UFBII_COORD_SCALE) * (lat_dir == 'S' ? -1 : 1);
+    out->longitude = legacy_round((lon_deg + lon_min / 60) * UFBII_COORD_SCALE) * (lon_dir == 'W' ? -1 : 1);
+    out->altitude = legacy_round(altitude * 1000);
+    out->hdop = legacy_round(hdop * 100);
+    return 0;
+}
+
+// wraps `body` (no '$', no checksum) into a sentence and parses it into a fresh epoch
+static int parse(const char* body, struct ufirebirdii_epoch* epoch) {
+    char sentence[128];
+    uint8_t csum = 0;
+
+    for (const char* p = body; *p != '\0'; p++)
+        csum ^= (uint8_t)*p;
+
+    int len = snprintf(sentence, sizeof(sentence), "$%s*%02X", body, csum);
+    if (len < 0 || len >= (int)sizeof(sentence))
+        return -ENOSPC;
+
+    ufirebirdii_epoch_init(epoch);
+    return ufirebirdii_parse_sentence(sentence, len, epoch, &cfg);
+}
+
+// parses a GNGGA with time 123519.00 and `fields` after it, and checks it against the old parser
+static void check_against_legacy(const char* fields, int64_t coord_tolerance) {
+    char body[128];
+    struct ufirebirdii_epoch epoch;
+    struct legacy_gga legacy;
+
+    snprintf(body, sizeof(body), "GNGGA,123519.00,%s,M,46.9,M,,", fields);
+    zassert_ok(legacy_parse(fields, &legacy), "legacy parser rejected %s", fields);
+    zassert_true(parse(body, &epoch) >= 0, "%s", body);
+
+    const struct ufirebirdii_fix* fix = &epoch.work;
+    zassert_true(fix->fields & UFBII_FIX_HAS_POSITION, "%s", body);
+    zassert_within(fix->latitude, legacy.latitude, coord_tolerance, "%s", body);
+    zassert_within(fix->longitude, legacy.longitude, coord_tolerance, "%s", body);
+    zassert_within(fix->altitude, legacy.altitude, 1, "%s", body);
+    zassert_within(fix->hdop, legacy.hdop, 1, "%s", body);
+    zassert_equal(fix->satellites, legacy.satellites, "%s", body);
+    zassert_equal(fix->validity, legacy.quality, "%s", body);
+}
+
+ZTEST(ufirebirdii_gga, test_exact)
+{
+    struct ufirebirdii_epoch epoch;
+
+    zassert_true(parse("GNGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch) >= 0);
+
+    const struct ufirebirdii_fix* fix = &epoch.work;
+    zassert_equal(fix->latitude, 481173000);    // 48 + 7.038 / 60
+    zassert_equal(fix->longitude, 115166667);   // 11 + 31 / 60, rounded
+    zassert_equal(fix->altitude, 545400);
+    zassert_equal(fix->hdop, 90);
+    zassert_equal(fix->satellites, 8);
+    zassert_equal(fix->validity, FIX_VALITIDY_SINGLE_POINT_POSITIONING);
+    zassert_true(fix->valid);
+    zassert_equal(fix->utc.hour, 12);
+    zassert_equal(fix->utc.minute, 35);
+    zassert_equal(fix->utc.second, 19);
+    zassert_equal(fix->utc.millisecond, 0);
+
+    check_against_legacy("4807.038,N,01131.000,E,1,08,0.9,545.4", 0);
+}
+
+ZTEST(ufirebirdii_gga, test_hemispheres)
+{
+    struct ufirebirdii_epoch epoch;
+
+    zassert_true(parse("GNGGA,000000.00,3351.9520,S,15112.5410,W,2,12,1.25,-12.5,M,0.0,M,,", &epoch) >= 0);
+    zassert_equal(epoch.work.latitude, -338658667);
+    zassert_equal(epoch.work.longitude, -1512090167);
+    zassert_equal(epoch.work.altitude, -12500);
+    zassert_equal(epoch.work.hdop, 125);
+
+    check_against_legacy("3351.9520,S,15112.5410,W,2,12,1.25,-12.5", 0);
+    check_against_legacy("0000.0001,S,00000.0001,W,1,04,99.99,-0.001", 0);
+    check_against_legacy("8959.9999,N,17959.9999,E,1,04,0.5,8848.86", 0);
+}
+
+ZTEST(ufirebirdii_gga, test_rounding)
+{
+    struct ufirebirdii_epoch epoch;
+
+    // minutes are rounded to 1e-7 on the first dropped digit, then divided down to degrees
+    zassert_true(parse("GNGGA,123519.00,4807.03812345,N,01131.00000049,E,1,08,0.945,545.4565,M,46.9,M,,", &epoch) >= 0);
+    zassert_equal(epoch.work.latitude, 481173021); // 7.0381235 min
+    zassert_equal(epoch.work.longitude, 115166667);
+    zassert_equal(epoch.work.hdop, 95);
+    zassert_equal(epoch.work.altitude, 545457);
+
+    // the old doubles round the full value once, so the two can differ by the last unit
+    check_against_legacy("4807.03812345,N,01131.00000049,E,1,08,0.945,545.4565", 1);
+    check_against_legacy("4807.0000000,N,01131.9999999,E,1,08,0.944,545.4564", 1);
+    check_against_legacy("4807.99999995,N,01131.00000005,E,1,08,0.995,545.9995", 1);
+}
+
+ZTEST(ufirebirdii_gga, test_overlong_fraction)
+{
+    // far more digits than 1e-7 degrees resolve, the extra ones only round
+    check_against_legacy("4807.038123456789012,N,01131.000987654321098,E,1,08,0.9123456789,545.4123456789", 1);
+    check_against_legacy("0130.5555555555555555,S,00030.4444444444444444,W,4,20,12.3456789,10000.0005", 1);
+}
+
+ZTEST(ufirebirdii_gga, test_empty_fields)
+{
+    struct ufirebirdii_epoch epoch;
+
+    // no position yet during a cold start: not an error, only the time comes through
+    zassert_true(parse("GNGGA,123519.00,,,,,0,00,,,M,,M,,", &epoch) >= 0);
+    zassert_equal(epoch.work.fields, UFBII_FIX_HAS_TIME);
+    zassert_false(epoch.work.valid);
+
+    // a position without the rest is malformed, as it was for sscanf
+    zassert_equal(parse("GNGGA,123519.00,4807.038,N,01131.000,E,1,08,,545.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4807.038,,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch), -EINVAL);
+}
+
+ZTEST(ufirebirdii_gga, test_malformed)
+{
+    struct ufirebirdii_epoch epoch;
+
+    zassert_equal(parse("GNGGA,123519.00,4807.038,X,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4860.000,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4807.0a8,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,5454444444.4,M,46.9,M,,", &epoch), -EINVAL);
+    zassert_equal(parse("GNGGA,123519.00,4807.038,N,01131.000,E", &epoch), -EINVAL);
+}
+
+ZTEST(ufirebirdii_gga, test_random_against_legacy)
+{
+    uint32_t state = 0x6A09E667;
+    char fields[128];
+
+    for (int i = 0; i < 2000; i++) {
+        uint32_t lat_deg = test_rand_next(&state) % 90;
+        uint32_t lon_deg = test_rand_next(&state) % 180;
+        uint32_t lat_min = test_rand_next(&state) % 60;
+        uint32_t lon_min = test_rand_next(&state) % 60;
+        uint32_t lat_frac = test_rand_next(&state) % 100000000;
+        uint32_t lon_frac = test_rand_next(&state) % 100000000;
+        int lat_digits = 1 + test_rand_next(&state) % 8;
+        int lon_digits = 1 + test_rand_next(&state) % 8;
+        uint32_t hdop = test_rand_next(&state) % 10000;
+        int32_t altitude = (int32_t)(test_rand_next(&state) % 2000000) - 500000;
+
+        // truncating the fraction to `digits` digits covers every fraction length up to 8
+        static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+        snprintf(fields, sizeof(fields), "%02u%02u.%0*u,%c,%03u%02u.%0*u,%c,1,%02u,%u.%02u,%s%d.%03d",
+            lat_deg, lat_min, lat_digits, lat_frac / pow10[8 - lat_digits], i & 1 ? 'S' : 'N',
+            lon_deg, lon_min, lon_digits, lon_frac / pow10[8 - lon_digits], i & 2 ? 'W' : 'E',
+            test_rand_next(&state) % 40, hdop / 100, hdop % 100,
+            altitude < 0 ? "-" : "", abs(altitude) / 1000, abs(altitude) % 1000);
+
+        check_against_legacy(fields, 1);
+    }
+}
+
+ZTEST_SUITE(ufirebirdii_gga, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,216 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <string.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+#ifdef CONFIG_EXTERNAL_LIBC
+#include <time.h>
+#endif
+
+// data/nmea_stream.txt, see data/gen_nmea_stream.py for what is in it
+static const uint8_t stream[] = {
+#include "nmea_stream.inc"
+};
+
+#define STREAM_SENTENCES    450
+#define STREAM_EPOCHS       50
+#define STREAM_GSV          (5 * 10)    // a second's worth of each constellation, every 10th epoch
+#define STREAM_BAD_CHECKSUM 1
+#define STREAM_OVERLONG     1           // the '$' line that runs past UFBII_SENTENCE_MAX
+
+// the uc6580 ring at its default size, and how the isr wakes the rx work handler
+#define RING_SIZE           1024
+#define RING_HIGH_WATER     (RING_SIZE / 2)
+#define BENCH_REPLAYS       200
+
+static struct ufirebirdii_driver_config cfg = {
+    .user_config = { .do_checksum = true },
+};
+
+struct replay_counts {
+    uint32_t sentences;
+    uint32_t overlong;
+    uint32_t parsed;
+    uint32_t epochs;
+    uint32_t unsupported;
+    uint32_t checksum_errors;
+};
+
+struct replay {
+    struct ring_buf ring;
+    struct ufirebirdii_nmea_framer fr;
+    struct ufirebirdii_epoch epoch;
+    bool parse;     // hand sentences to the parser, or only frame them
+    struct replay_counts n;
+    uint8_t ring_data[RING_SIZE];
+};
+
+static struct replay replay;
+
+static void count_result(struct replay* r, int ret) {
+    if (ret == UFBII_EPOCH_CLOSED)
+        r->n.epochs++;
+    if (ret >= 0)
+        r->n.parsed++;
+    else if (ret == -ENOTSUP)
+        r->n.unsupported++;
+    else if (ret == -EILSEQ)
+        r->n.checksum_errors++;
+}
+
+// what uc6580_rx_work_handler does with the ring, less the stats
+static void frame_ring(struct replay* r) {
+    const uint8_t* ring_end = r->ring_data + sizeof(r->ring_data);
+    uint8_t* claim;
+    uint32_t len;
+
+    while ((len = ring_buf_get_claim(&r->ring, &claim, UINT32_MAX)) > 0) {
+        bool wraps = claim + len == ring_end;
+        const uint8_t* sentence;
+        uint32_t used;
+
+        int ret = ufirebirdii_nmea_feed(&r->fr, claim, len, wraps, &sentence, &used);
+        if (ret > 0) {
+            r->n.sentences++;
+            if (r->parse) {
+                // uc6580_dispatch drops the line ending
+                count_result(r, ufirebirdii_parse_sentence((const char*)sentence, ret - 2, &r->epoch, &cfg));
+            }
+        } else if (ret == -EMSGSIZE) {
+            r->n.overlong++;
+        }
+
+        ring_buf_get_finish(&r->ring, used);
+        if (ret == 0 && !wraps)
+            break;
+    }
+}
+
+// feeds the stream into the ring `chunk` bytes at a time, waking the framer the way the isr does
+static void replay_stream(struct replay* r, uint32_t chunk, bool parse) {
+    ring_buf_init(&r->ring, sizeof(r->ring_data), r->ring_data);
+    ufirebirdii_nmea_framer_reset(&r->fr);
+    ufirebirdii_epoch_init(&r->epoch);
+    memset(&r->n, 0, sizeof(r->n));
+    r->parse = parse;
+
+    for (uint32_t off = 0; off < sizeof(stream); off += chunk) {
+        const uint8_t* data = stream + off;
+        uint32_t len = MIN(chunk, sizeof(stream) - off);
+
+        zassert_equal(ring_buf_put(&r->ring, data, len), len, "ring overran at %u", off);
+        if (memchr(data, '\n', len) != NULL || ring_buf_size_get(&r->ring) >= RING_HIGH_WATER)
+            frame_ring(r);
+    }
+}
+
+ZTEST(ufirebirdii_nmea, test_feed)
+{
+    static const char two[] = "junk$GNZDA,1*00\r\n$GNZDA,2*00\r\n$GNZ";
+    struct ufirebirdii_nmea_framer fr;
+    const uint8_t* data = (const uint8_t*)two;
+    const uint8_t* sentence;
+    uint32_t used;
+
+    ufirebirdii_nmea_framer_reset(&fr);
+
+    // the bytes before the '$' go with the first sentence, which is found in place
+    zassert_equal(ufirebirdii_nmea_feed(&fr, data, sizeof(two) - 1, false, &sentence, &used), 13);
+    zassert_equal(sentence, data + 4);
+    zassert_equal(used, 17);
+
+    zassert_equal(ufirebirdii_nmea_feed(&fr, data + 17, sizeof(two) - 1 - 17, false, &sentence, &used), 13);
+    zassert_mem_equal(sentence, "$GNZDA,2*00\r\n", 13);
+    zassert_equal(used, 13);
+
+    // a partial sentence stays in the ring, and is not searched again once more arrives
+    zassert_equal(ufirebirdii_nmea_feed(&fr, data + 30, 4, false, &sentence, &used), 0);
+    zassert_equal(used, 0);
+    zassert_equal(fr.scanned, 4);
+
+    // at the end of the ring it is staged instead, and finished from the start of the ring
+    ufirebirdii_nmea_framer_reset(&fr);
+    zassert_equal(ufirebirdii_nmea_feed(&fr, data + 30, 4, true, &sentence, &used), 0);
+    zassert_equal(used, 4);
+    zassert_equal(ufirebirdii_nmea_feed(&fr, (const uint8_t*)"DA,3*00\r\n", 9, false, &sentence, &used), 13);
+    zassert_equal(sentence, fr.stage_buf);
+    zassert_mem_equal(sentence, "$GNZDA,3*00\r\n", 13);
+
+    // no line end within UFBII_SENTENCE_MAX, staged or not
+    static uint8_t line[UFBII_SENTENCE_MAX + 2];
+    memset(line, 'A', sizeof(line));
+    line[0] = '$';
+    line[sizeof(line) - 1] = '\n';
+    zassert_equal(ufirebirdii_nmea_feed(&fr, line, sizeof(line), false, &sentence, &used), -EMSGSIZE);
+    zassert_equal(used, sizeof(line));
+    zassert_equal(ufirebirdii_nmea_feed(&fr, line, UFBII_SENTENCE_MAX + 1, false, &sentence, &used), -EMSGSIZE);
+    zassert_false(fr.synced);
+}
+
+ZTEST(ufirebirdii_nmea, test_replay)
+{
+    // a byte at a time, fifo bursts, DMA buffers and more than the ring between wakes
+    static const uint32_t chunks[] = { 1, 7, 32, 256, RING_HIGH_WATER - 1 };
+
+    for (int i = 0; i < ARRAY_SIZE(chunks); i++) {
+        replay_stream(&replay, chunks[i], true);
+
+        zassert_equal(replay.n.sentences, STREAM_SENTENCES, "chunk %u", chunks[i]);
+        zassert_equal(replay.n.overlong, STREAM_OVERLONG, "chunk %u", chunks[i]);
+        zassert_equal(replay.n.checksum_errors, STREAM_BAD_CHECKSUM, "chunk %u", chunks[i]);
+        zassert_equal(replay.n.unsupported, STREAM_GSV, "chunk %u", chunks[i]);
+        zassert_equal(replay.n.parsed, STREAM_SENTENCES - STREAM_GSV - STREAM_BAD_CHECKSUM, "chunk %u", chunks[i]);
+        zassert_equal(replay.n.epochs, STREAM_EPOCHS, "chunk %u", chunks[i]);
+    }
+}
+
+#ifdef CONFIG_EXTERNAL_LIBC
+#define BENCH_UNIT      "ns"
+#define BENCH_PER_SEC   NSEC_PER_SEC
+static uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#else
+#define BENCH_UNIT      "cycles"
+#define BENCH_PER_SEC   sys_clock_hw_cycles_per_sec()
+static uint64_t bench_now(void) {
+    return k_cycle_get_64();
+}
+#endif
+
+// replays the stream BENCH_REPLAYS times, @returns the cost per sentence
+static uint64_t bench_replay(uint32_t chunk, bool parse) {
+    uint64_t elapsed = 0;
+
+    for (int i = 0; i < BENCH_REPLAYS; i++) {
+        uint64_t start = bench_now();
+        replay_stream(&replay, chunk, parse);
+        elapsed += bench_now() - start;
+    }
+
+    uint64_t per_sentence = elapsed / ((uint64_t)BENCH_REPLAYS * STREAM_SENTENCES);
+    uint64_t bytes_per_sec = (uint64_t)BENCH_REPLAYS * sizeof(stream) * BENCH_PER_SEC / MAX(elapsed, 1);
+
+    TC_PRINT("%3u byte chunks, %-12s %5llu %s/sentence, %llu kB/s\n", chunk, parse ? "frame+parse" : "frame only",
+        (unsigned long long)per_sentence, BENCH_UNIT, (unsigned long long)bytes_per_sec / 1000);
+    return per_sentence;
+}
+
+ZTEST(ufirebirdii_nmea, test_benchmark)
+{
+    // the ring, the wakes and the parser calls are timed with the framer, fix callbacks are not
+    for (int parse = 0; parse <= 1; parse++) {
+        bench_replay(1, parse);
+        bench_replay(32, parse);
+        bench_replay(256, parse);
+    }
+    zassert_true(bench_replay(32, false) > 0);
+}
+
+ZTEST_SUITE(ufirebirdii_nmea, NULL, NULL, NULL, NULL, NULL);
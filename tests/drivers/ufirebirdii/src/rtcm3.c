@@ -0,0 +1,134 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include <drivers/ufirebirdii/ufirebirdii.h>
+
+// data/rtcm3_stream.bin, see data/gen_rtcm3_stream.py for what is in it
+static const uint8_t stream[] = {
+#include "rtcm3_stream.inc"
+};
+
+// the base station's cycle, repeated once per epoch in the stream
+static const uint16_t cycle[] = { 1005, 1033, 1077, 1087, 1097, 1127, 1230 };
+#define STREAM_EPOCHS   6
+#define STREAM_FRAMES   (STREAM_EPOCHS * ARRAY_SIZE(cycle))
+
+/*
+ * False preambles after epochs 1 and 4 and the frame cut after epoch 2 fail their CRC. The
+ * frame cut after epoch 5 never completes, the recording stops first.
+ */
+#define STREAM_CRC_ERRORS   3
+
+struct replay {
+    struct ufirebirdii_rtcm3_framer fr;
+    uint32_t frames;
+    uint32_t frame_bytes;
+};
+
+static struct replay replay;
+
+static uint16_t message_type(const uint8_t* frame) {
+    return (frame[UFBII_RTCM3_HEADER_LEN] << 4) | (frame[UFBII_RTCM3_HEADER_LEN + 1] >> 4);
+}
+
+// feeds the stream `chunk` bytes at a time, as radio payloads or file reads would
+static void replay_stream(struct replay* r, uint32_t chunk) {
+    ufirebirdii_rtcm3_framer_init(&r->fr);
+    r->frames = 0;
+    r->frame_bytes = 0;
+
+    for (uint32_t off = 0; off < sizeof(stream); off += chunk) {
+        const uint8_t* data = stream + off;
+        uint32_t len = MIN(chunk, sizeof(stream) - off);
+        uint32_t used, frame_len;
+
+        while ((frame_len = ufirebirdii_rtcm3_feed(&r->fr, data, len, &used)) > 0) {
+            zassert_ok(ufirebirdii_rtcm3_check(r->fr.frame, frame_len), "frame %u", r->frames);
+            zassert_true(r->frames < STREAM_FRAMES, "more frames than the stream holds");
+            zassert_equal(message_type(r->fr.frame), cycle[r->frames % ARRAY_SIZE(cycle)],
+                "frame %u out of order at chunk %u", r->frames, chunk);
+
+            r->frames++;
+            r->frame_bytes += frame_len;
+            data += used;
+            len -= used;
+        }
+        zassert_equal(used, len, "bytes left behind without a frame");
+    }
+}
+
+ZTEST(ufirebirdii_rtcm3, test_crc24q)
+{
+    static const uint8_t empty_header[] = { 0xD3, 0x00, 0x00 };
+
+    zassert_equal(ufirebirdii_crc24q(empty_header, sizeof(empty_header)), 0x47EA4B);
+    zassert_equal(ufirebirdii_crc24q((const uint8_t*)"123456789", 9), 0xCDE703);
+    zassert_equal(ufirebirdii_crc24q(NULL, 0), 0);
+}
+
+ZTEST(ufirebirdii_rtcm3, test_check)
+{
+    uint8_t frame[] = { 0xD3, 0x00, 0x00, 0x47, 0xEA, 0x4B };
+
+    zassert_ok(ufirebirdii_rtcm3_check(frame, sizeof(frame)));
+    zassert_equal(ufirebirdii_rtcm3_check(frame, sizeof(frame) - 1), -EBADMSG);
+
+    frame[5] ^= 1;
+    zassert_equal(ufirebirdii_rtcm3_check(frame, sizeof(frame)), -EBADMSG);
+    frame[5] ^= 1;
+
+    frame[1] = 0x04;    // reserved bits must be zero
+    zassert_equal(ufirebirdii_rtcm3_check(frame, sizeof(frame)), -EBADMSG);
+}
+
+ZTEST(ufirebirdii_rtcm3, test_replay)
+{
+    static const uint32_t chunks[] = { 1, 2, 7, 64, 251, UFBII_RTCM3_FRAME_MAX, sizeof(stream) };
+    struct ufirebirdii_rtcm3_stats first;
+
+    for (int i = 0; i < ARRAY_SIZE(chunks); i++) {
+        replay_stream(&replay, chunks[i]);
+
+        zassert_equal(replay.frames, STREAM_FRAMES, "chunk %u", chunks[i]);
+        zassert_equal(replay.fr.stats.frames, STREAM_FRAMES);
+        zassert_equal(replay.fr.stats.crc_errors, STREAM_CRC_ERRORS, "chunk %u", chunks[i]);
+
+        // every byte is either in a frame, skipped or still held for the frame the recording cut
+        zassert_equal(replay.frame_bytes + replay.fr.stats.discarded + replay.fr.len, sizeof(stream),
+            "chunk %u", chunks[i]);
+        zassert_true(replay.fr.len > 0 && replay.fr.frame[0] == UFBII_RTCM3_PREAMBLE);
+
+        // where the stream is split must not change what is found
+        if (i == 0)
+            first = replay.fr.stats;
+        zassert_mem_equal(&replay.fr.stats, &first, sizeof(first), "chunk %u", chunks[i]);
+    }
+
+    TC_PRINT("%u frames, %u CRC errors, %u bytes skipped\n",
+        first.frames, first.crc_errors, first.discarded);
+}
+
+ZTEST(ufirebirdii_rtcm3, test_false_preamble)
+{
+    // a 0xD3 in front of a real frame claims its bytes; the bad CRC must give them back
+    static const uint8_t real[] = { 0xD3, 0x00, 0x00, 0x47, 0xEA, 0x4B };
+    uint8_t data[3 + sizeof(real)] = { 0xD3, 0x00, 0x03 };
+    uint32_t used, frame_len;
+
+    memcpy(data + 3, real, sizeof(real));
+    ufirebirdii_rtcm3_framer_init(&replay.fr);
+
+    frame_len = ufirebirdii_rtcm3_feed(&replay.fr, data, sizeof(data), &used);
+    zassert_equal(frame_len, sizeof(real));
+    zassert_mem_equal(replay.fr.frame, real, sizeof(real));
+    zassert_equal(replay.fr.stats.crc_errors, 1);
+    zassert_equal(replay.fr.stats.discarded, 3);
+
+    zassert_equal(ufirebirdii_rtcm3_feed(&replay.fr, data + used, sizeof(data) - used, &used), 0);
+    zassert_equal(replay.fr.len, 0);
+}
+
+ZTEST_SUITE(ufirebirdii_rtcm3, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,328 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <math.h>
+#include <string.h>
+
+#include <geofence/geofence.h>
+#include <test_rand.h>
+
+#ifdef CONFIG_EXTERNAL_LIBC
+#include <time.h>
+#endif
+
+// a city sized field, around 20 x 15 km
+#define FIELD_LAT   473700000
+#define FIELD_LON   85400000
+#define FIELD_SPAN  1000000
+
+#define FIELD_ZONES         200
+#define FIELD_MAX_CORNERS   12
+#define BENCH_UPDATES       200000
+
+#define M_PER_DEG   111195.0
+
+static struct geofence fence;
+
+// the field, kept beside the fence so a plain loop can check what the grid reports
+static struct geofence_point corners[FIELD_ZONES][FIELD_MAX_CORNERS];
+static struct geofence_zone_def defs[FIELD_ZONES];
+static bool expected[FIELD_ZONES];
+
+static struct transitions {
+    uint32_t enters;
+    uint32_t exits;
+    uint16_t last_id;
+    enum geofence_event last_event;
+} seen;
+
+static void on_transition(struct geofence* gf, uint16_t zone_id, enum geofence_event event,
+        const struct ufirebirdii_fix* fix, void* user_data) {
+    struct transitions* t = user_data;
+
+    if (event == GEOFENCE_ENTER)
+        t->enters++;
+    else
+        t->exits++;
+    t->last_id = zone_id;
+    t->last_event = event;
+}
+
+static struct ufirebirdii_fix fix_at(int32_t lat, int32_t lon) {
+    return (struct ufirebirdii_fix){
+        .latitude = lat,
+        .longitude = lon,
+        .fields = UFBII_FIX_HAS_POSITION,
+        .valid = true,
+    };
+}
+
+// so every run builds the same field
+static uint32_t rand_state;
+
+static int32_t rand_between(int32_t lo, int32_t hi) {
+    return lo + (int32_t)(test_rand_next(&rand_state) % (uint32_t)(hi - lo + 1));
+}
+
+/*
+ * Reference containment in doubles, one zone at a time. @returns 1 inside, 0 outside and -1
+ * when `p` is too close to the edge for the two to be expected to agree.
+ */
+static int reference_contains(const struct geofence_zone_def* def, struct geofence_point p) {
+    if (def->shape == GEOFENCE_CIRCLE) {
+        struct geofence_point c = def->points[0];
+        double dlat = (double)(p.lat - c.lat) / UFBII_COORD_SCALE * M_PER_DEG;
+        double dlon = (double)(p.lon - c.lon) / UFBII_COORD_SCALE * M_PER_DEG *
+            cos((double)c.lat / UFBII_COORD_SCALE * M_PI / 180.0);
+        double d = sqrt(dlat * dlat + dlon * dlon);
+
+        return fabs(d - def->radius_m) < 0.5 ? -1 : d < def->radius_m;
+    }
+
+    const struct geofence_point* v = def->points;
+    bool inside = false;
+
+    for (int i = 0, j = def->num_points - 1; i < def->num_points; j = i++) {
+        if ((v[i].lat > p.lat) == (v[j].lat > p.lat))
+            continue;
+
+        double x = v[i].lon + (double)(p.lat - v[i].lat) * (v[j].lon - v[i].lon) / (v[j].lat - v[i].lat);
+        if (fabs(x - p.lon) < 10)
+            return -1;
+        if (p.lon < x)
+            inside = !inside;
+    }
+
+    return inside;
+}
+
+/*
+ * Mostly small circles and concave polygons that sit in the grid, a few circles too big
+ * for it that go on the wide list. Zone ids are their index.
+ */
+static void build_field(uint32_t seed, int num_zones) {
+    rand_state = seed;
+    geofence_init(&fence, on_transition, &seen);
+    memset(&seen, 0, sizeof(seen));
+    memset(expected, 0, sizeof(expected));
+
+    for (int i = 0; i < num_zones; i++) {
+        struct geofence_zone_def* def = &defs[i];
+        struct geofence_point center = {
+            .lat = FIELD_LAT + rand_between(0, FIELD_SPAN),
+            .lon = FIELD_LON + rand_between(0, FIELD_SPAN),
+        };
+
+        def->id = i;
+        def->points = corners[i];
+
+        if (i % 40 == 0) {
+            def->shape = GEOFENCE_CIRCLE;
+            def->radius_m = rand_between(5000, 8000);
+            def->num_points = 1;
+            corners[i][0] = center;
+        } else if (i % 2 == 0) {
+            def->shape = GEOFENCE_CIRCLE;
+            def->radius_m = rand_between(50, 600);
+            def->num_points = 1;
+            corners[i][0] = center;
+        } else {
+            // a star, corners at increasing angles with alternating radii is simple but concave
+            def->shape = GEOFENCE_POLYGON;
+            def->num_points = rand_between(3, FIELD_MAX_CORNERS);
+            for (int k = 0; k < def->num_points; k++) {
+                double angle = 2 * M_PI * k / def->num_points;
+                double radius = (k & 1 ? 20000 : 50000) + rand_between(0, 10000);
+                corners[i][k].lat = center.lat + (int32_t)(radius * sin(angle));
+                corners[i][k].lon = center.lon + (int32_t)(radius * 1.5 * cos(angle));
+            }
+        }
+    }
+
+    zassert_equal(geofence_load_table(&fence, defs, num_zones), num_zones);
+}
+
+// moves to `p` and checks every zone against the reference
+static void step_and_check(struct geofence_point p, int num_zones) {
+    struct ufirebirdii_fix fix = fix_at(p.lat, p.lon);
+    int changes = 0;
+    bool certain = true;
+
+    for (int i = 0; i < num_zones; i++) {
+        int in = reference_contains(&defs[i], p);
+        if (in < 0) {
+            certain = false;
+            continue;
+        }
+        changes += expected[i] != (bool)in;
+        expected[i] = in;
+    }
+
+    int transitions = geofence_update(&fence, &fix);
+    if (!certain) {
+        // resync the reference with whatever the fence made of the edge
+        for (int i = 0; i < num_zones; i++)
+            expected[i] = geofence_is_inside(&fence, i);
+        return;
+    }
+
+    zassert_equal(transitions, changes, "at %d,%d", p.lat, p.lon);
+    for (int i = 0; i < num_zones; i++)
+        zassert_equal(geofence_is_inside(&fence, i), expected[i], "zone %d at %d,%d", i, p.lat, p.lon);
+}
+
+ZTEST(geofence, test_circle)
+{
+    struct geofence_point center = {.lat = FIELD_LAT, .lon = FIELD_LON};
+    struct ufirebirdii_fix fix;
+
+    geofence_init(&fence, on_transition, &seen);
+    memset(&seen, 0, sizeof(seen));
+    zassert_ok(geofence_add_circle(&fence, 7, center, 100));
+
+    // 90 m north, then 90 m east: longitude degrees are shorter here, the circle must not be
+    fix = fix_at(FIELD_LAT + 8094, FIELD_LON);
+    zassert_equal(geofence_update(&fence, &fix), 1);
+    zassert_equal(seen.last_id, 7);
+    zassert_equal(seen.last_event, GEOFENCE_ENTER);
+    zassert_true(geofence_is_inside(&fence, 7));
+
+    fix = fix_at(FIELD_LAT, FIELD_LON + 11950);
+    zassert_equal(geofence_update(&fence, &fix), 0);
+
+    // 110 m east
+    fix = fix_at(FIELD_LAT, FIELD_LON + 14606);
+    zassert_equal(geofence_update(&fence, &fix), 1);
+    zassert_equal(seen.last_event, GEOFENCE_EXIT);
+    zassert_false(geofence_is_inside(&fence, 7));
+
+    // a fix without a position changes nothing
+    fix = fix_at(FIELD_LAT, FIELD_LON);
+    fix.valid = false;
+    zassert_equal(geofence_update(&fence, &fix), 0);
+    zassert_equal(seen.enters, 1);
+    zassert_equal(seen.exits, 1);
+}
+
+ZTEST(geofence, test_concave_polygon)
+{
+    // a U opening north, the notch is outside
+    static const struct geofence_point u[] = {
+        {0, 0}, {0, 30000}, {30000, 30000}, {30000, 20000},
+        {10000, 20000}, {10000, 10000}, {30000, 10000}, {30000, 0},
+    };
+    struct ufirebirdii_fix fix;
+
+    geofence_init(&fence, NULL, NULL);
+    zassert_ok(geofence_add_polygon(&fence, 1, u, ARRAY_SIZE(u)));
+
+    fix = fix_at(5000, 15000);
+    zassert_equal(geofence_update(&fence, &fix), 1);
+    fix = fix_at(20000, 5000);
+    zassert_equal(geofence_update(&fence, &fix), 0);
+    fix = fix_at(20000, 15000);
+    zassert_equal(geofence_update(&fence, &fix), 1);
+    zassert_false(geofence_is_inside(&fence, 1));
+    fix = fix_at(-5000, 15000);
+    zassert_equal(geofence_update(&fence, &fix), 0);
+}
+
+ZTEST(geofence, test_parse_line)
+{
+    geofence_init(&fence, NULL, NULL);
+
+    zassert_equal(geofence_parse_line(&fence, "# comment"), 0);
+    zassert_equal(geofence_parse_line(&fence, "  \r\n"), 0);
+    zassert_equal(geofence_parse_line(&fence, "C,3,47.37,8.54,250\r\n"), 1);
+    zassert_equal(geofence_parse_line(&fence, "P,4,47.1,8.1,47.2,8.1,47.2,8.2"), 1);
+    zassert_equal(fence.num_zones, 2);
+    zassert_equal(fence.zones[0].circle.center.lat, 473700000);
+    zassert_equal(fence.zones[1].polygon.count, 3);
+
+    zassert_equal(geofence_parse_line(&fence, "C,5,47.37,8.54"), -EINVAL);
+    zassert_equal(geofence_parse_line(&fence, "C,5,47.37,8.54,0"), -EINVAL);
+    zassert_equal(geofence_parse_line(&fence, "P,5,47.1,8.1,47.2,8.1"), -EINVAL);
+    zassert_equal(geofence_parse_line(&fence, "X,5,47.1,8.1"), -EINVAL);
+    zassert_equal(geofence_parse_line(&fence, "C,65535,47.37,8.54,250"), -EINVAL);
+    zassert_equal(geofence_parse_line(&fence, "C,5,91.0,8.54,250"), -EINVAL);
+    zassert_equal(fence.num_zones, 2);
+    // a rejected polygon leaves nothing behind in the vertex pool
+    zassert_equal(fence.num_vertices, 3);
+}
+
+ZTEST(geofence, test_grid_matches_reference)
+{
+    build_field(0x9E3779B9, FIELD_ZONES);
+    zassert_true(fence.num_wide > 0, "the field should exercise the wide list");
+
+    // a walk at car speed with the odd jump, which leaves zones from any cell
+    struct geofence_point p = {.lat = FIELD_LAT + FIELD_SPAN / 2, .lon = FIELD_LON + FIELD_SPAN / 2};
+    for (int i = 0; i < 20000; i++) {
+        if (i % 500 == 0) {
+            p.lat = FIELD_LAT + rand_between(0, FIELD_SPAN);
+            p.lon = FIELD_LON + rand_between(0, FIELD_SPAN);
+        } else {
+            p.lat = CLAMP(p.lat + rand_between(-300, 300), FIELD_LAT, FIELD_LAT + FIELD_SPAN);
+            p.lon = CLAMP(p.lon + rand_between(-450, 450), FIELD_LON, FIELD_LON + FIELD_SPAN);
+        }
+        step_and_check(p, FIELD_ZONES);
+    }
+
+    zassert_true(seen.enters > 100, "the walk should cross plenty of zones, saw %u", seen.enters);
+}
+
+#ifdef CONFIG_EXTERNAL_LIBC
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#else
+static uint64_t bench_now_ns(void) {
+    return k_cyc_to_ns_floor64(k_cycle_get_64());
+}
+#endif
+
+// @returns evaluations per second over a walk through the field with `num_zones` zones
+static uint32_t bench_walk(int num_zones) {
+    static struct ufirebirdii_fix fixes[1024];
+
+    build_field(0x9E3779B9, num_zones);
+    rand_state = 0x85EBCA77;
+
+    struct geofence_point p = {.lat = FIELD_LAT + FIELD_SPAN / 2, .lon = FIELD_LON + FIELD_SPAN / 2};
+    for (int i = 0; i < ARRAY_SIZE(fixes); i++) {
+        p.lat = CLAMP(p.lat + rand_between(-300, 300), FIELD_LAT, FIELD_LAT + FIELD_SPAN);
+        p.lon = CLAMP(p.lon + rand_between(-450, 450), FIELD_LON, FIELD_LON + FIELD_SPAN);
+        fixes[i] = fix_at(p.lat, p.lon);
+    }
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        // back and forth, so the walk never jumps
+        int k = i % (2 * ARRAY_SIZE(fixes));
+        geofence_update(&fence, &fixes[k < ARRAY_SIZE(fixes) ? k : 2 * ARRAY_SIZE(fixes) - 1 - k]);
+    }
+    uint64_t ns = MAX(bench_now_ns() - start, 1);
+
+    const struct geofence_stats* stats = &fence.stats;
+    uint32_t per_s = (uint32_t)MIN((uint64_t)BENCH_UPDATES * NSEC_PER_SEC / ns, UINT32_MAX);
+    TC_PRINT("%3d zones (%2u wide): %9u evaluations/s, %llu ns each, %u.%02u candidates, %u.%02u exact tests\n",
+        num_zones, fence.num_wide, per_s, (unsigned long long)(ns / BENCH_UPDATES),
+        stats->candidates / stats->evaluations, stats->candidates * 100 / stats->evaluations % 100,
+        stats->exact_tests / stats->evaluations, stats->exact_tests * 100 / stats->evaluations % 100);
+    return per_s;
+}
+
+ZTEST(geofence, test_benchmark)
+{
+    // the field stays the same size, so candidates per fix follow the zones per cell and
+    // the wide list, not the total a linear scan would test
+    bench_walk(FIELD_ZONES / 8);
+    bench_walk(FIELD_ZONES / 4);
+    bench_walk(FIELD_ZONES / 2);
+    zassert_true(bench_walk(FIELD_ZONES) > 0);
+}
+
+ZTEST_SUITE(geofence, NULL, NULL, NULL, NULL, NULL);
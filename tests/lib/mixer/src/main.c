@@ -0,0 +1,205 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <mixer/mixer.h>
+
+#ifdef CONFIG_EXTERNAL_LIBC
+#include <time.h>
+#endif
+
+// one 4096 byte block of 16 bit stereo, the player's default
+#define BLOCK_SAMPLES   2048
+#define BENCH_BLOCKS    2000
+#define BENCH_VOICES    4
+
+static int16_t acc[BLOCK_SAMPLES];
+static int16_t in[BENCH_VOICES][BLOCK_SAMPLES];
+
+// a full scale sine and a sawtooth, every sample value a mix sees without repeating every block
+static void fill(int16_t* buf, uint32_t n, uint32_t seed) {
+    for (uint32_t i = 0; i < n; i++) {
+        double s = sin((i + seed) * 0.0137 * (seed % 7 + 1)) * 24000;
+        int32_t saw = (int32_t)((i * 37 + seed * 101) % 16384) - 8192;
+        buf[i] = (int16_t)CLAMP(lround(s) + saw, INT16_MIN, INT16_MAX);
+    }
+}
+
+// `x * gain`, Q15, rounded half up like the mixer
+static int32_t ref_scale(int32_t x, int32_t gain) {
+    return (int32_t)floor((double)x * gain / 32768.0 + 0.5);
+}
+
+static int16_t ref_sat(int32_t v) {
+    return (int16_t)CLAMP(v, INT16_MIN, INT16_MAX);
+}
+
+ZTEST(mixer, test_gain_helpers)
+{
+    zassert_equal(mixer_gain_percent(100), MIXER_GAIN_UNITY);
+    zassert_equal(mixer_gain_percent(250), MIXER_GAIN_UNITY);
+    zassert_equal(mixer_gain_percent(50), 16384);
+    zassert_equal(mixer_gain_percent(30), 9830);
+    zassert_equal(mixer_gain_percent(0), MIXER_GAIN_MUTE);
+
+    // unity is exact either side, anything else rounds to nearest
+    zassert_equal(mixer_gain_mul(MIXER_GAIN_UNITY, 1234), 1234);
+    zassert_equal(mixer_gain_mul(-1234, MIXER_GAIN_UNITY), -1234);
+    zassert_equal(mixer_gain_mul(16384, 16384), 8192);
+    zassert_equal(mixer_gain_mul(16384, 3), 2);
+    zassert_equal(mixer_gain_mul(MIXER_GAIN_MUTE, MIXER_GAIN_UNITY), MIXER_GAIN_MUTE);
+}
+
+ZTEST(mixer, test_scale)
+{
+    static int16_t orig[BLOCK_SAMPLES];
+    const int16_t gains[] = {MIXER_GAIN_MUTE, 1, 9830, 16384, 32766, -16384};
+
+    fill(orig, BLOCK_SAMPLES, 1);
+
+    // unity leaves the block untouched
+    memcpy(acc, orig, sizeof(acc));
+    mixer_scale(acc, BLOCK_SAMPLES, MIXER_GAIN_UNITY);
+    zassert_mem_equal(acc, orig, sizeof(acc));
+
+    for (int g = 0; g < ARRAY_SIZE(gains); g++) {
+        memcpy(acc, orig, sizeof(acc));
+        mixer_scale(acc, BLOCK_SAMPLES, gains[g]);
+        for (int i = 0; i < BLOCK_SAMPLES; i++)
+            zassert_equal(acc[i], ref_scale(orig[i], gains[g]), "gain %d sample %d", gains[g], i);
+    }
+}
+
+ZTEST(mixer, test_saturation)
+{
+    int16_t a[] = {30000, -30000, 32767, -32768, 100, -100, 32767, -32768};
+    int16_t b[] = {10000, -10000, 32767, -32768, -200, 200, -32768, 32767};
+    int16_t sum[] = {32767, -32768, 32767, -32768, -100, 100, -1, -1};
+
+    mixer_add(a, b, ARRAY_SIZE(a), MIXER_GAIN_UNITY);
+    zassert_mem_equal(a, sum, sizeof(sum));
+
+    // every sum clips to 16 bits instead of wrapping, at any gain
+    static int16_t orig[BLOCK_SAMPLES];
+    fill(orig, BLOCK_SAMPLES, 2);
+    fill(in[0], BLOCK_SAMPLES, 3);
+
+    const int16_t gains[] = {MIXER_GAIN_UNITY, 24576, 9830};
+    for (int g = 0; g < ARRAY_SIZE(gains); g++) {
+        memcpy(acc, orig, sizeof(acc));
+        mixer_add(acc, in[0], BLOCK_SAMPLES, gains[g]);
+
+        int clipped = 0;
+        for (int i = 0; i < BLOCK_SAMPLES; i++) {
+            int32_t exact = orig[i] + (gains[g] == MIXER_GAIN_UNITY ? in[0][i] : ref_scale(in[0][i], gains[g]));
+            zassert_equal(acc[i], ref_sat(exact), "gain %d sample %d", gains[g], i);
+            clipped += exact != ref_sat(exact);
+        }
+        if (gains[g] == MIXER_GAIN_UNITY)
+            zassert_true(clipped > 0, "the test signals should clip at unity");
+    }
+}
+
+ZTEST(mixer, test_duck)
+{
+    // a chime under an alert is mixed at CONFIG_AUDIO_DUCK_PERCENT of its own gain
+    int16_t duck = mixer_gain_percent(30);
+    int16_t chime = mixer_gain_percent(80);
+    int16_t gain = mixer_gain_mul(chime, duck);
+    static int16_t alert[BLOCK_SAMPLES];
+
+    zassert_within(gain, 32768 * 24 / 100, 1);
+
+    fill(alert, BLOCK_SAMPLES, 4);
+    fill(in[0], BLOCK_SAMPLES, 5);
+    memcpy(acc, alert, sizeof(acc));
+    mixer_scale(acc, BLOCK_SAMPLES, MIXER_GAIN_UNITY);
+    mixer_add(acc, in[0], BLOCK_SAMPLES, gain);
+
+    for (int i = 0; i < BLOCK_SAMPLES; i++)
+        zassert_equal(acc[i], ref_sat(alert[i] + ref_scale(in[0][i], gain)), "sample %d", i);
+}
+
+ZTEST(mixer, test_ramp)
+{
+    const uint32_t n = BLOCK_SAMPLES;
+
+    // a steady input ramps monotonically from `from` to just short of `to`, within 1 LSB
+    for (int i = 0; i < n; i++)
+        acc[i] = 20000;
+    mixer_scale_ramp(acc, n, MIXER_GAIN_UNITY, mixer_gain_percent(30));
+    for (int i = 0; i < n; i++) {
+        double g = MIXER_GAIN_UNITY + ((double)mixer_gain_percent(30) - MIXER_GAIN_UNITY) * i / n;
+        zassert_within(acc[i], lround(20000 * g / 32768), 1, "sample %d", i);
+        zassert_true(i == 0 || acc[i] <= acc[i - 1], "ramp down went up at %d", i);
+    }
+
+    // ramping up on top of a loud block still saturates
+    for (int i = 0; i < n; i++) {
+        acc[i] = 30000;
+        in[0][i] = 20000;
+    }
+    mixer_add_ramp(acc, in[0], n, MIXER_GAIN_MUTE, MIXER_GAIN_UNITY);
+    zassert_equal(acc[0], 30000);
+    zassert_equal(acc[n - 1], INT16_MAX);
+    for (int i = 1; i < n; i++)
+        zassert_true(acc[i] >= acc[i - 1], "ramp up went down at %d", i);
+
+    // no ramp is the plain mix
+    static int16_t plain[BLOCK_SAMPLES];
+    fill(acc, n, 6);
+    fill(in[0], n, 7);
+    memcpy(plain, acc, sizeof(plain));
+    mixer_add(plain, in[0], n, 9830);
+    mixer_add_ramp(acc, in[0], n, 9830, 9830);
+    zassert_mem_equal(acc, plain, sizeof(plain));
+}
+
+#ifdef CONFIG_EXTERNAL_LIBC
+#define BENCH_UNIT "ns"
+static uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#else
+#define BENCH_UNIT "cycles"
+static uint64_t bench_now(void) {
+    return k_cycle_get_64();
+}
+#endif
+
+// mixes `voices` blocks into one BENCH_BLOCKS times the way the player does, @returns the cost per voice per block
+static uint64_t bench_mix(uint32_t voices, int16_t from, int16_t to) {
+    fill(acc, BLOCK_SAMPLES, 8);
+
+    uint64_t start = bench_now();
+    for (int b = 0; b < BENCH_BLOCKS; b++) {
+        mixer_scale_ramp(acc, BLOCK_SAMPLES, from, to);
+        for (uint32_t v = 1; v < voices; v++)
+            mixer_add_ramp(acc, in[v], BLOCK_SAMPLES, from, to);
+    }
+    uint64_t per_block = (bench_now() - start) / ((uint64_t)BENCH_BLOCKS * voices);
+
+    TC_PRINT("%u voices, gain %5d to %5d: %llu %s/voice/block\n",
+        voices, from, to, (unsigned long long)per_block, BENCH_UNIT);
+    return per_block;
+}
+
+ZTEST(mixer, test_benchmark)
+{
+    for (int v = 0; v < BENCH_VOICES; v++)
+        fill(in[v], BLOCK_SAMPLES, 10 + v);
+
+    // steady gains take the plain loops, a change ramps over the block
+    for (uint32_t voices = 1; voices <= BENCH_VOICES; voices++) {
+        bench_mix(voices, 9830, 9830);
+        bench_mix(voices, MIXER_GAIN_UNITY, 9830);
+    }
+    zassert_true(bench_mix(2, MIXER_GAIN_UNITY, 9830) > 0);
+}
+
+ZTEST_SUITE(mixer, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# Copyright (c) 2026 Nate Aquino
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Writes the IMA ADPCM vectors the decoder test checks against: for each case a WAV IMA block
+(<name>.adpcm) and what it decodes to (<name>.pcm), 16 bit little endian stereo, mono copied
+to both sides. The blocks are encoded and decoded with CPython's audioop, a separate
+implementation of the same IMA/DVI step, so the test does not check the decoder against
+itself. audioop puts the high nibble first where WAV puts the low one, and knows nothing of
+block headers, both are handled here.
+
+audioop was removed in Python 3.13, run this with 3.12 or older.
+"""
+
+import argparse
+import audioop
+import math
+import os
+import struct
+
+
+def swap_nibbles(data):
+    return bytes((b >> 4) | ((b & 0x0F) << 4) for b in data)
+
+
+def encode(samples, index):
+    """@returns the 4 byte header and the nibbles for `samples[1:]`, high nibble first"""
+    pcm = struct.pack(f"<{len(samples) - 1}h", *samples[1:])
+    nibbles, _ = audioop.lin2adpcm(pcm, 2, (samples[0], index))
+    return struct.pack("<hBB", samples[0], index, 0), nibbles
+
+
+def decode(header, nibbles):
+    predictor, index = struct.unpack("<hB", header[:3])
+    pcm = audioop.adpcm2lin(nibbles, 2, (predictor, index))[0]
+    return [predictor] + list(struct.unpack(f"<{len(pcm) // 2}h", pcm))
+
+
+def block(channels):
+    """
+    @param channels per channel, the header and its high nibble first data
+    @returns the WAV block: the headers, then 4 bytes of each channel in turn
+    """
+    out = b"".join(header for header, _ in channels)
+    data = [swap_nibbles(nibbles) for _, nibbles in channels]
+    for i in range(0, len(data[0]), 4):
+        for d in data:
+            out += d[i:i + 4]
+    return out
+
+
+def write(out_dir, name, channels):
+    decoded = [decode(header, nibbles) for header, nibbles in channels]
+    left, right = decoded[0], decoded[-1]
+    with open(os.path.join(out_dir, name + ".adpcm"), "wb") as f:
+        f.write(block(channels))
+    with open(os.path.join(out_dir, name + ".pcm"), "wb") as f:
+        f.write(b"".join(struct.pack("<hh", l, r) for l, r in zip(left, right)))
+    print(f"{name}: {len(channels)} channels, {len(left)} frames")
+
+
+def tone(frames, rate, freq, amp, phase=0.0):
+    return [round(amp * math.sin(2 * math.pi * freq * i / rate + phase)) for i in range(frames)]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output-dir", required=True)
+    args = parser.parse_args()
+
+    # a 256 byte mono block, 505 frames: a chirp from silence up to near full scale
+    chirp = [round(30000 * (i / 505) * math.sin(2 * math.pi * (200 + 20 * i) * i / 22050)) for i in range(505)]
+    write(args.output_dir, "mono", [encode(chirp, 0)])
+
+    # a 512 byte stereo block, 505 frames, a tone on the left and a square wave on the right
+    square = [12000 if (i // 40) % 2 else -12000 for i in range(505)]
+    write(args.output_dir, "stereo", [encode(tone(505, 22050, 440, 20000), 20), encode(square, 40)])
+
+    # a 72 byte mono block that drives the predictor into both rails and the index into both ends
+    header = struct.pack("<hBB", 32000, 88, 0)
+    nibbles = bytes([0x77] * 4 + [0xFF] * 12 + [0x00] * 48 + [0x88] * 4)
+    write(args.output_dir, "rails", [(header, nibbles)])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <pcm/pcm.h>
+
+// data/<name>.adpcm and .pcm, see data/gen_ima_vectors.py for what is in them
+static const uint8_t mono_block[] = {
+#include "ima_mono_adpcm.inc"
+};
+static const uint8_t mono_pcm[] = {
+#include "ima_mono_pcm.inc"
+};
+static const uint8_t stereo_block[] = {
+#include "ima_stereo_adpcm.inc"
+};
+static const uint8_t stereo_pcm[] = {
+#include "ima_stereo_pcm.inc"
+};
+static const uint8_t rails_block[] = {
+#include "ima_rails_adpcm.inc"
+};
+static const uint8_t rails_pcm[] = {
+#include "ima_rails_pcm.inc"
+};
+
+#define MAX_FRAMES  505
+
+static int16_t out[2 * MAX_FRAMES];
+
+static void check_decoded(const char* name, const uint8_t* expect, uint32_t frames) {
+    for (uint32_t i = 0; i < 2 * frames; i++)
+        zassert_equal(out[i], (int16_t)sys_get_le16(&expect[2 * i]), "%s frame %u %s",
+            name, i / 2, i & 1 ? "right" : "left");
+}
+
+/**
+ * @brief Decodes `block` whole, then again `piece` frames at a time, and checks both against
+ *      the reference.
+ */
+static void check_vector(const char* name, const uint8_t* block, uint32_t len, uint16_t channels,
+    const uint8_t* expect, uint32_t expect_len, uint32_t piece) {
+    uint32_t frames = pcm_ima_block_frames(len, channels);
+    struct pcm_ima st = {0};
+
+    zassert_equal(frames, expect_len / 4, "%s", name);
+    zassert_true(frames <= MAX_FRAMES);
+
+    pcm_ima_decode(&st, out, block, frames, channels);
+    check_decoded(name, expect, frames);
+
+    // the state carries across calls, a block may be split anywhere
+    memset(out, 0, sizeof(out));
+    st.pos = 0;
+    for (uint32_t done = 0; done < frames; done += piece)
+        pcm_ima_decode(&st, out + 2 * done, block, MIN(piece, frames - done), channels);
+    check_decoded(name, expect, frames);
+}
+
+ZTEST(pcm_ima, test_block_frames)
+{
+    zassert_equal(pcm_ima_block_frames(256, 1), 505);
+    zassert_equal(pcm_ima_block_frames(512, 2), 505);
+    zassert_equal(pcm_ima_block_frames(1024, 2), 1017);
+    zassert_equal(pcm_ima_block_frames(4, 1), 1);
+    zassert_equal(pcm_ima_block_frames(3, 1), 0);
+    zassert_equal(pcm_ima_block_frames(7, 2), 0);
+    zassert_equal(pcm_ima_block_frames(256, 0), 0);
+}
+
+ZTEST(pcm_ima, test_mono)
+{
+    check_vector("mono", mono_block, sizeof(mono_block), 1, mono_pcm, sizeof(mono_pcm), 7);
+}
+
+ZTEST(pcm_ima, test_stereo)
+{
+    check_vector("stereo", stereo_block, sizeof(stereo_block), 2, stereo_pcm, sizeof(stereo_pcm), 13);
+}
+
+ZTEST(pcm_ima, test_rails)
+{
+    // the predictor saturates at both ends and the step index clamps at 88 and 0
+    check_vector("rails", rails_block, sizeof(rails_block), 1, rails_pcm, sizeof(rails_pcm), 1);
+}
+
+ZTEST_SUITE(pcm_ima, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,169 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <math.h>
+
+#include <pcm/pcm.h>
+
+#define OUT_RATE    44100
+#define OUT_FRAMES  4096
+#define AMPLITUDE   16000
+// the filter's history is still filling for the first TAPS outputs, left out of the fit
+#define WARMUP      (4 * PCM_RESAMPLER_TAPS)
+
+static int16_t in[2 * (PCM_RESAMPLER_MAX_RATIO * OUT_FRAMES + PCM_RESAMPLER_TAPS)];
+static int16_t out[2 * OUT_FRAMES];
+
+/// the worst the 16 tap, 32 phase bank may do on a tone up to 0.7 of the lower Nyquist rate
+static const struct {
+    uint32_t in_rate;
+    double snr_db;      // signal to everything else, aliases, images and rounding
+    double gain_db;     // passband ripple either way
+} limits[] = {
+    {8000, 50, 0.5},
+    {11025, 65, 0.5},
+    {16000, 65, 0.5},
+    {22050, 65, 0.5},
+    {32000, 65, 0.5},
+    {44100, 80, 0.5},
+    {48000, 55, 0.5},
+    // decimating, the kernel is stretched and its 16 taps leave the least room between passband and cutoff
+    {96000, 35, 1.0},
+};
+
+static const double sweep[] = {0.05, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7};
+
+/**
+ * @brief Resamples a tone of `freq` Hz from `in_rate` to OUT_RATE, the right channel inverted,
+ *      and fits a sine at `freq` to the left output by least squares.
+ * @param snr_db the fitted sine's power against the residual's
+ * @param gain_db the fitted amplitude against the input's
+ */
+static void tone_fit(uint32_t in_rate, double freq, double* snr_db, double* gain_db) {
+    struct pcm_resampler rs;
+
+    zassert_ok(pcm_resampler_init(&rs, in_rate, OUT_RATE));
+    uint32_t need = pcm_resampler_demand(&rs, OUT_FRAMES);
+    zassert_true(need <= ARRAY_SIZE(in) / 2);
+
+    for (uint32_t i = 0; i < need; i++) {
+        int16_t v = (int16_t)lround(AMPLITUDE * sin(2 * M_PI * freq * i / in_rate));
+        in[2 * i] = v;
+        in[2 * i + 1] = -v;
+    }
+    zassert_equal(pcm_resample(&rs, out, OUT_FRAMES, in, need), OUT_FRAMES);
+
+    // normal equations for dc + sin + cos, solved by elimination
+    double m[3][3] = {0}, b[3] = {0}, c[3];
+    for (uint32_t i = WARMUP; i < OUT_FRAMES; i++) {
+        double t = 2 * M_PI * freq * i / OUT_RATE;
+        double x[3] = {1, sin(t), cos(t)};
+        for (int r = 0; r < 3; r++) {
+            b[r] += x[r] * out[2 * i];
+            for (int k = 0; k < 3; k++)
+                m[r][k] += x[r] * x[k];
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        for (int r = k + 1; r < 3; r++) {
+            double f = m[r][k] / m[k][k];
+            for (int j = k; j < 3; j++)
+                m[r][j] -= f * m[k][j];
+            b[r] -= f * b[k];
+        }
+    }
+    for (int k = 2; k >= 0; k--) {
+        c[k] = b[k];
+        for (int j = k + 1; j < 3; j++)
+            c[k] -= m[k][j] * c[j];
+        c[k] /= m[k][k];
+    }
+
+    double signal = 0, noise = 0;
+    for (uint32_t i = WARMUP; i < OUT_FRAMES; i++) {
+        double t = 2 * M_PI * freq * i / OUT_RATE;
+        double tone = c[1] * sin(t) + c[2] * cos(t);
+        signal += tone * tone;
+        noise += (out[2 * i] - c[0] - tone) * (out[2 * i] - c[0] - tone);
+
+        // both channels go through the same filter
+        zassert_within(out[2 * i + 1], -out[2 * i], 1, "frame %u", i);
+    }
+
+    *snr_db = 10 * log10(signal / noise);
+    *gain_db = 20 * log10(sqrt(c[1] * c[1] + c[2] * c[2]) / AMPLITUDE);
+}
+
+ZTEST(pcm_resampler, test_init)
+{
+    struct pcm_resampler rs;
+
+    zassert_equal(pcm_resampler_init(&rs, 0, OUT_RATE), -EINVAL);
+    zassert_equal(pcm_resampler_init(&rs, 8000, 0), -EINVAL);
+    zassert_equal(pcm_resampler_init(&rs, PCM_RESAMPLER_MAX_RATIO * OUT_RATE + 1, OUT_RATE), -EINVAL);
+    zassert_ok(pcm_resampler_init(&rs, PCM_RESAMPLER_MAX_RATIO * OUT_RATE, OUT_RATE));
+
+    // each phase of the bank passes dc at unity, give or take a few taps rounding the same way
+    for (int r = 0; r < ARRAY_SIZE(limits); r++) {
+        zassert_ok(pcm_resampler_init(&rs, limits[r].in_rate, OUT_RATE));
+        for (int p = 0; p <= PCM_RESAMPLER_PHASES; p++) {
+            int32_t sum = 0;
+            for (int t = 0; t < PCM_RESAMPLER_TAPS; t++)
+                sum += rs.bank[p][t];
+            zassert_within(sum, 32768, 4, "%u Hz phase %d sums to %d", limits[r].in_rate, p, sum);
+        }
+    }
+}
+
+ZTEST(pcm_resampler, test_sine_sweep)
+{
+    for (int r = 0; r < ARRAY_SIZE(limits); r++) {
+        uint32_t rate = limits[r].in_rate;
+        double nyquist = MIN(rate, OUT_RATE) / 2.0;
+        double worst_snr = INFINITY, worst_gain = 0;
+
+        for (int s = 0; s < ARRAY_SIZE(sweep); s++) {
+            double snr, gain;
+            tone_fit(rate, sweep[s] * nyquist, &snr, &gain);
+
+            zassert_true(snr >= limits[r].snr_db, "%u Hz, %.0f Hz tone: SNR %.1f dB",
+                rate, sweep[s] * nyquist, snr);
+            zassert_true(fabs(gain) <= limits[r].gain_db, "%u Hz, %.0f Hz tone: gain %.2f dB",
+                rate, sweep[s] * nyquist, gain);
+            worst_snr = MIN(worst_snr, snr);
+            worst_gain = fabs(gain) > fabs(worst_gain) ? gain : worst_gain;
+        }
+        TC_PRINT("%6u Hz: SNR >= %.1f dB, gain within %+.2f dB\n", rate, worst_snr, worst_gain);
+    }
+}
+
+ZTEST(pcm_resampler, test_streaming)
+{
+    static int16_t whole[2 * OUT_FRAMES];
+    struct pcm_resampler rs;
+    uint32_t rate = 32000;
+
+    zassert_ok(pcm_resampler_init(&rs, rate, OUT_RATE));
+    uint32_t need = pcm_resampler_demand(&rs, OUT_FRAMES);
+    for (uint32_t i = 0; i < need; i++) {
+        in[2 * i] = (int16_t)lround(AMPLITUDE * sin(2 * M_PI * 1000.0 * i / rate));
+        in[2 * i + 1] = (int16_t)(i * 37 % 4096);
+    }
+    zassert_equal(pcm_resample(&rs, whole, OUT_FRAMES, in, need), OUT_FRAMES);
+
+    // the same input fed in odd sized pieces comes out the same, the state carries between calls
+    zassert_ok(pcm_resampler_init(&rs, rate, OUT_RATE));
+    uint32_t made = 0, taken = 0;
+    for (uint32_t piece = 1; made < OUT_FRAMES; piece = piece % 97 + 13) {
+        uint32_t want = MIN(piece, OUT_FRAMES - made);
+        uint32_t give = pcm_resampler_demand(&rs, want);
+        zassert_equal(pcm_resample(&rs, out + 2 * made, want, in + 2 * taken, give), want);
+        made += want;
+        taken += give;
+    }
+    zassert_equal(taken, need);
+    zassert_mem_equal(out, whole, sizeof(whole));
+}
+
+ZTEST_SUITE(pcm_resampler, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,309 @@
+// Copyright (c) 2026 Nate Aquino
+// SPDX-License-Identifier: Apache-2.0
+
+#include <zephyr/ztest.h>
+#include <math.h>
+#include <string.h>
+
+#include <track/track.h>
+#include <test_rand.h>
+
+// 2026-01-01T00:00:00Z
+#define DRIVE_EPOCH     1767225600
+#define DRIVE_LAT       47.37
+#define DRIVE_LON       8.54
+#define MAX_ERROR_M     10
+#define M_PER_DEG       111195.0
+
+#define MAX_FIXES       4000
+#define MAX_STORED      2048
+
+static struct track track;
+
+// every fix offered, quantized the way the track stores them
+static struct track_point offered[MAX_FIXES];
+static int num_offered;
+
+// every point the track stored, in order, as seen from outside the ring
+static struct track_point stored[MAX_STORED];
+static int num_stored;
+
+static struct drive {
+    double lat, lon;    // degrees
+    double heading;     // radians, 0 east
+    uint32_t time;      // seconds since DRIVE_EPOCH
+    uint32_t state;     // test_rand_next
+} drive;
+
+// uniform in [-1, 1]
+static double rand_unit(void) {
+    return (double)test_rand_next(&drive.state) / UINT32_MAX * 2 - 1;
+}
+
+static struct track_point quantized(int32_t lat, int32_t lon, uint32_t time) {
+    int32_t half = CONFIG_TRACK_RESOLUTION / 2;
+    return (struct track_point){
+        .lat = (lat >= 0 ? lat + half : lat - half) / CONFIG_TRACK_RESOLUTION,
+        .lon = (lon >= 0 ? lon + half : lon - half) / CONFIG_TRACK_RESOLUTION,
+        .time = DRIVE_EPOCH + time,
+    };
+}
+
+// offers the fix at `lat`, `lon` and records which points the track stored because of it
+static void offer(double lat, double lon, uint32_t time) {
+    struct ufirebirdii_fix fix = {
+        .latitude = (int32_t)lround(lat * UFBII_COORD_SCALE),
+        .longitude = (int32_t)lround(lon * UFBII_COORD_SCALE),
+        .utc = {
+            .year = 2026, .month = 1, .day = 1 + time / 86400,
+            .hour = time / 3600 % 24, .minute = time / 60 % 60, .second = time % 60,
+        },
+        .fields = UFBII_FIX_HAS_POSITION | UFBII_FIX_HAS_TIME | UFBII_FIX_HAS_DATE,
+        .valid = true,
+    };
+    struct track_point pending = track.simp.pending;
+    uint32_t before = track.stats.points;
+
+    zassert_true(num_offered < MAX_FIXES);
+    offered[num_offered++] = quantized(fix.latitude, fix.longitude, time);
+
+    int ret = track_add_fix(&track, &fix);
+    uint32_t added = track.stats.points - before;
+
+    // at most the point held back and this one, and the newest is always the last stored
+    zassert_true(added <= 2);
+    zassert_equal(ret, added > 0);
+    zassert_true(num_stored + added <= MAX_STORED);
+    if (added == 2)
+        stored[num_stored++] = pending;
+    if (added > 0)
+        stored[num_stored++] = track.newest;
+}
+
+static void flush(void) {
+    if (track_flush(&track) > 0)
+        stored[num_stored++] = track.newest;
+}
+
+// moves the car `speed` m along its heading, with a little receiver noise on the fix
+static void drive_step(double speed, double turn) {
+    drive.heading += turn;
+    drive.lat += speed * sin(drive.heading) / M_PER_DEG;
+    drive.lon += speed * cos(drive.heading) / (M_PER_DEG * cos(drive.lat * M_PI / 180));
+    drive.time++;
+
+    offer(drive.lat + rand_unit() * 2 / M_PER_DEG, drive.lon + rand_unit() * 2 / M_PER_DEG, drive.time);
+}
+
+// town driving, mostly straight with corners and the odd stop
+static void drive_town(int seconds) {
+    for (int i = 0; i < seconds; i++) {
+        uint32_t r = test_rand_next(&drive.state) % 100;
+        double turn = r < 8 ? rand_unit() * M_PI / 2 : rand_unit() * 0.02;
+        double speed = r >= 95 ? 0 : 8 + rand_unit() * 4;
+        drive_step(speed, turn);
+    }
+}
+
+static void start(uint32_t seed) {
+    track_init(&track, MAX_ERROR_M);
+    num_offered = 0;
+    num_stored = 0;
+    drive = (struct drive){.lat = DRIVE_LAT, .lon = DRIVE_LON, .state = seed};
+}
+
+// decodes the whole track in buffers of `buf_len` bytes into `out`, `*n` points of at most `max`
+static void decode_all(size_t buf_len, struct track_point* out, int max, int* n) {
+    uint8_t buf[512];
+    uint32_t skip = 0;
+
+    *n = 0;
+    zassert_true(buf_len <= sizeof(buf));
+
+    for (;;) {
+        uint32_t points;
+        int len = track_encode(&track, skip, buf, buf_len, &points);
+        if (len == -ENOENT)
+            break;
+        zassert_true(len > 0, "encode at %u returned %d", skip, len);
+        zassert_true(points > 0);
+
+        const uint8_t* pos = buf;
+        struct track_point point;
+        for (uint32_t i = 0; i < points; i++) {
+            zassert_ok(track_decode(&pos, buf + len, &point, i == 0));
+            zassert_true(*n < max);
+            out[(*n)++] = point;
+        }
+        zassert_equal(track_decode(&pos, buf + len, &point, false), -ENOENT, "buffer has trailing bytes");
+
+        skip += points;
+    }
+}
+
+// the ring must decode to exactly the newest points the track stored, whatever it evicted
+static void check_round_trip(size_t buf_len) {
+    static struct track_point decoded[MAX_STORED];
+    int n;
+
+    decode_all(buf_len, decoded, ARRAY_SIZE(decoded), &n);
+
+    zassert_equal(n, track.count);
+    zassert_equal(track.stats.points, num_stored);
+    zassert_equal(track.stats.evicted + track.count, track.stats.points);
+    zassert_mem_equal(decoded, &stored[num_stored - n], n * sizeof(decoded[0]),
+        "decoded track differs from what was stored, %d points in %u byte buffers", n, buf_len);
+}
+
+static double dist_m(const struct track_point* a, const struct track_point* b) {
+    double m_per_step = M_PER_DEG * CONFIG_TRACK_RESOLUTION / UFBII_COORD_SCALE;
+    double y = (double)(b->lat - a->lat) * m_per_step;
+    double x = (double)(b->lon - a->lon) * m_per_step * cos(DRIVE_LAT * M_PI / 180);
+    return sqrt(x * x + y * y);
+}
+
+// distance from `p` to the segment from `a` to `b`
+static double seg_dist_m(const struct track_point* a, const struct track_point* b, const struct track_point* p) {
+    double m_per_step = M_PER_DEG * CONFIG_TRACK_RESOLUTION / UFBII_COORD_SCALE;
+    double lon_scale = cos(DRIVE_LAT * M_PI / 180);
+    double bx = (b->lon - a->lon) * m_per_step * lon_scale, by = (b->lat - a->lat) * m_per_step;
+    double px = (p->lon - a->lon) * m_per_step * lon_scale, py = (p->lat - a->lat) * m_per_step;
+    double len2 = bx * bx + by * by;
+    double t = len2 > 0 ? CLAMP((px * bx + py * by) / len2, 0.0, 1.0) : 0;
+
+    return sqrt((px - t * bx) * (px - t * bx) + (py - t * by) * (py - t * by));
+}
+
+// stored points are offered fixes in order, and the ones between them are dropped within the
+// error budget of the segment joining the stored points either side
+static void check_dropped(void) {
+    double slack = 2 * M_PER_DEG * CONFIG_TRACK_RESOLUTION / UFBII_COORD_SCALE;
+    int k = 0;
+
+    for (int i = 0; i < num_stored; i++) {
+        while (k < num_offered && memcmp(&offered[k], &stored[i], sizeof(stored[i])) != 0) {
+            zassert_true(i > 0, "the first fix is always stored");
+            double d = seg_dist_m(&stored[i - 1], &stored[i], &offered[k]);
+            zassert_true(d <= MAX_ERROR_M + slack, "fix %d dropped %.1f m from the track", k, d);
+            k++;
+        }
+        zassert_true(k < num_offered, "stored point %d was never offered", i);
+        k++;
+    }
+}
+
+ZTEST(track, test_simplified_round_trip)
+{
+    start(0x2545F491);
+    drive_town(300);
+    flush();
+
+    zassert_true(num_stored > 10 && num_stored < num_offered / 2,
+        "%d of %d fixes stored", num_stored, num_offered);
+    zassert_equal(track.stats.evicted, 0, "the drive should fit the ring");
+
+    // in one buffer, in buffers of a few records, and one point per buffer
+    check_round_trip(512);
+    check_round_trip(24);
+    check_round_trip(TRACK_RECORD_MAX);
+
+    check_dropped();
+}
+
+ZTEST(track, test_corner)
+{
+    start(1);
+
+    // 60 s east then 60 s north at 10 m/s, no noise: the start, the corner and the end are enough
+    for (uint32_t t = 0; t <= 120; t++) {
+        double x = MIN(t, 60) * 10.0, y = (t > 60 ? t - 60 : 0) * 10.0;
+        offer(DRIVE_LAT + y / M_PER_DEG, DRIVE_LON + x / (M_PER_DEG * cos(DRIVE_LAT * M_PI / 180)), t);
+    }
+    flush();
+
+    struct track_point corner = offered[60];
+    zassert_equal(num_stored, 3);
+    zassert_mem_equal(&stored[0], &offered[0], sizeof(stored[0]));
+    zassert_true(dist_m(&stored[1], &corner) <= 10.5, "corner stored %.1f m off", dist_m(&stored[1], &corner));
+    zassert_mem_equal(&stored[2], &offered[120], sizeof(stored[0]));
+    check_round_trip(512);
+}
+
+ZTEST(track, test_u_turn)
+{
+    start(4);
+
+    // 10 s east to 100 m, back to 20 m, then 60 s north, at 10 m/s with no noise; every point
+    // on the way back is inside the cone of the way out, the far end must still be stored
+    for (uint32_t t = 0; t <= 78; t++) {
+        double x = t <= 10 ? t * 10.0 : t <= 18 ? 100 - (t - 10) * 10.0 : 20;
+        double y = t <= 18 ? 0 : (t - 18) * 10.0;
+        offer(DRIVE_LAT + y / M_PER_DEG, DRIVE_LON + x / (M_PER_DEG * cos(DRIVE_LAT * M_PI / 180)), t);
+    }
+    flush();
+
+    struct track_point far = offered[10];
+    bool kept = false;
+    for (int i = 0; i < num_stored; i++)
+        kept |= dist_m(&stored[i], &far) <= MAX_ERROR_M;
+    zassert_true(kept, "the turning point 100 m out was dropped");
+    check_dropped();
+    check_round_trip(512);
+}
+
+ZTEST(track, test_parked)
+{
+    start(2);
+
+    // no movement at all, a point is still stored every CONFIG_TRACK_MAX_GAP_S
+    for (uint32_t t = 0; t <= 3 * CONFIG_TRACK_MAX_GAP_S; t++)
+        offer(DRIVE_LAT, DRIVE_LON, t);
+
+    zassert_equal(num_stored, 4);
+    for (int i = 0; i < num_stored; i++)
+        zassert_equal(stored[i].time, DRIVE_EPOCH + i * CONFIG_TRACK_MAX_GAP_S);
+    check_round_trip(512);
+}
+
+ZTEST(track, test_long_jump)
+{
+    start(3);
+
+    // deltas this large take five byte varints and wrap as uint32_t
+    offer(80.0, -179.9, 0);
+    offer(-80.0, 179.9, CONFIG_TRACK_MAX_GAP_S);
+    offer(0.0, 0.0, 2 * CONFIG_TRACK_MAX_GAP_S);
+    offer(80.0, 179.9, 3 * CONFIG_TRACK_MAX_GAP_S + 100000);
+
+    zassert_equal(num_stored, 4);
+    check_round_trip(512);
+    check_round_trip(TRACK_RECORD_MAX);
+}
+
+ZTEST(track, test_ring_wraparound)
+{
+    uint32_t checks = 0;
+
+    start(0x9E3779B9);
+
+    // the ring holds a few dozen points, so this wraps it several times; check after every store
+    for (int i = 0; i < MAX_FIXES - 1; i++) {
+        int before = num_stored;
+        drive_town(1);
+        if (num_stored != before) {
+            check_round_trip(512);
+            checks++;
+        }
+    }
+    flush();
+    check_round_trip(512);
+    check_round_trip(24);
+
+    // filled three times over, so records have been split across the end of the ring
+    zassert_true(track.stats.points > 3 * track.count, "%u stored, %u held", track.stats.points, track.count);
+
+    TC_PRINT("%d fixes, %d points stored, %u evicted, %u checks\n",
+        num_offered, num_stored, track.stats.evicted, checks);
+}
+
+ZTEST_SUITE(track, NULL, NULL, NULL, NULL, NULL);